@@ -0,0 +1,90 @@
+#if !defined(ALLOCATOR_ANNOTATE_H)
+#define ALLOCATOR_ANNOTATE_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Compile-time memory checker annotations. A map is one large valid object t *
+ *  o AddressSanitizer and Memcheck, so without help they cannot see use-after *
+ *  -free or overflows of the blocks carved from it. When compiled with -fsani *
+ *  tize=address (detected automatically), or with ALLOCATOR_VALGRIND defined  *
+ *  (needs valgrind/memcheck.h), the allocators report through these macros wh *
+ *  ich parts of a map hold allocated blocks, which hold their own metadata, a *
+ *  nd which are free. Otherwise ALLOCATOR_ANNOTATE stays undefined and every  *
+ *  macro only discards its arguments (so none is left unused), which costs no *
+ *  thing.                                                                     *
+ *                                                                             *
+ *  Memcheck additionally tracks allocated blocks as heap blocks (VALGRIND_MAL *
+ *  LOCLIKE_BLOCK), so it reports leaks and invalid frees within the map too.  *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+// Detect AddressSanitizer (GCC defines __SANITIZE_ADDRESS__, Clang has a feature test)
+#if defined(__SANITIZE_ADDRESS__)
+#define ALLOCATOR_ANNOTATE_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ALLOCATOR_ANNOTATE_ASAN
+#endif
+#endif
+
+
+// Macros: Annotate n bytes at p as allocator metadata (accessible to the
+// allocator only), free space (inaccessible), an allocated block, a block
+// resized in place within its capacity of cap bytes, or a freed block
+#if defined(ALLOCATOR_ANNOTATE_ASAN)
+
+#include <sanitizer/asan_interface.h>
+#define ALLOCATOR_ANNOTATE
+
+#define ALLOCATOR_ANNOTATE_TAGS(p, n) \
+    ASAN_UNPOISON_MEMORY_REGION((p), (n))
+#define ALLOCATOR_ANNOTATE_FREE_SPACE(p, n) \
+    ASAN_POISON_MEMORY_REGION((p), (n))
+#define ALLOCATOR_ANNOTATE_ALLOCATED(p, n) \
+    ASAN_UNPOISON_MEMORY_REGION((p), (n))
+#define ALLOCATOR_ANNOTATE_RESIZED(p, cap, old_n, new_n) \
+    do { (void)(old_n); ASAN_POISON_MEMORY_REGION((p), (cap)); ASAN_UNPOISON_MEMORY_REGION((p), (new_n)); } while (0)
+#define ALLOCATOR_ANNOTATE_FREED(p) \
+    do { } while (0)
+
+#elif defined(ALLOCATOR_VALGRIND)
+
+#include <valgrind/memcheck.h>
+#define ALLOCATOR_ANNOTATE
+
+#define ALLOCATOR_ANNOTATE_TAGS(p, n) \
+    VALGRIND_MAKE_MEM_DEFINED((p), (n))
+#define ALLOCATOR_ANNOTATE_FREE_SPACE(p, n) \
+    VALGRIND_MAKE_MEM_NOACCESS((p), (n))
+#define ALLOCATOR_ANNOTATE_ALLOCATED(p, n) \
+    VALGRIND_MALLOCLIKE_BLOCK((p), (n), 0, 0)
+#define ALLOCATOR_ANNOTATE_RESIZED(p, cap, old_n, new_n) \
+    VALGRIND_RESIZEINPLACE_BLOCK((p), (old_n), (new_n), 0)
+#define ALLOCATOR_ANNOTATE_FREED(p) \
+    VALGRIND_FREELIKE_BLOCK((p), 0)
+
+#else
+
+#define ALLOCATOR_ANNOTATE_TAGS(p, n) \
+    do { (void)(p); (void)(n); } while (0)
+#define ALLOCATOR_ANNOTATE_FREE_SPACE(p, n) \
+    do { (void)(p); (void)(n); } while (0)
+#define ALLOCATOR_ANNOTATE_ALLOCATED(p, n) \
+    do { (void)(p); (void)(n); } while (0)
+#define ALLOCATOR_ANNOTATE_RESIZED(p, cap, old_n, new_n) \
+    do { (void)(p); (void)(cap); (void)(old_n); (void)(new_n); } while (0)
+#define ALLOCATOR_ANNOTATE_FREED(p) \
+    do { (void)(p); } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,298 @@
+#if !defined(ALLOCATOR_PROFILE_H)
+#define ALLOCATOR_PROFILE_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Compile-time allocation profiling. Unless ALLOCATOR_PROFILE is defined, no *
+ *  ne of this is compiled into the allocator. When defined, a map may be give *
+ *  n a profile_table_t (see Static_Allocator::set_sample_period()), allocated *
+ *  in the map itself and found through an offset in its allocator_info_t, so  *
+ *  that any process attached to the map can read it.                          *
+ *                                                                             *
+ *  Allocations are sampled at an average of one per period bytes: the gap to  *
+ *  the next sample is drawn from an exponential distribution (as in tcmalloc) *
+ *  , so that large and frequent allocations are sampled in proportion to thei *
+ *  r bytes and the profile may be scaled back up. A sampled allocation record *
+ *  s its call stack, as a site keyed by the hash of its frames, and its block *
+ *  , which is forgotten again when the block is freed. The sites therefore ac *
+ *  count for the sampled blocks still live in the map.                        *
+ *                                                                             *
+ *  The table is written by the (serialised) allocator under a sequence lock,  *
+ *  and copied by readers with profile_table_snapshot(), so producers are neve *
+ *  r stopped. Frames are return addresses in the process that took the sample *
+ *  , recorded with the site.                                                  *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+// C libraries
+extern "C" {
+    #include <unistd.h>
+    #include <execinfo.h>
+}
+
+
+// Frames recorded per sampled call stack
+#if !defined(ALLOCATOR_PROFILE_DEPTH)
+#define ALLOCATOR_PROFILE_DEPTH      16
+#endif
+
+// Call sites a table holds (power of two)
+#if !defined(ALLOCATOR_PROFILE_SITES)
+#define ALLOCATOR_PROFILE_SITES      256
+#endif
+
+// Sampled blocks a table holds (power of two, filled up to three quarters)
+#if !defined(ALLOCATOR_PROFILE_BLOCKS)
+#define ALLOCATOR_PROFILE_BLOCKS     4096
+#endif
+
+// Default mean number of bytes between samples
+#define ALLOCATOR_PROFILE_PERIOD     (512 * 1024)
+
+// Frames of the profiler itself, skipped at the top of a call stack
+#define ALLOCATOR_PROFILE_SKIP       1
+
+// Copies a reader attempts before taking an inconsistent one
+#define ALLOCATOR_PROFILE_RETRIES    16
+
+static_assert((ALLOCATOR_PROFILE_SITES & (ALLOCATOR_PROFILE_SITES - 1)) == 0 &&
+    (ALLOCATOR_PROFILE_BLOCKS & (ALLOCATOR_PROFILE_BLOCKS - 1)) == 0,
+    "ALLOCATOR_PROFILE_SITES and ALLOCATOR_PROFILE_BLOCKS must be powers of two");
+
+
+// Structure: Call site of sampled allocations
+typedef struct profile_site_t {
+    uint64_t hash;               // Hash of the frames (0 = empty entry)
+    uint32_t n_frames;           // Frames recorded
+    int32_t pid;                 // Process that first sampled the site
+    uint64_t frames[ALLOCATOR_PROFILE_DEPTH]; // Return addresses, innermost first
+    uint64_t n_allocations;      // Sampled allocations, freed ones included
+    uint64_t n_bytes;            // Bytes they requested
+} profile_site_t;
+
+// Structure: Sampled block still allocated
+typedef struct profile_block_t {
+    uint64_t offset;             // Offset of the block in its map (0 = empty entry)
+    uint64_t n_bytes;            // Bytes requested
+    uint64_t site;               // Index of its call site
+} profile_block_t;
+
+// Structure: Profile of a map (allocated in the map)
+typedef struct profile_table_t {
+    std::atomic<uint64_t> seq;   // Odd while an update is in progress
+    uint64_t period;             // Mean bytes between samples (0 = sampling off)
+    uint64_t countdown;          // Bytes left until the next sample
+    uint64_t rng;                // State of the sampling gap generator
+    uint64_t n_samples;          // Allocations sampled
+    uint64_t n_dropped;          // Samples lost to a full table
+    uint64_t n_live;             // Entries in blocks
+    profile_site_t sites[ALLOCATOR_PROFILE_SITES];
+    profile_block_t blocks[ALLOCATOR_PROFILE_BLOCKS];
+} profile_table_t;
+
+
+// Inline method: Gap in bytes to the next sample (exponential, of mean period)
+inline uint64_t profile_gap (profile_table_t *table)
+{
+    // xorshift64*, uniform in (0, 1]
+    table->rng ^= table->rng >> 12;
+    table->rng ^= table->rng << 25;
+    table->rng ^= table->rng >> 27;
+    double u = static_cast<double>(((table->rng * 2685821657736338717ULL) >> 11) + 1) /
+        9007199254740992.0;
+
+    return static_cast<uint64_t>(-std::log(u) * static_cast<double>(table->period)) + 1;
+}
+
+// Clear a table, sampling every period bytes on average
+inline void profile_table_init (profile_table_t *table, uint64_t period)
+{
+    new (&(table->seq)) std::atomic<uint64_t>(0);
+    table->period = period;
+    table->rng = (static_cast<uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count()) ^
+        (reinterpret_cast<uintptr_t>(table) << 16)) | 1;
+    table->countdown = (period == 0) ? 0 : profile_gap(table);
+    table->n_samples = table->n_dropped = table->n_live = 0;
+    for (size_t i = 0; i < ALLOCATOR_PROFILE_SITES; ++i) {
+        table->sites[i].hash = 0;
+    }
+    for (size_t i = 0; i < ALLOCATOR_PROFILE_BLOCKS; ++i) {
+        table->blocks[i].offset = 0;
+    }
+}
+
+// Change the mean bytes between samples (0 stops sampling, the table is kept)
+inline void profile_set_period (profile_table_t *table, uint64_t period)
+{
+    table->period = period;
+    table->countdown = (period == 0) ? 0 : profile_gap(table);
+}
+
+// Inline method: Whether an allocation of n bytes is to be sampled
+inline bool profile_sample (profile_table_t *table, size_t n_bytes)
+{
+    if (table->period == 0) {
+        return false;
+    }
+    if (n_bytes < table->countdown) {
+        table->countdown -= n_bytes;
+        return false;
+    }
+    table->countdown = profile_gap(table);
+    return true;
+}
+
+// Inline method: Home entry of a block offset
+inline size_t profile_slot (uint64_t offset)
+{
+    return static_cast<size_t>((offset * 0x9e3779b97f4a7c15ULL) >> 32) &
+        (ALLOCATOR_PROFILE_BLOCKS - 1);
+}
+
+// Inline method: Open an update
+inline void profile_begin (profile_table_t *table)
+{
+    table->seq.store(table->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+// Inline method: Close an update
+inline void profile_end (profile_table_t *table)
+{
+    table->seq.store(table->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Record a sampled allocation of n bytes in the block at offset, with the
+// call stack of the caller (never inlined, so its frame is the one skipped)
+__attribute__((noinline))
+inline void profile_record (profile_table_t *table, uint64_t offset, size_t n_bytes)
+{
+    void *frames[ALLOCATOR_PROFILE_DEPTH + ALLOCATOR_PROFILE_SKIP];
+    int n_frames = backtrace(frames, ALLOCATOR_PROFILE_DEPTH + ALLOCATOR_PROFILE_SKIP)
+        - ALLOCATOR_PROFILE_SKIP;
+    uint64_t hash = 14695981039346656037ULL;
+    profile_site_t *site = nullptr;
+    size_t index = 0;
+
+    // Hash the frames (FNV-1a), zero marks an empty entry
+    n_frames = (n_frames < 0) ? 0 : n_frames;
+    for (int i = 0; i < n_frames; ++i) {
+        uint64_t frame = reinterpret_cast<uintptr_t>(frames[i + ALLOCATOR_PROFILE_SKIP]);
+        for (size_t k = 0; k < sizeof(frame); ++k) {
+            hash = (hash ^ ((frame >> (8 * k)) & 0xff)) * 1099511628211ULL;
+        }
+    }
+    hash = (hash == 0) ? 1 : hash;
+
+    profile_begin(table);
+    table->n_samples++;
+
+    // Find the site, or the first empty entry
+    for (size_t i = 0; i < ALLOCATOR_PROFILE_SITES; ++i) {
+        index = (hash + i) & (ALLOCATOR_PROFILE_SITES - 1);
+        if (table->sites[index].hash == hash || table->sites[index].hash == 0) {
+            site = &(table->sites[index]);
+            break;
+        }
+    }
+
+    // Case: Sites or blocks full
+    if (site == nullptr || table->n_live >= ALLOCATOR_PROFILE_BLOCKS / 4 * 3) {
+        table->n_dropped++;
+        profile_end(table);
+        return;
+    }
+
+    // Case: New site
+    if (site->hash == 0) {
+        site->n_frames = static_cast<uint32_t>(n_frames);
+        site->pid = static_cast<int32_t>(getpid());
+        for (int i = 0; i < n_frames; ++i) {
+            site->frames[i] = reinterpret_cast<uintptr_t>(frames[i + ALLOCATOR_PROFILE_SKIP]);
+        }
+        site->n_allocations = site->n_bytes = 0;
+        site->hash = hash;
+    }
+    site->n_allocations++;
+    site->n_bytes += n_bytes;
+
+    // Enter the block (linear probing)
+    size_t slot = profile_slot(offset);
+    while (table->blocks[slot].offset != 0) {
+        slot = (slot + 1) & (ALLOCATOR_PROFILE_BLOCKS - 1);
+    }
+    table->blocks[slot].n_bytes = n_bytes;
+    table->blocks[slot].site = index;
+    table->blocks[slot].offset = offset;
+    table->n_live++;
+
+    profile_end(table);
+}
+
+// Forget the block at offset, if it was sampled (on every free, so the
+// common case of no sampled blocks returns at once)
+inline void profile_forget (profile_table_t *table, uint64_t offset)
+{
+    size_t const mask = ALLOCATOR_PROFILE_BLOCKS - 1;
+    size_t hole = profile_slot(offset);
+
+    if (table->n_live == 0) {
+        return;
+    }
+
+    for (; table->blocks[hole].offset != offset; hole = (hole + 1) & mask) {
+        if (table->blocks[hole].offset == 0) {
+            return;
+        }
+    }
+
+    // Shift back entries displaced past the hole, so no probe sequence breaks
+    profile_begin(table);
+    for (size_t i = (hole + 1) & mask; table->blocks[i].offset != 0; i = (i + 1) & mask) {
+        size_t home = profile_slot(table->blocks[i].offset);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table->blocks[hole] = table->blocks[i];
+            hole = i;
+        }
+    }
+    table->blocks[hole].offset = 0;
+    table->n_live--;
+    profile_end(table);
+}
+
+// Copy a table that may be updated meanwhile (by another process). Returns
+// false if no consistent copy was taken within ALLOCATOR_PROFILE_RETRIES,
+// e.g. because a writer died during an update; the last copy is kept
+inline bool profile_table_snapshot (profile_table_t const *table, profile_table_t *copy)
+{
+    for (size_t i = 0; i < ALLOCATOR_PROFILE_RETRIES; ++i) {
+        uint64_t seq = table->seq.load(std::memory_order_acquire);
+
+        memcpy(static_cast<void *>(copy), static_cast<void const *>(table),
+            sizeof(profile_table_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((seq & 1) == 0 && table->seq.load(std::memory_order_relaxed) == seq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
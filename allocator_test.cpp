@@ -0,0 +1,619 @@
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Regression tests of the allocators. Every test is a function returning nor *
+ *  mally, and reports failed checks through CHECK(); the program exits non-ze *
+ *  ro if any check failed. Run with `make test`.                              *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+// C++ libraries
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// C libraries
+extern "C" {
+	#include <stdlib.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/wait.h>
+}
+
+// Custom headers
+#include "arena_allocator.cpp"
+#include "concurrent_allocator.cpp"
+#include "shared_allocator.cpp"
+#include "persistent_map.cpp"
+#include "static_arena.cpp"
+
+
+// Name of the shared maps made by the tests
+#define TEST_SHM_MAP_NAME            "/allocator_test"
+
+// File of the persistent maps made by the tests
+#define TEST_PERSISTENT_MAP_PATH     "/tmp/allocator_test.pmap"
+
+// Argument making the program open TEST_PERSISTENT_MAP_PATH and exit with
+// EXIT_SUCCESS if it was rejected for its allocator options
+#define TEST_OPEN_PERSISTENT         "--open-persistent"
+
+
+// Number of failed checks
+static int g_n_failed = 0;
+
+// Check a condition, reporting it if it does not hold
+#define CHECK(cond) \
+	do { if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ \
+		<< ": Check failed: " #cond << std::endl; g_n_failed++; } } while (0)
+
+
+// Number of mappings of the shared object name in this process
+static size_t n_mappings_of (char const *name)
+{
+	std::ifstream maps("/proc/self/maps");
+	std::string line, path = std::string("/dev/shm") + name + " ";
+	size_t n_mappings = 0;
+
+	while (std::getline(maps, line)) {
+		n_mappings += (line + " ").find(path) != std::string::npos;
+	}
+	return n_mappings;
+}
+
+
+// Carving the largest block leaves stats() with a bound on the largest free
+// block, which largest_free_block() makes exact
+static void test_static_largest_free_block ()
+{
+	std::vector<uint8_t> map(1 << 16);
+	Static_Allocator<uint8_t> allocator(map.data(), map.size());
+	std::vector<uint8_t *> blocks;
+
+	for (int i = 0; i < 64; ++i) {
+		blocks.push_back(allocator.allocate(48));
+	}
+	for (size_t i = 0; i < blocks.size(); i += 2) {
+		allocator.deallocate(blocks[i], 48);
+	}
+	uint8_t *large = allocator.allocate(32 << 10);
+	CHECK(large != nullptr);
+
+	size_t bound = allocator.stats().largest_free_block;
+	size_t largest = allocator.largest_free_block();
+	CHECK(largest < bound && bound <= allocator.free_size());
+	CHECK(allocator.stats().largest_free_block == largest);
+
+	// Freeing the large block merges it with the tail, raising the bound again
+	allocator.deallocate(large, 32 << 10);
+	CHECK(allocator.stats().largest_free_block == allocator.largest_free_block());
+}
+
+
+// Use a map in a local buffer, leaving the storage to the caller's stack
+static __attribute__((noinline)) void use_local_map ()
+{
+	alignas(max_align_t) char buf[4096];
+	Static_Allocator<uint8_t> allocator(buf, sizeof(buf));
+
+	uint8_t *b = allocator.allocate(64);
+	allocator.deallocate(allocator.allocate(64), 64);
+	allocator.deallocate(b, 64);
+	Static_Allocator<uint8_t>::unannotate(buf, sizeof(buf));
+}
+
+// Write the stack where use_local_map() had its map
+static __attribute__((noinline)) void write_stack ()
+{
+	volatile char buf[4096];
+	for (size_t i = 0; i < sizeof(buf); ++i) {
+		buf[i] = 0;
+	}
+}
+
+// A map in storage the caller owns leaves no annotations on it once
+// unannotated, and a new map in poisoned storage starts out accessible
+static void test_static_caller_storage ()
+{
+	use_local_map();
+	write_stack();
+
+	// Case: New map over the free space of an abandoned one
+	std::vector<uint8_t> map(1 << 12);
+	{
+		Static_Allocator<uint8_t> allocator(map.data(), map.size());
+		allocator.allocate(64);
+	}
+	Static_Allocator<uint8_t> allocator(map.data() + 1024, map.size() - 1024);
+	CHECK(allocator.allocate(64) != nullptr);
+	Static_Allocator<uint8_t>::unannotate(map.data(), map.size());
+}
+
+
+// Blocks in use of a map (pointer and bytes)
+using Test_Blocks = std::vector<std::pair<uint8_t *, size_t>>;
+
+// The segregated policy finds every block with one bin lookup and keeps its
+// bins in step through splits, merges, resizes and rebuilds. Its links are
+// offsets, so a copy of the map at another address frees back to one block
+static void test_static_segregated_fit ()
+{
+	using Allocator = Static_Allocator<uint8_t, Segregated_Fit>;
+	size_t const map_size = 1 << 20;
+	uint8_t *map = static_cast<uint8_t *>(mmap(nullptr, 2 * map_size,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	uint8_t *moved = map + map_size;
+	Allocator allocator(map, map_size);
+	Test_Blocks blocks;
+	unsigned int seed = 1;
+
+	// Fragment the map with random sizes, freeing about a third as it goes
+	for (int i = 0; i < 4000; ++i) {
+		size_t n = 1 + rand_r(&seed) % 600;
+		uint8_t *b = allocator.allocate(n);
+		if (b != nullptr) {
+			blocks.push_back({b, n});
+		}
+		if (rand_r(&seed) % 3 == 0) {
+			size_t k = rand_r(&seed) % blocks.size();
+			allocator.deallocate(blocks[k].first, blocks[k].second);
+			blocks[k] = blocks.back();
+			blocks.pop_back();
+		}
+	}
+	allocator.validate();
+
+	// Every search visited a single bin
+	allocator_stats_t stats = allocator.stats();
+	for (size_t i = 1; i < ALLOCATOR_SEARCH_BUCKETS; ++i) {
+		CHECK(stats.search_length[i] == 0);
+	}
+
+	// Resizes, aligned and bulk allocations (which walk the free list), and
+	// deferred coalescing
+	for (size_t k = 0; k < blocks.size(); k += 7) {
+		if (allocator.try_expand(blocks[k].first, blocks[k].second, blocks[k].second + 100)) {
+			blocks[k].second += 100;
+		}
+	}
+	uint8_t *aligned = static_cast<uint8_t *>(allocator.allocate_aligned(1000, 256));
+	CHECK(aligned != nullptr && reinterpret_cast<uintptr_t>(aligned) % 256 == 0);
+	blocks.push_back({aligned, 1000});
+	void *bulk[16];
+	size_t n_bulk = allocator.allocate_bulk(40, 16, bulk);
+	for (size_t i = 0; i < n_bulk; ++i) {
+		blocks.push_back({static_cast<uint8_t *>(bulk[i]), 40});
+	}
+	allocator.set_deferred_coalescing(true);
+	for (size_t k = 0; k < blocks.size(); k += 5) {
+		allocator.deallocate(blocks[k].first, blocks[k].second);
+		blocks[k] = blocks.back();
+		blocks.pop_back();
+	}
+	allocator.set_deferred_coalescing(false);
+	allocator.validate();
+	allocator.recover();
+	allocator.validate();
+
+	// Allocators of one map compare equal, whatever address it is attached at
+	// (the map is unannotated first, so that it may be copied)
+	Allocator::unannotate(map, map_size);
+	memcpy(moved, map, map_size);
+	Allocator copy = Allocator::attach(moved);
+	CHECK(copy != allocator && Allocator::attach(map) == allocator);
+	CHECK(!std::allocator_traits<Allocator>::is_always_equal::value);
+	for (auto &block : blocks) {
+		copy.deallocate(moved + (block.first - map), block.second);
+	}
+	copy.validate();
+	CHECK(copy.unified());
+	Allocator::unannotate(moved, map_size);
+	munmap(map, 2 * map_size);
+}
+
+
+// Arena in bss, installed by its first allocator() call
+static Static_Arena<1 << 16> g_arena;
+
+// A zero-initialised arena becomes a map on first use, and later calls keep
+// the blocks allocated from it
+static void test_static_arena_first_use ()
+{
+	uint8_t *b = g_arena.allocator().allocate(64);
+	CHECK(b != nullptr);
+	Static_Allocator<uint8_t> allocator = g_arena.allocator();
+	CHECK(allocator.free_size() < g_arena.capacity() - 64);
+
+	allocator.deallocate(b, 64);
+	CHECK(allocator.unified());
+}
+
+
+// Rewinding to a checkpoint whose upstream block was released since (by
+// rewinding past it) throws, and leaves the arena as it was
+static void test_arena_stale_checkpoint ()
+{
+	std::vector<uint8_t> map(1 << 16), arena_map(1 << 10);
+	Static_Allocator<uint8_t> upstream(map.data(), map.size());
+	Arena_Allocator<uint8_t> arena(arena_map.data(), arena_map.size(), upstream);
+	size_t free_size = upstream.free_size();
+
+	// Fill the arena, so that both checkpoints share its top
+	while (arena.free_size() > 0) {
+		arena.allocate(1);
+	}
+	arena_checkpoint_t before = arena.checkpoint();
+	CHECK(arena.allocate(256) != nullptr);
+	arena_checkpoint_t after = arena.checkpoint();
+	CHECK(after.overflow != nullptr && upstream.free_size() < free_size);
+
+	arena.rewind(before);
+	bool rejected = false;
+	try {
+		arena.rewind(after);
+	} catch (std::invalid_argument const &) {
+		rejected = true;
+	}
+	CHECK(rejected);
+	CHECK(upstream.free_size() == free_size && upstream.unified());
+	Static_Allocator<uint8_t>::unannotate(map.data(), map.size());
+}
+
+
+// A worker's thread cache outlives its map: the map is detached and unmapped
+// while the worker still runs, so its exit must not touch the map
+static void test_concurrent_map_freed_before_thread_exit ()
+{
+	size_t const map_size = 1 << 20;
+	std::mutex lock;
+	std::condition_variable cond;
+	int stage = 0;
+
+	void *map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	CHECK(map != MAP_FAILED);
+	Concurrent_Allocator<uint8_t> allocator(map, map_size);
+	size_t free_size = allocator.free_size();
+
+	// Worker leaves blocks in its cache, then waits for the map to go away
+	std::thread worker([&]() {
+		uint8_t *blocks[8];
+		for (uint8_t *&b : blocks) {
+			b = allocator.allocate(64);
+		}
+		for (uint8_t *b : blocks) {
+			allocator.deallocate(b, 64);
+		}
+
+		std::unique_lock<std::mutex> guard(lock);
+		stage = 1;
+		cond.notify_all();
+		cond.wait(guard, [&]() { return stage == 2; });
+	});
+
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		cond.wait(guard, [&]() { return stage == 1; });
+	}
+
+	// Detaching returns the cached blocks, so the map is whole again
+	CHECK(allocator.free_size() < free_size);
+	allocator.detach();
+	CHECK(allocator.free_size() == free_size);
+	CHECK(allocator.unified());
+	Static_Allocator<uint8_t>::unannotate(map, map_size);
+	CHECK(munmap(map, map_size) == 0);
+
+	// Let the worker exit (a touch of the unmapped map would fault)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stage = 2;
+		cond.notify_all();
+	}
+	worker.join();
+}
+
+
+// Attaching to a map this process already maps shares that mapping, and
+// dropping the handle leaves the creator's mapping alone
+static void test_shared_attach_detach_cycles ()
+{
+	shared_map_options_t options = {};
+	options.max_size = 64 << 20;
+	Shared_Allocator<uint8_t> creator(TEST_SHM_MAP_NAME, 1 << 20, options);
+
+	CHECK(n_mappings_of(TEST_SHM_MAP_NAME) == 1);
+	for (int i = 0; i < 100; ++i) {
+		Shared_Allocator<uint8_t> handle(TEST_SHM_MAP_NAME);
+		Shared_Allocator<int> copy(handle);
+		CHECK(handle == creator && copy == creator);
+		CHECK(creator.n_processes() == 1);
+	}
+	CHECK(n_mappings_of(TEST_SHM_MAP_NAME) == 1);
+}
+
+// A process unmaps its mapping with its last handle, while the map lives on
+// in the process that created it
+static void test_shared_detach_unmaps ()
+{
+	Shared_Allocator<uint8_t> creator(TEST_SHM_MAP_NAME, 1 << 20);
+	int fds[2];
+
+	CHECK(pipe(fds) == 0);
+	pid_t child = fork();
+	if (child == 0) {
+		char ok = 1;
+		for (int i = 0; i < 100; ++i) {
+			Shared_Allocator<uint8_t> handle(TEST_SHM_MAP_NAME);
+			ok &= (handle == creator);
+		}
+
+		// Attaching shares the inherited mapping, the only one left
+		ok &= (n_mappings_of(TEST_SHM_MAP_NAME) == 1);
+		ok &= (write(fds[1], &ok, 1) == 1);
+		_exit(EXIT_SUCCESS);
+	}
+
+	char ok = 0;
+	CHECK(read(fds[0], &ok, 1) == 1 && ok);
+	waitpid(child, nullptr, 0);
+	close(fds[0]);
+	close(fds[1]);
+	CHECK(creator.reap() == 1 && creator.n_processes() == 1);
+}
+
+// A forked child is registered with the handles it inherits, so the map
+// outlives the parent's handle while the child still uses it
+static void test_shared_fork_outlives_parent ()
+{
+	Shared_Allocator<uint8_t> *creator = new Shared_Allocator<uint8_t>(TEST_SHM_MAP_NAME, 1 << 20);
+	int fds[2];
+
+	CHECK(pipe(fds) == 0);
+	pid_t child = fork();
+	if (child == 0) {
+		char c;
+		bool ok = (read(fds[0], &c, 1) == 1);
+
+		// Parent is gone from the map: use the inherited handle, then drop
+		// it, which destroys the map
+		try {
+			ok &= (creator->n_processes() == 1);
+			creator->deallocate(creator->allocate(64), 64);
+			delete creator;
+		} catch (...) {
+			ok = false;
+		}
+		ok &= (shm_open(TEST_SHM_MAP_NAME, O_RDWR, 0) == -1 && errno == ENOENT);
+		_exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	CHECK(creator->n_processes() == 2);
+	delete creator;
+	CHECK(write(fds[1], "", 1) == 1);
+
+	int status = 0;
+	CHECK(waitpid(child, &status, 0) == child);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+// Maps whose slot offsets would not fit in a slot link are rejected
+static void test_shared_max_map_size ()
+{
+	shared_map_options_t options = {};
+	int n_rejected = 0;
+
+	options.max_size = SHARED_MAX_MAP_SIZE;
+	try {
+		Shared_Allocator<uint8_t> allocator(TEST_SHM_MAP_NAME, 1 << 20, options);
+	} catch (std::invalid_argument const &) {
+		n_rejected++;
+	}
+	try {
+		Shared_Allocator<uint8_t> allocator(TEST_SHM_MAP_NAME, SHARED_MAX_MAP_SIZE);
+	} catch (std::invalid_argument const &) {
+		n_rejected++;
+	}
+	CHECK(n_rejected == 2);
+	CHECK(shm_open(TEST_SHM_MAP_NAME, O_RDWR, 0) == -1 && errno == ENOENT);
+
+	// Case: Large reservation within the limit (address space only)
+	options.max_size = SHARED_MAX_MAP_SIZE / 2;
+	Shared_Allocator<uint8_t> allocator(TEST_SHM_MAP_NAME, 1 << 20, options);
+	Shared_Allocator<uint8_t>::pointer ptr = allocator.allocate(64);
+	CHECK(ptr != nullptr);
+	allocator.deallocate(ptr, 64);
+}
+
+// Growth applies the backing options of the map to each new segment, which
+// is then prefaulted before any of it is used
+static void test_shared_grown_segment_options ()
+{
+	size_t const map_size = 1 << 20, block_size = 2 << 20;
+	size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	shared_map_options_t options = {};
+	options.populate = true;
+	options.max_size = 8 << 20;
+	Shared_Allocator<uint8_t> allocator(TEST_SHM_MAP_NAME, map_size, options);
+
+	uint8_t *block = allocator.allocate(block_size).get();
+	CHECK(block != nullptr && allocator.map_size() > map_size);
+
+	// The second half of the block lies in the new segment, untouched
+	uintptr_t start = (reinterpret_cast<uintptr_t>(block) + block_size / 2 + page_size - 1)
+		& ~(page_size - 1);
+	std::vector<unsigned char> resident(block_size / 2 / page_size - 1);
+	CHECK(mincore(reinterpret_cast<void *>(start), resident.size() * page_size,
+		resident.data()) == 0);
+	CHECK(std::all_of(resident.begin(), resident.end(),
+		[](unsigned char c) { return (c & 1) != 0; }));
+	allocator.deallocate(block, block_size);
+}
+
+// A map grown by large blocks, then given slot slabs while it is mostly
+// free, shrinks back to its first segment once everything is freed
+static void test_shared_release_grown_segments ()
+{
+	using pointer = Shared_Allocator<uint8_t>::pointer;
+	size_t const map_size = 1 << 20;
+	shared_map_options_t options = {};
+	std::vector<pointer> large, small;
+
+	options.max_size = 16 << 20;
+	Shared_Allocator<uint8_t> allocator(TEST_SHM_MAP_NAME, map_size, options);
+	for (int i = 0; i < 48; ++i) {
+		large.push_back(allocator.allocate(64 << 10));
+	}
+	CHECK(allocator.map_size() > 2 * map_size);
+
+	// Holes all over the map, then slabs for every slot size class
+	for (size_t i = 0; i < large.size(); i += 2) {
+		allocator.deallocate(large[i], 64 << 10);
+	}
+	for (int i = 0; i < 2048; ++i) {
+		small.push_back(allocator.allocate(8 * (1 + i % 32)));
+	}
+
+	for (size_t i = 0; i < small.size(); ++i) {
+		allocator.deallocate(small[i], 8 * (1 + i % 32));
+	}
+	for (size_t i = 1; i < large.size(); i += 2) {
+		allocator.deallocate(large[i], 64 << 10);
+	}
+	CHECK(allocator.release_segments() > 0);
+	CHECK(allocator.map_size() == map_size);
+}
+
+
+// Opening a missing file creates nothing, and a file left without a map (by
+// a failed create, or empty) is rejected when opened and created over
+static void test_persistent_blank_file ()
+{
+	unlink(TEST_PERSISTENT_MAP_PATH);
+	bool missing = false;
+	try {
+		Persistent_Map map(TEST_PERSISTENT_MAP_PATH);
+	} catch (std::system_error const &e) {
+		missing = (e.code().value() == ENOENT);
+	}
+	CHECK(missing && access(TEST_PERSISTENT_MAP_PATH, F_OK) == -1);
+
+	// Case: Too small a capacity fails before the file is sized
+	bool too_small = false;
+	try {
+		Persistent_Map map(TEST_PERSISTENT_MAP_PATH, 16);
+	} catch (std::invalid_argument const &) {
+		too_small = true;
+	}
+	struct stat file_stat;
+	CHECK(too_small && stat(TEST_PERSISTENT_MAP_PATH, &file_stat) == 0 &&
+		file_stat.st_size == 0);
+
+	// Case: Header not written (magic number zero)
+	CHECK(truncate(TEST_PERSISTENT_MAP_PATH, 4096) == 0);
+	bool rejected = false;
+	try {
+		Persistent_Map map(TEST_PERSISTENT_MAP_PATH);
+	} catch (std::runtime_error const &) {
+		rejected = true;
+	}
+	CHECK(rejected);
+	{
+		Persistent_Map map(TEST_PERSISTENT_MAP_PATH, 1 << 16);
+		map.set_root(map.allocator().allocate_b(64));
+	}
+	{
+		Persistent_Map map(TEST_PERSISTENT_MAP_PATH);
+		CHECK(!map.recovered() && map.root<uint8_t>() != nullptr);
+	}
+	unlink(TEST_PERSISTENT_MAP_PATH);
+}
+
+// Open the persistent map at path (built with the options of this program).
+// Returns whether it was rejected as written by a build with other options
+static bool persistent_map_rejected (char const *path)
+{
+	try {
+		Persistent_Map map(path);
+	} catch (std::runtime_error const &e) {
+		return strcmp(e.what(), "Persistent map was built with other allocator options") == 0;
+	}
+	return false;
+}
+
+// A persistent map written by a build with other allocator options (the
+// program other_build) is rejected instead of misread, and reopens here
+static void test_persistent_other_build (char const *other_build)
+{
+	unlink(TEST_PERSISTENT_MAP_PATH);
+	{
+		Persistent_Map map(TEST_PERSISTENT_MAP_PATH, 1 << 16);
+		map.set_root(map.allocator().allocate_b(64));
+	}
+
+	pid_t child = fork();
+	if (child == 0) {
+		execl(other_build, other_build, TEST_OPEN_PERSISTENT, (char *)nullptr);
+		_exit(EXIT_FAILURE);
+	}
+
+	int status = 0;
+	CHECK(waitpid(child, &status, 0) == child);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+	// Rejection left the file as it was
+	{
+		Persistent_Map map(TEST_PERSISTENT_MAP_PATH);
+		CHECK(!map.recovered());
+		CHECK(map.root<uint8_t>() != nullptr);
+	}
+	unlink(TEST_PERSISTENT_MAP_PATH);
+}
+
+
+// Usage: allocator_test [build with other allocator options]
+int main (int argc, char *argv[])
+{
+	// Case: Run by another build of the tests to open its persistent map
+	if (argc == 2 && strcmp(argv[1], TEST_OPEN_PERSISTENT) == 0) {
+		return persistent_map_rejected(TEST_PERSISTENT_MAP_PATH) ?
+			EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	test_static_largest_free_block();
+	test_static_caller_storage();
+	test_static_segregated_fit();
+	test_static_arena_first_use();
+	test_arena_stale_checkpoint();
+	test_concurrent_map_freed_before_thread_exit();
+	test_shared_attach_detach_cycles();
+	test_shared_detach_unmaps();
+	test_shared_fork_outlives_parent();
+	test_shared_max_map_size();
+	test_shared_grown_segment_options();
+	test_shared_release_grown_segments();
+	test_persistent_blank_file();
+	if (argc == 2) {
+		test_persistent_other_build(argv[1]);
+	}
+
+	if (g_n_failed != 0) {
+		std::cerr << g_n_failed << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All tests passed" << std::endl;
+	return EXIT_SUCCESS;
+}
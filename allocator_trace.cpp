@@ -0,0 +1,126 @@
+#if !defined(ALLOCATOR_TRACE_H)
+#define ALLOCATOR_TRACE_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Compile-time allocator tracing. Unless ALLOCATOR_TRACE is defined, ALLOCAT *
+ *  OR_TRACE_EVENT expands to nothing and no ring is installed, so tracing cos *
+ *  ts nothing. When defined, every allocator map carries a trace_ring_t and e *
+ *  vents are recorded into it without locks: writers claim a slot with one fe *
+ *  tch-and-add and publish it by storing its sequence number last. The ring l *
+ *  ives in the map, so any process attached to a shared map can read it with  *
+ *  trace_ring_for_each().                                                     *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <new>
+
+
+// Number of events retained by a ring (power of two)
+#if !defined(ALLOCATOR_TRACE_SIZE)
+#define ALLOCATOR_TRACE_SIZE         64
+#endif
+
+static_assert((ALLOCATOR_TRACE_SIZE & (ALLOCATOR_TRACE_SIZE - 1)) == 0,
+    "ALLOCATOR_TRACE_SIZE must be a power of two");
+
+
+// Enumeration: Traced events
+typedef enum {
+    TRACE_ALLOCATE = 1,          // a: bytes requested, b: offset of block
+    TRACE_DEALLOCATE,            // a: bytes released,  b: offset of block
+    TRACE_ALLOCATE_FAILED,       // a: bytes requested, b: bytes free
+    TRACE_MAP_DETACH,            // a: process id,      b: processes left
+    TRACE_MAP_DESTROY            // a: process id,      b: map size
+} trace_event_type_t;
+
+// Structure: Traced event
+typedef struct trace_event_t {
+    std::atomic<uint64_t> seq;   // Sequence number + 1 once written (0 = empty)
+    uint64_t time_ns;            // Steady clock timestamp
+    uint64_t a;                  // First argument (see trace_event_type_t)
+    uint64_t b;                  // Second argument (see trace_event_type_t)
+    uint32_t type;               // trace_event_type_t
+} trace_event_t;
+
+// Structure: Ring of the most recent events
+typedef struct trace_ring_t {
+    std::atomic<uint64_t> head;                  // Next sequence number
+    trace_event_t events[ALLOCATOR_TRACE_SIZE];  // Events by sequence number
+} trace_ring_t;
+
+
+// Clear a ring (the map holding it must not be in use)
+inline void trace_ring_init (trace_ring_t *ring)
+{
+    new (&(ring->head)) std::atomic<uint64_t>(0);
+    for (size_t i = 0; i < ALLOCATOR_TRACE_SIZE; ++i) {
+        new (&(ring->events[i].seq)) std::atomic<uint64_t>(0);
+    }
+}
+
+// Record an event
+inline void trace_ring_record (trace_ring_t *ring, uint32_t type,
+    uint64_t a, uint64_t b)
+{
+    uint64_t seq = ring->head.fetch_add(1, std::memory_order_relaxed);
+    trace_event_t *e = &(ring->events[seq & (ALLOCATOR_TRACE_SIZE - 1)]);
+
+    // Invalidate while rewriting, so readers skip a torn event
+    e->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e->time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    e->a = a;
+    e->b = b;
+    e->type = type;
+    e->seq.store(seq + 1, std::memory_order_release);
+}
+
+// Visit retained events, oldest first: fn(seq, type, time_ns, a, b)
+template <class F>
+void trace_ring_for_each (trace_ring_t const *ring, F fn)
+{
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t seq = (head > ALLOCATOR_TRACE_SIZE) ? head - ALLOCATOR_TRACE_SIZE : 0;
+
+    for (; seq < head; ++seq) {
+        trace_event_t const *e = &(ring->events[seq & (ALLOCATOR_TRACE_SIZE - 1)]);
+        if (e->seq.load(std::memory_order_acquire) != seq + 1) {
+            continue;
+        }
+
+        uint32_t type = e->type;
+        uint64_t time_ns = e->time_ns, a = e->a, b = e->b;
+
+        // Discard if overwritten while copying
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (e->seq.load(std::memory_order_relaxed) == seq + 1) {
+            fn(seq, type, time_ns, a, b);
+        }
+    }
+}
+
+
+// Macro: Record an event (no-op unless ALLOCATOR_TRACE is defined)
+#if defined(ALLOCATOR_TRACE)
+#define ALLOCATOR_TRACE_EVENT(ring, type, a, b) \
+    trace_ring_record((ring), (type), static_cast<uint64_t>(a), static_cast<uint64_t>(b))
+#else
+#define ALLOCATOR_TRACE_EVENT(ring, type, a, b) \
+    do { } while (0)
+#endif
+
+#endif
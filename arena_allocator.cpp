@@ -0,0 +1,368 @@
+#if !defined(ARENA_ALLOCATOR_H)
+#define ARENA_ALLOCATOR_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Monotonic (bump-pointer) variant of the Static_Allocator for request-scope *
+ *  d data. Metadata is installed within the provided static memory, and the r *
+ *  emainder is handed out by advancing a single offset: blocks carry no heade *
+ *  r and allocation involves no search. Deallocation is a no-op (except for t *
+ *  he most recent allocation, which is rolled back). Memory is reclaimed all  *
+ *  at once, by reset() or by rewinding to a checkpoint().                     *
+ *                                                                             *
+ *  When an upstream Static_Allocator is supplied, requests that no longer fit *
+ *  in the arena are served from it instead. Such blocks are chained in alloca *
+ *  tion order and returned to the upstream allocator on reset() or rewind().  *
+ *  The upstream map must outlive the arena, and, like the Static_Allocator, t *
+ *  he arena must be serialised by the caller.                                 *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <new>
+
+// Custom headers
+#include "static_allocator.cpp"
+
+
+// Structure: Position of an arena, to rewind to
+typedef struct arena_checkpoint_t {
+    size_t top;                  // Offset of the first unused arena byte
+    void *overflow;              // Most recent upstream block (or nullptr)
+} arena_checkpoint_t;
+
+
+template <class T>
+class Arena_Allocator
+{
+private:
+
+    // Structure: Header of a block served by the upstream allocator
+    typedef union overflow_h {
+        struct {
+            union overflow_h *next;  // Previously allocated upstream block
+            size_t size;             // Bytes allocated upstream (header included)
+        } d;
+        max_align_t align;           // Memory alignment element
+    } overflow_h;
+
+    // Structure: Allocator information (installed at the start of the map)
+    typedef struct arena_info_t {
+        size_t capacity;                     // Capacity of memory map
+        size_t base;                         // Offset of the first arena byte
+        size_t top;                          // Offset of the first unused byte
+        size_t last;                         // Offset of the most recent block
+        Static_Allocator<uint8_t> upstream;  // Fallback (uninitialized if none)
+        overflow_h *overflow;                // Most recent upstream block
+    } arena_info_t;
+
+    // Pointer to Allocator information (nested within memory block)
+    arena_info_t *d_arena_info_p;
+
+
+    // Inline method: Bytes rounded up to the arena granularity
+    static inline size_t round_up (size_t n_bytes)
+    {
+        size_t const unit_size = alignof(max_align_t);
+        return (n_bytes + unit_size - 1) / unit_size * unit_size;
+    }
+
+    // Inline method: Address at offset
+    inline uint8_t *byte_at (size_t offset) const
+    {
+        return reinterpret_cast<uint8_t *>(d_arena_info_p) + offset;
+    }
+
+    // Serve a request from the upstream allocator (NULL if none or exhausted)
+    void *allocate_upstream (size_t n_bytes)
+    {
+        if (d_arena_info_p->upstream.allocator_info_p() == nullptr) {
+            return NULL;
+        }
+
+        size_t n_total = n_bytes + sizeof(overflow_h);
+        overflow_h *b = reinterpret_cast<overflow_h *>(
+            d_arena_info_p->upstream.allocate_b(n_total));
+        if (b == nullptr) {
+            return NULL;
+        }
+
+        b->d.next = d_arena_info_p->overflow;
+        b->d.size = n_total;
+        d_arena_info_p->overflow = b;
+
+        return reinterpret_cast<void *>(b + 1);
+    }
+
+    // Whether upstream block b is held (or nullptr, which ends the chain)
+    bool on_chain (overflow_h const *b) const
+    {
+        for (overflow_h const *o = d_arena_info_p->overflow; o != b; o = o->d.next) {
+            if (o == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Return upstream blocks allocated after the given one (held, see on_chain())
+    void release_upstream (overflow_h *until)
+    {
+        while (d_arena_info_p->overflow != until) {
+            overflow_h *b = d_arena_info_p->overflow;
+            d_arena_info_p->overflow = b->d.next;
+            d_arena_info_p->upstream.deallocate(reinterpret_cast<uint8_t *>(b),
+                b->d.size);
+        }
+    }
+
+public:
+
+    // Alias: Value types
+    using value_type         = T;
+
+	// Alias: Pointer as pointer to value type
+	using pointer            = T *;
+
+	// Alias: Pointer to const
+	using const_pointer      = T const *;
+
+	// Alias: Most general pointer
+	using void_pointer       = void *;
+
+	// Alias: Most general pointer (to const)
+	using const_void_pointer = const void *;
+
+	// Alias: Reference
+	using reference          = T&;
+
+	// Alias: Constant reference
+	using const_reference    = const T&;
+
+	// Alias: Allocation and deallocation size
+	using size_type          = size_t;
+
+
+    // Rebinding support: Let container construct arbitrary type allocator
+    template <class U>
+    struct rebind {
+    	using other          = Arena_Allocator<U>;
+    };
+
+    // Operator: Move assignment
+    template <class U>
+    Arena_Allocator &operator=(Arena_Allocator<U> &&origin)
+    {
+        // Ownership transfer
+        this->d_arena_info_p =
+            reinterpret_cast<arena_info_t *>(origin.arena_info_p());
+
+        return *this;
+    }
+
+    // Empty constuctor that does nothing
+    Arena_Allocator ():
+        d_arena_info_p(nullptr)
+    {
+        // Nothing to do
+    }
+
+    // Constructor
+    Arena_Allocator (void *static_memory_map, size_t capacity):
+        Arena_Allocator(static_memory_map, capacity, Static_Allocator<uint8_t>{})
+    {
+        // Nothing to do
+    }
+
+    // Constructor: Chain into an upstream allocator once the arena is full
+    Arena_Allocator (void *static_memory_map, size_t capacity,
+        Static_Allocator<uint8_t> const &upstream)
+    {
+        size_t info_size = round_up(sizeof(arena_info_t));
+
+        // Capacity check
+        if (capacity < info_size) {
+            throw std::bad_alloc();
+        }
+
+        // Struct initialization
+        d_arena_info_p = reinterpret_cast<arena_info_t *>(static_memory_map);
+        d_arena_info_p->capacity = capacity;
+        d_arena_info_p->base = info_size;
+        d_arena_info_p->top = info_size;
+        d_arena_info_p->last = info_size;
+        new (&(d_arena_info_p->upstream)) Static_Allocator<uint8_t>(upstream);
+        d_arena_info_p->overflow = nullptr;
+    }
+
+    // Copy constructor
+    Arena_Allocator (const Arena_Allocator &origin)
+    {
+        // Simply copy the static memory pointer (not protected from race conditions)
+        d_arena_info_p = origin.arena_info_p();
+    }
+
+    // Destructor
+    ~Arena_Allocator ()
+    {
+        // No destructor needed: state is not saved in the class instance
+    }
+
+    // Support for allocating other types
+    template <class U>
+    Arena_Allocator (const Arena_Allocator<U> &other):
+        d_arena_info_p(reinterpret_cast<arena_info_t *>(other.arena_info_p()))
+    {
+        // Nothing to do
+    }
+
+    // Allocate #1: General allocation
+    pointer allocate (size_type n_obj)
+    {
+    	size_t n_bytes = (n_obj * sizeof(T));
+    	return reinterpret_cast<pointer>(this->allocate_b(n_bytes));
+    }
+
+    // Allocate #2: Placement support
+    pointer allocate (size_type n_obj, const_void_pointer hint)
+    {
+    	return allocate(n_obj);
+    }
+
+    // Allocate #3: Typeless allocation of n bytes
+    void_pointer allocate_b (size_t n_bytes)
+    {
+        // Check: Validity of fields
+        if (d_arena_info_p == nullptr) {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Check: Requested byte count
+    	if (n_bytes == 0) {
+            throw std::invalid_argument("Cannot allocate zero bytes");
+    	}
+
+        size_t top = d_arena_info_p->top;
+
+        // Case: Arena exhausted
+        if (n_bytes > d_arena_info_p->capacity - top) {
+            return allocate_upstream(n_bytes);
+        }
+
+        // Bump (the final block may end at an unaligned capacity)
+        d_arena_info_p->last = top;
+        d_arena_info_p->top = std::min(top + round_up(n_bytes),
+            d_arena_info_p->capacity);
+
+        return reinterpret_cast<void *>(byte_at(top));
+    }
+
+    // Convert a reference to a pointer
+    pointer address (reference r) const
+    {
+    	return static_cast<pointer>(std::addressof(r));
+    }
+
+    // Converts a reference to a const pointer
+    const_pointer address (const_reference r) const
+    {
+    	return static_cast<const_pointer>(std::addressof(r));
+    }
+
+    // Deallocate: No-op, except that the most recent arena block is rolled back
+    void deallocate (pointer ptr, size_type n_obj)
+    {
+        // Check: Validity of state
+        if (d_arena_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Case: Most recent arena block
+        if (reinterpret_cast<uint8_t *>(ptr) == byte_at(d_arena_info_p->last) &&
+            d_arena_info_p->last != d_arena_info_p->top) {
+            d_arena_info_p->top = d_arena_info_p->last;
+        }
+    }
+
+    // Current position, to rewind to later
+    arena_checkpoint_t checkpoint () const
+    {
+        if (d_arena_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        return arena_checkpoint_t{d_arena_info_p->top, d_arena_info_p->overflow};
+    }
+
+    // Release everything allocated since the checkpoint was taken. Throws
+    // std::invalid_argument if the arena was rewound past it since
+    void rewind (arena_checkpoint_t const &cp)
+    {
+        if (d_arena_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        // Parameter check: Checkpoint belongs to this arena and is still live
+        if (cp.top < d_arena_info_p->base || cp.top > d_arena_info_p->top) {
+            throw std::invalid_argument("Checkpoint outside of arena");
+        }
+        if (!on_chain(reinterpret_cast<overflow_h const *>(cp.overflow))) {
+            throw std::invalid_argument("Checkpoint upstream block already released");
+        }
+
+        release_upstream(reinterpret_cast<overflow_h *>(cp.overflow));
+        d_arena_info_p->top = cp.top;
+        d_arena_info_p->last = cp.top;
+    }
+
+    // Release everything
+    void reset ()
+    {
+        if (d_arena_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        rewind(arena_checkpoint_t{d_arena_info_p->base, nullptr});
+    }
+
+    // Number of available bytes in the arena (upstream excluded)
+    size_t free_size () const
+    {
+    	if (d_arena_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        return d_arena_info_p->capacity - d_arena_info_p->top;
+    }
+
+    // Whether the memory is unified (nothing allocated since the last reset)
+    bool unified () const
+    {
+        if (d_arena_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        return d_arena_info_p->top == d_arena_info_p->base &&
+            d_arena_info_p->overflow == nullptr;
+    }
+
+    // Returns the allocator information
+    arena_info_t *arena_info_p () const
+    {
+        return d_arena_info_p;
+    }
+};
+
+#endif
@@ -0,0 +1,590 @@
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Allocator microbenchmarks. Every scenario is replayed with the same random *
+ *  sequence against each allocator, timing every allocate and deallocate call *
+ *  individually. Reported are operations per second and the p50, p99 and p99 *
+ *  9 latencies in nanoseconds. Latencies include the cost of reading the cloc *
+ *  k (a few tens of nanoseconds). Scenarios:                                  *
+ *                                                                             *
+ *   fixed      Allocate and free one 64-byte block, repeatedly                *
+ *   random     Random 16-4096 byte blocks, freed in random order              *
+ *   fifo       Producer/consumer: blocks are freed in allocation order        *
+ *   churn      Fragmentation: small blocks, free every other, then larger     *
+ *              blocks that do not fit in the holes                            *
+ *   vector     std::vector<int>::push_back                                    *
+ *   list, map  std::list<int> and std::map<int, int> insert/erase             *
+ *   shared     The random scenario in N forked workers on one Shared_Allocato *
+ *              r map (ops/sec summed, latencies of the slowest worker), then  *
+ *              with one sub-heap per worker                                   *
+ *                                                                             *
+ *  Usage: benchmark [operations] [workers]. Build with `make benchmark JEMAL  *
+ *  LOC=1` to include jemalloc (mallocx/sdallocx) in the comparison.           *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+// C++ libraries
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <list>
+#include <map>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+// C libraries
+extern "C" {
+	#include <stdlib.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/wait.h>
+}
+
+#if defined(BENCH_JEMALLOC)
+#include <jemalloc/jemalloc.h>
+#endif
+
+// Custom headers
+#include "static_allocator.cpp"
+#include "pool_allocator.cpp"
+#include "shared_allocator.cpp"
+
+
+// Size of the map given to each map-based allocator (bytes)
+#define BENCH_MAP_SIZE               (64 << 20)
+
+// Default number of operations per scenario
+#define BENCH_DEFAULT_OPS            200000
+
+// Default number of forked workers in the shared scenario
+#define BENCH_DEFAULT_WORKERS        4
+
+// Number of blocks kept live by the random and fifo scenarios
+#define BENCH_LIVE_SET               1024
+
+// Name of the shared map used by the shared scenario
+#define BENCH_SHM_MAP_NAME           "/allocator_benchmark"
+
+
+// Structure: Result of one scenario run
+typedef struct bench_result_t {
+	size_t n_ops;            // Timed operations
+	size_t n_failed;         // Allocations that returned NULL
+	uint64_t elapsed_ns;     // Sum of all operation latencies
+	uint64_t p50_ns;         // Latency percentiles
+	uint64_t p99_ns;
+	uint64_t p999_ns;
+} bench_result_t;
+
+
+// Inline method: Steady clock in nanoseconds
+static inline uint64_t now_ns ()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Records operation latencies of one run
+class Latency_Recorder
+{
+private:
+	std::vector<uint32_t> d_samples;
+	uint64_t d_elapsed_ns;
+	size_t d_n_failed;
+
+public:
+	explicit Latency_Recorder (size_t n_ops):
+		d_elapsed_ns(0), d_n_failed(0)
+	{
+		d_samples.reserve(n_ops);
+	}
+
+	// Time one call of fn
+	template <class F>
+	inline auto time (F fn) -> decltype(fn())
+	{
+		uint64_t start = now_ns();
+		auto result = fn();
+		uint64_t ns = now_ns() - start;
+		d_samples.push_back(static_cast<uint32_t>(std::min<uint64_t>(ns, UINT32_MAX)));
+		d_elapsed_ns += ns;
+		return result;
+	}
+
+	// Count a failed allocation
+	inline void failed ()
+	{
+		d_n_failed++;
+	}
+
+	// Summarise the run
+	bench_result_t result ()
+	{
+		bench_result_t r = {d_samples.size(), d_n_failed, d_elapsed_ns, 0, 0, 0};
+
+		if (d_samples.empty()) {
+			return r;
+		}
+
+		// Percentile: Smallest sample not exceeded by the given fraction
+		auto percentile = [this] (double q) -> uint64_t {
+			size_t i = static_cast<size_t>(q * (d_samples.size() - 1));
+			std::nth_element(d_samples.begin(), d_samples.begin() + i, d_samples.end());
+			return d_samples[i];
+		};
+		r.p50_ns = percentile(0.50);
+		r.p99_ns = percentile(0.99);
+		r.p999_ns = percentile(0.999);
+		return r;
+	}
+};
+
+
+// Anonymous private mapping backing a map-based allocator
+class Bench_Map
+{
+private:
+	void *d_map;
+
+public:
+	Bench_Map ():
+		d_map(mmap(nullptr, BENCH_MAP_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0))
+	{
+		if (d_map == MAP_FAILED) {
+			throw std::system_error(errno, std::generic_category(), "mmap");
+		}
+	}
+
+	~Bench_Map ()
+	{
+		Static_Allocator<uint8_t>::unannotate(d_map, BENCH_MAP_SIZE);
+		munmap(d_map, BENCH_MAP_SIZE);
+	}
+
+	void *get () const
+	{
+		return d_map;
+	}
+};
+
+
+// Adapters: Uniform byte interface over every allocator under test. A fresh
+// adapter (and map) is used for every scenario
+
+// Adapter: Static_Allocator with a placement policy
+template <class Policy>
+struct Static_Policy_Adapter {
+	template <class U> using allocator = Static_Allocator<U, Policy>;
+	Bench_Map map;
+	Static_Allocator<uint8_t, Policy> a{map.get(), BENCH_MAP_SIZE};
+
+	void *allocate (size_t n) { return a.allocate_b(n); }
+	void deallocate (void *p, size_t n) { a.deallocate(static_cast<uint8_t *>(p), n); }
+	template <class U> allocator<U> get () { return allocator<U>::attach(map.get()); }
+};
+
+// Adapter: Static_Allocator (default policy)
+struct Static_Adapter: Static_Policy_Adapter<Next_Fit> {
+	static constexpr char const *name = "static";
+};
+
+// Adapter: Static_Allocator with first-fit placement
+struct Static_First_Fit_Adapter: Static_Policy_Adapter<First_Fit> {
+	static constexpr char const *name = "static (first-fit)";
+};
+
+// Adapter: Static_Allocator with best-fit placement
+struct Static_Best_Fit_Adapter: Static_Policy_Adapter<Best_Fit> {
+	static constexpr char const *name = "static (best-fit)";
+};
+
+// Adapter: Static_Allocator with deferred coalescing
+struct Static_Deferred_Adapter: Static_Adapter {
+	static constexpr char const *name = "static (deferred)";
+	Static_Deferred_Adapter () { a.set_deferred_coalescing(true); }
+};
+
+// Adapter: Static_Allocator in checked (debug) mode
+struct Static_Checked_Adapter: Static_Policy_Adapter<Checked<Next_Fit>> {
+	static constexpr char const *name = "static (checked)";
+};
+
+// Adapter: Static_Allocator with segregated-fit placement
+struct Static_Segregated_Fit_Adapter: Static_Policy_Adapter<Segregated_Fit> {
+	static constexpr char const *name = "static (segregated)";
+};
+
+// Adapter: Pool_Allocator
+struct Pool_Adapter {
+	static constexpr char const *name = "pool";
+	template <class U> using allocator = Pool_Allocator<U>;
+	Bench_Map map;
+	Pool_Allocator<uint8_t> a{map.get(), BENCH_MAP_SIZE};
+
+	void *allocate (size_t n) { return a.allocate_b(n); }
+	void deallocate (void *p, size_t n) { a.deallocate(static_cast<uint8_t *>(p), n); }
+	template <class U> allocator<U> get () { return allocator<U>(a); }
+};
+
+// Adapter: std::allocator (system malloc)
+struct Std_Adapter {
+	static constexpr char const *name = "std::allocator";
+	template <class U> using allocator = std::allocator<U>;
+	std::allocator<uint8_t> a;
+
+	void *allocate (size_t n) { return a.allocate(n); }
+	void deallocate (void *p, size_t n) { a.deallocate(static_cast<uint8_t *>(p), n); }
+	template <class U> allocator<U> get () { return allocator<U>(); }
+};
+
+#if defined(BENCH_JEMALLOC)
+// Allocator: jemalloc, for containers
+template <class U>
+struct Jemalloc_Allocator {
+	using value_type = U;
+	Jemalloc_Allocator () = default;
+	template <class V> Jemalloc_Allocator (const Jemalloc_Allocator<V> &) {}
+	U *allocate (size_t n) { return static_cast<U *>(mallocx(n * sizeof(U), 0)); }
+	void deallocate (U *p, size_t n) { sdallocx(p, n * sizeof(U), 0); }
+	template <class V> bool operator== (const Jemalloc_Allocator<V> &) const { return true; }
+	template <class V> bool operator!= (const Jemalloc_Allocator<V> &) const { return false; }
+};
+
+// Adapter: jemalloc
+struct Jemalloc_Adapter {
+	static constexpr char const *name = "jemalloc";
+	template <class U> using allocator = Jemalloc_Allocator<U>;
+
+	void *allocate (size_t n) { return mallocx(n, 0); }
+	void deallocate (void *p, size_t n) { sdallocx(p, n, 0); }
+	template <class U> allocator<U> get () { return allocator<U>(); }
+};
+#endif
+
+// Adapter: Shared_Allocator (borrowed, so forked workers share one handle)
+struct Shared_Adapter {
+	static constexpr char const *name = "shared";
+	Shared_Allocator<uint8_t, Raw_Ptr> &a;
+
+	void *allocate (size_t n) { return a.allocate_b(n); }
+	void deallocate (void *p, size_t n) { a.deallocate(static_cast<uint8_t *>(p), n); }
+};
+
+
+// Scenario: Allocate and free one fixed-size block
+template <class A>
+bench_result_t bench_fixed (A &a, size_t n_ops)
+{
+	Latency_Recorder rec(n_ops);
+
+	for (size_t i = 0; i < n_ops / 2; ++i) {
+		void *p = rec.time([&] { return a.allocate(64); });
+		if (p == nullptr) {
+			rec.failed();
+			continue;
+		}
+		rec.time([&] { a.deallocate(p, 64); return 0; });
+	}
+
+	return rec.result();
+}
+
+// Scenario: Random sizes freed in random order
+template <class A>
+bench_result_t bench_random (A &a, size_t n_ops, unsigned seed = 1)
+{
+	Latency_Recorder rec(n_ops);
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<size_t> size_dist(16, 4096);
+	std::uniform_int_distribution<size_t> slot_dist(0, BENCH_LIVE_SET - 1);
+	std::vector<std::pair<void *, size_t>> live(BENCH_LIVE_SET, {nullptr, 0});
+
+	for (size_t i = 0; i < n_ops; ++i) {
+		auto &slot = live[slot_dist(rng)];
+		if (slot.first != nullptr) {
+			rec.time([&] { a.deallocate(slot.first, slot.second); return 0; });
+			slot.first = nullptr;
+		} else {
+			size_t n = size_dist(rng);
+			if ((slot.first = rec.time([&] { return a.allocate(n); })) == nullptr) {
+				rec.failed();
+			}
+			slot.second = n;
+		}
+	}
+
+	for (auto &slot : live) {
+		if (slot.first != nullptr) {
+			a.deallocate(slot.first, slot.second);
+		}
+	}
+
+	return rec.result();
+}
+
+// Scenario: Producer/consumer (blocks freed in allocation order)
+template <class A>
+bench_result_t bench_fifo (A &a, size_t n_ops)
+{
+	Latency_Recorder rec(n_ops);
+	std::mt19937 rng(2);
+	std::uniform_int_distribution<size_t> size_dist(32, 512);
+	std::vector<std::pair<void *, size_t>> ring(BENCH_LIVE_SET, {nullptr, 0});
+
+	for (size_t i = 0; i < n_ops / 2; ++i) {
+		auto &slot = ring[i % BENCH_LIVE_SET];
+		if (slot.first != nullptr) {
+			rec.time([&] { a.deallocate(slot.first, slot.second); return 0; });
+		}
+		slot.second = size_dist(rng);
+		if ((slot.first = rec.time([&] { return a.allocate(slot.second); })) == nullptr) {
+			rec.failed();
+		}
+	}
+
+	for (auto &slot : ring) {
+		if (slot.first != nullptr) {
+			a.deallocate(slot.first, slot.second);
+		}
+	}
+
+	return rec.result();
+}
+
+// Scenario: Fragmentation-heavy churn
+template <class A>
+bench_result_t bench_churn (A &a, size_t n_ops)
+{
+	size_t const n_small = 2048;
+	Latency_Recorder rec(n_ops);
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<size_t> small_dist(16, 256);
+	std::uniform_int_distribution<size_t> large_dist(512, 2048);
+	std::vector<std::pair<void *, size_t>> small(n_small), large(n_small / 2);
+
+	// Helpers: Timed allocation and release of a block
+	auto take = [&] (std::pair<void *, size_t> &b, size_t n) {
+		b.second = n;
+		if ((b.first = rec.time([&] { return a.allocate(n); })) == nullptr) {
+			rec.failed();
+		}
+	};
+	auto give = [&] (std::pair<void *, size_t> &b) {
+		if (b.first != nullptr) {
+			rec.time([&] { a.deallocate(b.first, b.second); return 0; });
+			b.first = nullptr;
+		}
+	};
+
+	// Each round: 2 * n_small operations on small blocks, n_small on large
+	size_t n_rounds = std::max<size_t>(1, n_ops / (3 * n_small));
+	for (size_t round = 0; round < n_rounds; ++round) {
+		for (auto &b : small) {
+			take(b, small_dist(rng));
+		}
+		for (size_t i = 1; i < n_small; i += 2) {
+			give(small[i]);
+		}
+		for (auto &b : large) {
+			take(b, large_dist(rng));
+		}
+		for (size_t i = 0; i < n_small; i += 2) {
+			give(small[i]);
+		}
+		for (auto &b : large) {
+			give(b);
+		}
+	}
+
+	return rec.result();
+}
+
+// Scenario: std::vector growth
+template <class A>
+bench_result_t bench_vector (A &a, size_t n_ops)
+{
+	Latency_Recorder rec(n_ops);
+	size_t const n_per_vector = 4096;
+
+	for (size_t done = 0; done < n_ops; done += n_per_vector) {
+		std::vector<int, typename A::template allocator<int>> v(a.template get<int>());
+		for (size_t i = 0; i < n_per_vector; ++i) {
+			rec.time([&] { v.push_back(static_cast<int>(i)); return 0; });
+		}
+	}
+
+	return rec.result();
+}
+
+// Scenario: std::list insertion and removal
+template <class A>
+bench_result_t bench_list (A &a, size_t n_ops)
+{
+	Latency_Recorder rec(n_ops);
+	std::list<int, typename A::template allocator<int>> l(a.template get<int>());
+
+	for (size_t i = 0; i < n_ops / 2; ++i) {
+		rec.time([&] { l.push_back(static_cast<int>(i)); return 0; });
+		if (l.size() > BENCH_LIVE_SET) {
+			rec.time([&] { l.pop_front(); return 0; });
+		}
+	}
+
+	return rec.result();
+}
+
+// Scenario: std::map insertion and removal
+template <class A>
+bench_result_t bench_map (A &a, size_t n_ops)
+{
+	using value_t = std::pair<const int, int>;
+	Latency_Recorder rec(n_ops);
+	std::mt19937 rng(4);
+	std::map<int, int, std::less<int>, typename A::template allocator<value_t>> m(
+		std::less<int>(), a.template get<value_t>());
+
+	for (size_t i = 0; i < n_ops; ++i) {
+		int key = static_cast<int>(rng() % (2 * BENCH_LIVE_SET));
+		auto it = m.find(key);
+		if (it == m.end()) {
+			rec.time([&] { m.emplace(key, key); return 0; });
+		} else {
+			rec.time([&] { m.erase(it); return 0; });
+		}
+	}
+
+	return rec.result();
+}
+
+// Scenario: Random sizes in N forked workers sharing one map (with one
+// sub-heap per worker if n_heaps is set)
+bench_result_t bench_shared (size_t n_ops, size_t n_workers, uint32_t n_heaps)
+{
+	shared_map_options_t options{};
+	options.n_heaps = n_heaps;
+	Shared_Allocator<uint8_t, Raw_Ptr> shared{BENCH_SHM_MAP_NAME, BENCH_MAP_SIZE, options};
+
+	// Start gate and per-worker results live in the map itself
+	std::atomic<size_t> *gate = new (shared.allocate_b(sizeof(std::atomic<size_t>)))
+		std::atomic<size_t>(0);
+	bench_result_t *results = static_cast<bench_result_t *>(
+		shared.allocate_b(n_workers * sizeof(bench_result_t)));
+
+	for (size_t w = 0; w < n_workers; ++w) {
+		pid_t pid = fork();
+		if (pid == -1) {
+			throw std::system_error(errno, std::generic_category(), "fork");
+		}
+
+		// Worker: Wait for all others, run, report, and leave the map to the parent
+		if (pid == 0) {
+			Shared_Adapter a{shared};
+			Shared_Allocator<uint8_t, Raw_Ptr>::set_home_heap(static_cast<int>(w));
+			gate->fetch_add(1);
+			while (gate->load() < n_workers) {
+				// Spin
+			}
+			results[w] = bench_random(a, n_ops, static_cast<unsigned>(w + 1));
+			_exit(0);
+		}
+	}
+
+	for (size_t w = 0; w < n_workers; ++w) {
+		wait(nullptr);
+	}
+
+	// Throughput over the slowest worker, latencies of the worst worker
+	bench_result_t total = {0, 0, 0, 0, 0, 0};
+	for (size_t w = 0; w < n_workers; ++w) {
+		total.n_ops += results[w].n_ops;
+		total.n_failed += results[w].n_failed;
+		total.elapsed_ns = std::max(total.elapsed_ns, results[w].elapsed_ns);
+		total.p50_ns = std::max(total.p50_ns, results[w].p50_ns);
+		total.p99_ns = std::max(total.p99_ns, results[w].p99_ns);
+		total.p999_ns = std::max(total.p999_ns, results[w].p999_ns);
+	}
+
+	shared.deallocate(reinterpret_cast<uint8_t *>(results), n_workers * sizeof(bench_result_t));
+	shared.deallocate(reinterpret_cast<uint8_t *>(gate), sizeof(std::atomic<size_t>));
+	return total;
+}
+
+
+// Print one result row
+static void report (char const *scenario, char const *allocator, bench_result_t const &r)
+{
+	double ops_per_sec = (r.elapsed_ns == 0) ? 0.0 : r.n_ops * 1e9 / r.elapsed_ns;
+
+	std::cout << std::left << std::setw(10) << scenario
+	          << std::setw(20) << allocator << std::right
+	          << std::setw(14) << static_cast<uint64_t>(ops_per_sec)
+	          << std::setw(10) << r.p50_ns
+	          << std::setw(10) << r.p99_ns
+	          << std::setw(10) << r.p999_ns
+	          << std::setw(10) << r.n_failed << std::endl;
+}
+
+// Run every single-process scenario against one allocator
+template <class A>
+void run_all (size_t n_ops)
+{
+	{ A a; report("fixed", A::name, bench_fixed(a, n_ops)); }
+	{ A a; report("random", A::name, bench_random(a, n_ops)); }
+	{ A a; report("fifo", A::name, bench_fifo(a, n_ops)); }
+	{ A a; report("churn", A::name, bench_churn(a, n_ops)); }
+	{ A a; report("vector", A::name, bench_vector(a, n_ops)); }
+	{ A a; report("list", A::name, bench_list(a, n_ops)); }
+	{ A a; report("map", A::name, bench_map(a, n_ops)); }
+}
+
+
+int main (int argc, char *argv[])
+{
+	size_t n_ops = (argc > 1) ? strtoul(argv[1], nullptr, 10) : BENCH_DEFAULT_OPS;
+	size_t n_workers = (argc > 2) ? strtoul(argv[2], nullptr, 10) : BENCH_DEFAULT_WORKERS;
+
+	if (n_ops == 0 || n_workers == 0) {
+		std::cerr << "Usage: " << argv[0] << " [operations] [workers]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << std::left << std::setw(10) << "scenario"
+	          << std::setw(20) << "allocator" << std::right
+	          << std::setw(14) << "ops/sec"
+	          << std::setw(10) << "p50(ns)"
+	          << std::setw(10) << "p99(ns)"
+	          << std::setw(10) << "p999(ns)"
+	          << std::setw(10) << "failed" << std::endl;
+
+	run_all<Static_Adapter>(n_ops);
+	run_all<Static_First_Fit_Adapter>(n_ops);
+	run_all<Static_Best_Fit_Adapter>(n_ops);
+	run_all<Static_Segregated_Fit_Adapter>(n_ops);
+	run_all<Static_Deferred_Adapter>(n_ops);
+	run_all<Static_Checked_Adapter>(n_ops);
+	run_all<Pool_Adapter>(n_ops);
+	run_all<Std_Adapter>(n_ops);
+#if defined(BENCH_JEMALLOC)
+	run_all<Jemalloc_Adapter>(n_ops);
+#endif
+
+	std::string shared_name = "shared x" + std::to_string(n_workers);
+	report("shared", shared_name.c_str(), bench_shared(n_ops, n_workers, 0));
+	shared_name = "shared heaps x" + std::to_string(n_workers);
+	report("shared", shared_name.c_str(), bench_shared(n_ops, n_workers,
+		static_cast<uint32_t>(std::min<size_t>(n_workers, SHARED_MAX_HEAPS))));
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,467 @@
+#if !defined(CONCURRENT_ALLOCATOR_H)
+#define CONCURRENT_ALLOCATOR_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Thread-safe variant of the Static_Allocator. A mutex and the central Stati *
+ *  c_Allocator are installed within the provided static memory. Unlike the St *
+ *  atic_Allocator, callers need not serialise access themselves.              *
+ *                                                                             *
+ *  Small requests (up to CONCURRENT_MAX_CACHED_SIZE bytes) go through a per-t *
+ *  hread cache holding one magazine of recently freed blocks per size class.  *
+ *  An allocation pops from the magazine and a deallocation pushes onto it, so *
+ *  the common alloc/free pair never touches shared state. Empty magazines are *
+ *  refilled, and full magazines flushed, in batches of half a magazine under  *
+ *  a single acquisition of the central lock. A thread caches blocks for one m *
+ *  ap at a time; its cache is flushed when it switches maps and when the thre *
+ *  ad exits. The map keeps a list of the caches attached to it, and detach()  *
+ *  flushes and detaches them all: call it before freeing or unmapping a map t *
+ *  hat threads still running have used.                                       *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+// Custom headers
+#include "static_allocator.cpp"
+
+
+// Granularity of the cached size classes
+#define CONCURRENT_CLASS_GRANULARITY alignof(max_align_t)
+
+// Largest request served from the thread cache (bytes)
+#define CONCURRENT_MAX_CACHED_SIZE   512
+
+// Blocks held by one magazine
+#define CONCURRENT_MAGAZINE_SIZE     32
+
+// Number of cached size classes
+#define CONCURRENT_CLASS_COUNT       (CONCURRENT_MAX_CACHED_SIZE / CONCURRENT_CLASS_GRANULARITY)
+
+
+struct concurrent_cache_t;
+
+// Structure: Allocator information (nested within memory block)
+typedef struct concurrent_info_t {
+    std::mutex lock;                    // Guards the central allocator
+    Static_Allocator<uint8_t> central;  // Allocator shared by all threads
+    concurrent_cache_t *caches;         // Thread caches attached to the map
+} concurrent_info_t;
+
+// Structure: Magazine of free blocks of one size class
+typedef struct concurrent_magazine_t {
+    size_t n_blocks;                            // Blocks held
+    void *blocks[CONCURRENT_MAGAZINE_SIZE];     // Stack of blocks
+} concurrent_magazine_t;
+
+
+// Guards the attachment of thread caches to maps (every map of the process).
+// Taken before the lock of a map, and never on the allocation fast path
+inline std::mutex &concurrent_cache_lock ()
+{
+    static std::mutex lock;
+    return lock;
+}
+
+
+// Structure: Per-thread cache, attached to one map at a time. The map links
+// the caches attached to it, so that it can detach them before going away
+typedef struct concurrent_cache_t {
+    std::atomic<concurrent_info_t *> owner;  // Map the cached blocks belong to
+    concurrent_cache_t *prev;                // Previous cache attached to owner
+    concurrent_cache_t *next;                // Next cache attached to owner
+    concurrent_magazine_t magazines[CONCURRENT_CLASS_COUNT];  // Magazines indexed by size class
+
+    // Inline method: Bytes allocated for every block of a size class
+    static inline size_t class_size (size_t class_index)
+    {
+        return (class_index + 1) * CONCURRENT_CLASS_GRANULARITY;
+    }
+
+    // Return all cached blocks to the owner and detach from it (with the
+    // cache lock held)
+    void detach_locked ()
+    {
+        concurrent_info_t *info = owner.load(std::memory_order_relaxed);
+
+        if (info == nullptr) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(info->lock);
+            for (size_t i = 0; i < CONCURRENT_CLASS_COUNT; ++i) {
+                concurrent_magazine_t *m = &(magazines[i]);
+                while (m->n_blocks > 0) {
+                    info->central.deallocate(reinterpret_cast<uint8_t *>(
+                        m->blocks[--(m->n_blocks)]), class_size(i));
+                }
+            }
+        }
+
+        // Unlink from the map's list
+        if (prev != nullptr) {
+            prev->next = next;
+        } else {
+            info->caches = next;
+        }
+        if (next != nullptr) {
+            next->prev = prev;
+        }
+        prev = next = nullptr;
+        owner.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // Flush the cache to its current map and attach it to the map at info
+    void attach (concurrent_info_t *info)
+    {
+        std::lock_guard<std::mutex> guard(concurrent_cache_lock());
+
+        detach_locked();
+        prev = nullptr;
+        next = info->caches;
+        if (next != nullptr) {
+            next->prev = this;
+        }
+        info->caches = this;
+        owner.store(info, std::memory_order_relaxed);
+    }
+
+    // Return all cached blocks to the central allocator
+    void flush ()
+    {
+        if (owner.load(std::memory_order_relaxed) == nullptr) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(concurrent_cache_lock());
+        detach_locked();
+    }
+
+    // Destructor: Flush unless the map detached the cache already
+    ~concurrent_cache_t ()
+    {
+        flush();
+    }
+} concurrent_cache_t;
+
+
+// Returns the calling thread's cache (shared by the maps it uses, in turn)
+inline concurrent_cache_t &concurrent_thread_cache ()
+{
+    static thread_local concurrent_cache_t cache = {};
+    return cache;
+}
+
+
+template <class T>
+class Concurrent_Allocator
+{
+private:
+
+    // Pointer to Allocator information (nested within memory block)
+    concurrent_info_t *d_concurrent_info_p;
+
+
+    // Inline method: Whether a request is served from the thread cache
+    static inline bool is_cached (size_t n_bytes)
+    {
+        return n_bytes <= CONCURRENT_MAX_CACHED_SIZE;
+    }
+
+    // Inline method: Size class of a cached request
+    static inline size_t class_of (size_t n_bytes)
+    {
+        return (n_bytes + CONCURRENT_CLASS_GRANULARITY - 1)
+            / CONCURRENT_CLASS_GRANULARITY - 1;
+    }
+
+    // Inline method: Bytes allocated for every block of a size class
+    static inline size_t class_size (size_t class_index)
+    {
+        return concurrent_cache_t::class_size(class_index);
+    }
+
+    // Returns the calling thread's cache, attached to this allocator's map
+    concurrent_cache_t *thread_cache () const
+    {
+        concurrent_cache_t *cache = &concurrent_thread_cache();
+
+        if (cache->owner.load(std::memory_order_relaxed) != d_concurrent_info_p) {
+            cache->attach(d_concurrent_info_p);
+        }
+
+        return cache;
+    }
+
+public:
+
+    // Alias: Value types
+    using value_type         = T;
+
+	// Alias: Pointer as pointer to value type
+	using pointer            = T *;
+
+	// Alias: Pointer to const
+	using const_pointer      = T const *;
+
+	// Alias: Most general pointer
+	using void_pointer       = void *;
+
+	// Alias: Most general pointer (to const)
+	using const_void_pointer = const void *;
+
+	// Alias: Reference
+	using reference          = T&;
+
+	// Alias: Constant reference
+	using const_reference    = const T&;
+
+	// Alias: Allocation and deallocation size
+	using size_type          = size_t;
+
+
+    // Rebinding support: Let container construct arbitrary type allocator
+    template <class U>
+    struct rebind {
+    	using other          = Concurrent_Allocator<U>;
+    };
+
+    // Operator: Move assignment
+    template <class U>
+    Concurrent_Allocator &operator=(Concurrent_Allocator<U> &&origin)
+    {
+        // Ownership transfer
+        this->d_concurrent_info_p =
+            reinterpret_cast<concurrent_info_t *>(origin.concurrent_info_p());
+
+        return *this;
+    }
+
+    // Empty constuctor that does nothing
+    Concurrent_Allocator ():
+        d_concurrent_info_p(nullptr)
+    {
+        // Nothing to do
+    }
+
+    // Constructor (not thread-safe: construct before sharing the map)
+    Concurrent_Allocator (void *static_memory_map, size_t capacity)
+    {
+        size_t const unit_size = alignof(max_align_t);
+
+        // Metadata rounded up so that the central map remains aligned
+        size_t info_size = (sizeof(concurrent_info_t) + unit_size - 1)
+            / unit_size * unit_size;
+
+        // Capacity check (central allocator checks the remainder)
+        if (capacity < info_size) {
+            throw std::bad_alloc();
+        }
+
+        // Struct initialization
+        d_concurrent_info_p = reinterpret_cast<concurrent_info_t *>(static_memory_map);
+        new (&(d_concurrent_info_p->lock)) std::mutex();
+        new (&(d_concurrent_info_p->central)) Static_Allocator<uint8_t>{
+            reinterpret_cast<uint8_t *>(static_memory_map) + info_size,
+            capacity - info_size};
+        d_concurrent_info_p->caches = nullptr;
+    }
+
+    // Copy constructor
+    Concurrent_Allocator (const Concurrent_Allocator &origin)
+    {
+        // Simply copy the static memory pointer
+        d_concurrent_info_p = origin.concurrent_info_p();
+    }
+
+    // Destructor
+    ~Concurrent_Allocator ()
+    {
+        // No destructor needed: state is not saved in the class instance
+    }
+
+    // Support for allocating other types
+    template <class U>
+    Concurrent_Allocator (const Concurrent_Allocator<U> &other):
+        d_concurrent_info_p(reinterpret_cast<concurrent_info_t *>(
+            other.concurrent_info_p()))
+    {
+        // Nothing to do
+    }
+
+    // Allocate #1: General allocation
+    pointer allocate (size_type n_obj)
+    {
+    	size_t n_bytes = (n_obj * sizeof(T));
+    	return reinterpret_cast<pointer>(this->allocate_b(n_bytes));
+    }
+
+    // Allocate #2: Placement support
+    pointer allocate (size_type n_obj, const_void_pointer hint)
+    {
+    	return allocate(n_obj);
+    }
+
+    // Allocate #3: Typeless allocation of n bytes
+    void_pointer allocate_b (size_t n_bytes)
+    {
+        // Check: Validity of fields
+        if (d_concurrent_info_p == nullptr) {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Check: Requested byte count
+    	if (n_bytes == 0) {
+            throw std::invalid_argument("Cannot allocate zero bytes");
+    	}
+
+        // Case: Large request
+        if (!is_cached(n_bytes)) {
+            std::lock_guard<std::mutex> guard(d_concurrent_info_p->lock);
+            return d_concurrent_info_p->central.allocate_b(n_bytes);
+        }
+
+        size_t class_index = class_of(n_bytes);
+        concurrent_magazine_t *m = &(thread_cache()->magazines[class_index]);
+
+        // Case: Magazine empty. Refill half of it in one critical section
+        if (m->n_blocks == 0) {
+            std::lock_guard<std::mutex> guard(d_concurrent_info_p->lock);
+            void *b;
+            while (m->n_blocks < CONCURRENT_MAGAZINE_SIZE / 2 &&
+                (b = d_concurrent_info_p->central.allocate_b(
+                    class_size(class_index))) != nullptr) {
+                m->blocks[(m->n_blocks)++] = b;
+            }
+
+            if (m->n_blocks == 0) {
+                return NULL;
+            }
+        }
+
+        return m->blocks[--(m->n_blocks)];
+    }
+
+    // Convert a reference to a pointer
+    pointer address (reference r) const
+    {
+    	return static_cast<pointer>(std::addressof(r));
+    }
+
+    // Converts a reference to a const pointer
+    const_pointer address (const_reference r) const
+    {
+    	return static_cast<const_pointer>(std::addressof(r));
+    }
+
+    // Deallocate
+    void deallocate (pointer ptr, size_type n_obj)
+    {
+        size_t n_bytes = (n_obj * sizeof(T));
+
+        // Check: Validity of state
+        if (d_concurrent_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Parameter check: Is pointer valid
+    	if (ptr == nullptr) {
+            throw std::invalid_argument("Cannot free nullptr!");
+    	}
+
+        // Case: Large request
+        if (!is_cached(n_bytes)) {
+            std::lock_guard<std::mutex> guard(d_concurrent_info_p->lock);
+            return d_concurrent_info_p->central.deallocate(
+                reinterpret_cast<uint8_t *>(ptr), n_bytes);
+        }
+
+        size_t class_index = class_of(n_bytes);
+        concurrent_magazine_t *m = &(thread_cache()->magazines[class_index]);
+
+        // Case: Magazine full. Flush the older half in one critical section
+        if (m->n_blocks == CONCURRENT_MAGAZINE_SIZE) {
+            std::lock_guard<std::mutex> guard(d_concurrent_info_p->lock);
+            size_t const n_flush = CONCURRENT_MAGAZINE_SIZE / 2;
+            for (size_t i = 0; i < n_flush; ++i) {
+                d_concurrent_info_p->central.deallocate(
+                    reinterpret_cast<uint8_t *>(m->blocks[i]),
+                    class_size(class_index));
+            }
+            for (size_t i = n_flush; i < CONCURRENT_MAGAZINE_SIZE; ++i) {
+                m->blocks[i - n_flush] = m->blocks[i];
+            }
+            m->n_blocks -= n_flush;
+        }
+
+        m->blocks[(m->n_blocks)++] = reinterpret_cast<void *>(ptr);
+    }
+
+    // Return the calling thread's cached blocks to the central allocator
+    void flush_thread_cache () const
+    {
+        concurrent_thread_cache().flush();
+    }
+
+    // Return the blocks cached by every thread to the central allocator and
+    // detach their caches from the map. Call before the map is freed or
+    // unmapped, once no thread allocates from it any more: an attached cache
+    // is otherwise flushed into the map when its thread exits. The map stays
+    // usable, and threads attach again on their next request
+    void detach () const
+    {
+        if (d_concurrent_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        std::lock_guard<std::mutex> guard(concurrent_cache_lock());
+        while (d_concurrent_info_p->caches != nullptr) {
+            d_concurrent_info_p->caches->detach_locked();
+        }
+    }
+
+    // Number of available bytes in the central allocator (excludes caches)
+    size_t free_size () const
+    {
+    	if (d_concurrent_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        std::lock_guard<std::mutex> guard(d_concurrent_info_p->lock);
+        return d_concurrent_info_p->central.free_size();
+    }
+
+    // Whether the central memory is unified (excludes caches)
+    bool unified () const
+    {
+        if (d_concurrent_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        std::lock_guard<std::mutex> guard(d_concurrent_info_p->lock);
+        return d_concurrent_info_p->central.unified();
+    }
+
+    // Returns the allocator information
+    concurrent_info_t *concurrent_info_p () const
+    {
+        return d_concurrent_info_p;
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 15/08/2020                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Demonstration of the Shared_Allocator: a vector in a shared map is filled  *
+ *  in by a parent and a forked child process, which meet at a barrier in the  *
+ *  map before reading it back. The vector lives in the map as well, so the pa *
+ *  rent alone destroys it once the child is done.                             *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+// C++ libraries
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+// C libraries
+extern "C" {
+	#include <sys/wait.h>
+}
+
+// Custom headers
+#include "shared_allocator.cpp"
+#include "shared_sync.cpp"
+
+
+int main ()
+{
+	char const *shared_map_name = "rosmem";
+	size_t shared_map_size = 4096;
+
+	// Get process PID
+	int pid = getpid();
+
+	// Make the shared allocator
+	Shared_Allocator<int> my_allocator{shared_map_name, shared_map_size};
+
+	// Display the number of bytes
+	std::cout << "[" << pid << "] "
+			  << "Bytes (asked = " << shared_map_size
+	          << ", free = "  << my_allocator.free_size()
+	          << ")" << std::endl;
+
+	// Allocate a vector and a barrier for both processes in the map
+	using Shared_Vector = std::vector<int, Shared_Allocator<int>>;
+	Shared_Vector *my_vector = my_allocator.new_object<Shared_Vector>(6, my_allocator);
+	Shared_Barrier *barrier = my_allocator.new_object<Shared_Barrier>(2);
+
+	// Fork here
+	pid_t child = fork();
+	if (child == 0) {
+		pid = getpid();
+		(*my_vector)[3] = 4;
+		(*my_vector)[4] = 5;
+		(*my_vector)[5] = 6;
+	} else {
+		(*my_vector)[0] = 1;
+		(*my_vector)[1] = 2;
+		(*my_vector)[2] = 3;
+	}
+
+	// Wait until both halves are written
+	barrier->arrive_and_wait();
+
+	// Print some output
+	std::cout << "[" << pid << "] "
+		<< "Sum of vector = " <<
+		std::accumulate(my_vector->begin(), my_vector->end(), 0) << std::endl;
+
+	// Case: Child leaves the shared objects to the parent, and exits without
+	// dropping its handles (the parent reaps its entry with its last handle)
+	if (child == 0) {
+		_exit(EXIT_SUCCESS);
+	}
+
+	// Release the shared objects once the child is gone
+	waitpid(child, nullptr, 0);
+	my_allocator.delete_object(barrier);
+	my_allocator.delete_object(my_vector);
+
+	// Memory check
+	std::cout << "[" << getpid() << "] " <<
+	    "Bytes (allocated = " << my_allocator.free_size() << ")" << std::endl;
+	std::cout << "[" << getpid() << "] " <<
+	    "Unified = " << my_allocator.unified() << std::endl;
+
+	return 0;
+}
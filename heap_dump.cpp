@@ -0,0 +1,358 @@
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Heap dump of a live shared map. Attaches to the map by name read-only (see *
+ *  Shared_Allocator::inspect()), so the processes using it are neither stoppe *
+ *  d nor slowed down, walks the blocks of the backing allocator and of every  *
+ *  sub-heap, and prints a fragmentation map of each: one character per cell o *
+ *  f the map, darker with the share of its bytes in use, followed by the free *
+ *  space, largest free block and free block sizes.                            *
+ *                                                                             *
+ *  If the map was built with ALLOCATOR_PROFILE and sampling is on (see Shared *
+ *  _Allocator::set_sample_period()), the sampled blocks found live by the wal *
+ *  k are summed per call site. The top sites are printed, and the whole profi *
+ *  le is written to the given file in the legacy pprof heap format (heap_v2,  *
+ *  so pprof scales the samples back up), with the mappings of a process that  *
+ *  sampled, for symbols: pprof --text <binary> <profile>.                     *
+ *                                                                             *
+ *  Usage: heap_dump <map name> [profile file] [columns]. Build with make heap *
+ *  _dump; the processes using the map must be built with ALLOCATOR_PROFILE to *
+ *  o, as it changes the layout of the map.                                    *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+// C++ libraries
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <string>
+#include <memory>
+#include <cmath>
+
+// C libraries
+extern "C" {
+	#include <stdlib.h>
+	#include <signal.h>
+}
+
+// Custom headers
+#include "shared_allocator.cpp"
+
+
+// Default number of cells per line of the fragmentation map
+#define DUMP_DEFAULT_COLUMNS         64
+
+// Lines of the fragmentation map of each allocator map
+#define DUMP_ROWS                    8
+
+// Walks of a map attempted before reporting a torn one
+#define DUMP_WALK_RETRIES            3
+
+// Call sites printed (all of them go into the profile)
+#define DUMP_TOP_SITES               10
+
+
+// Cell shades, from unused to fully used
+static char const DUMP_SHADES[] = " .:-=+*#";
+
+// Structure: Usage of one call site, summed over the maps
+typedef struct site_report_t {
+	std::vector<uint64_t> frames;  // Return addresses, innermost first
+	int32_t pid;                   // Process that first sampled the site
+	uint64_t n_live;               // Sampled blocks live in the walk
+	uint64_t n_live_bytes;         // Bytes they requested
+	uint64_t n_allocations;        // Sampled allocations, freed ones included
+	uint64_t n_bytes;              // Bytes they requested
+} site_report_t;
+
+// Structure: Block visited by the walk
+typedef struct block_visit_t {
+	size_t offset;                 // Offset of the block header in its map
+	size_t n_bytes;                // Size of the block (header included)
+	block_state_t state;
+} block_visit_t;
+
+
+// Walk the blocks of a map into blocks. Returns false if every walk was torn
+static bool walk (Static_Allocator<uint8_t> const &allocator, std::vector<block_visit_t> &blocks)
+{
+	for (size_t i = 0; i < DUMP_WALK_RETRIES; ++i) {
+		blocks.clear();
+		if (allocator.for_each_block([&] (size_t offset, size_t n_bytes, block_state_t state) {
+			blocks.push_back({offset, n_bytes, state});
+		})) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Print the summary and fragmentation map of one allocator map
+static void report_map (std::string const &name, size_t capacity,
+	std::vector<block_visit_t> const &blocks, bool complete, size_t n_columns)
+{
+	size_t n_cells = n_columns * DUMP_ROWS;
+	size_t cell_size = std::max<size_t>(1, (capacity + n_cells - 1) / n_cells);
+	std::vector<size_t> cell_used(n_cells, 0);
+	std::map<size_t, size_t> free_sizes;   // Power of two -> free blocks up to it
+	size_t n_used = 0, n_free = 0, n_quick = 0;
+	size_t used_bytes = 0, free_bytes = 0, largest_free = 0;
+
+	for (block_visit_t const &b : blocks) {
+
+		// Case: Free (quick-listed blocks count as free, with their own tally)
+		if (b.state != BLOCK_USED) {
+			size_t bucket = 1;
+			while (bucket < b.n_bytes) {
+				bucket <<= 1;
+			}
+			free_sizes[bucket]++;
+			free_bytes += b.n_bytes;
+			largest_free = std::max(largest_free, b.n_bytes);
+			(b.state == BLOCK_FREE) ? n_free++ : n_quick++;
+			continue;
+		}
+
+		// Spread the used bytes over the cells the block covers
+		n_used++;
+		used_bytes += b.n_bytes;
+		for (size_t start = b.offset, end = b.offset + b.n_bytes; start < end; ) {
+			size_t cell = start / cell_size;
+			size_t cell_end = std::min(end, (cell + 1) * cell_size);
+			cell_used[std::min(cell, n_cells - 1)] += cell_end - start;
+			start = cell_end;
+		}
+	}
+
+	std::cout << name << ": " << capacity << " bytes, " << used_bytes << " used in "
+		<< n_used << " blocks, " << free_bytes << " free in " << n_free << " blocks";
+	if (n_quick != 0) {
+		std::cout << " (" << n_quick << " quick-listed)";
+	}
+	std::cout << ", largest free " << largest_free << ", fragmentation "
+		<< std::fixed << std::setprecision(1)
+		<< ((free_bytes == 0) ? 0.0 : 100.0 * (1.0 - static_cast<double>(largest_free) /
+		static_cast<double>(free_bytes))) << "%" << std::endl;
+	if (!complete) {
+		std::cout << "  (walk stopped at a header torn by a concurrent update)" << std::endl;
+	}
+
+	// Free block sizes
+	if (!free_sizes.empty()) {
+		std::cout << "  free blocks by size:";
+		for (auto const &bucket : free_sizes) {
+			std::cout << " <=" << bucket.first << ":" << bucket.second;
+		}
+		std::cout << std::endl;
+	}
+
+	// Fragmentation map (one cell is cell_size bytes)
+	std::cout << "  map (" << cell_size << " bytes per cell, '" << DUMP_SHADES[0]
+		<< "' free to '" << DUMP_SHADES[sizeof(DUMP_SHADES) - 2] << "' in use):" << std::endl;
+	for (size_t row = 0; row < DUMP_ROWS; ++row) {
+		std::cout << "  |";
+		for (size_t column = 0; column < n_columns; ++column) {
+			size_t cell = row * n_columns + column;
+			double used = static_cast<double>(cell_used[cell]) / static_cast<double>(cell_size);
+			size_t shade = static_cast<size_t>(used * (sizeof(DUMP_SHADES) - 2) + 0.5);
+			std::cout << DUMP_SHADES[std::min(shade, sizeof(DUMP_SHADES) - 2)];
+		}
+		std::cout << "|" << std::endl;
+	}
+}
+
+#if defined(ALLOCATOR_PROFILE)
+// Add the sampled blocks of a map found live by the walk to sites. Returns
+// the sampling period of the map (0 if it has no profile)
+static uint64_t collect_sites (Static_Allocator<uint8_t> const &allocator,
+	std::vector<block_visit_t> const &blocks, std::map<uint64_t, site_report_t> &sites,
+	bool &consistent)
+{
+	profile_table_t const *table = allocator.profile_table();
+	std::vector<bool> live;
+
+	if (table == nullptr) {
+		return 0;
+	}
+
+	std::unique_ptr<profile_table_t> copy(static_cast<profile_table_t *>(
+		::operator new(sizeof(profile_table_t))));
+	consistent &= profile_table_snapshot(table, copy.get());
+
+	// Blocks in use, by unit (sampled blocks freed since are skipped)
+	size_t unit_size = alignof(max_align_t);
+	size_t capacity = allocator.allocator_info_p()->capacity;
+	live.assign(capacity / unit_size + 1, false);
+	for (block_visit_t const &b : blocks) {
+		if (b.state == BLOCK_USED) {
+			live[b.offset / unit_size] = true;
+		}
+	}
+
+	for (profile_site_t const &s : copy->sites) {
+		if (s.hash == 0) {
+			continue;
+		}
+		site_report_t &r = sites[s.hash];
+		if (r.frames.empty()) {
+			r.frames.assign(s.frames, s.frames + std::min<size_t>(s.n_frames,
+				ALLOCATOR_PROFILE_DEPTH));
+			r.pid = s.pid;
+		}
+		r.n_allocations += s.n_allocations;
+		r.n_bytes += s.n_bytes;
+	}
+	for (profile_block_t const &b : copy->blocks) {
+		if (b.offset == 0 || b.offset >= capacity || !live[b.offset / unit_size] ||
+			b.site >= ALLOCATOR_PROFILE_SITES || copy->sites[b.site].hash == 0) {
+			continue;
+		}
+		site_report_t &r = sites[copy->sites[b.site].hash];
+		r.n_live++;
+		r.n_live_bytes += b.n_bytes;
+	}
+
+	return copy->period;
+}
+
+// Inline method: Bytes a site holds, scaled up from its samples
+static inline double scaled_bytes (site_report_t const &r, uint64_t period)
+{
+	if (r.n_live == 0 || period == 0) {
+		return static_cast<double>(r.n_live_bytes);
+	}
+	double mean = static_cast<double>(r.n_live_bytes) / static_cast<double>(r.n_live);
+	return static_cast<double>(r.n_live_bytes) / (1.0 - std::exp(-mean / static_cast<double>(period)));
+}
+
+// Write sites in the legacy pprof heap profile format
+static bool write_profile (char const *path, std::map<uint64_t, site_report_t> const &sites,
+	uint64_t period)
+{
+	std::ofstream out(path);
+	uint64_t n_live = 0, n_live_bytes = 0, n_allocations = 0, n_bytes = 0;
+	int32_t pid = 0;
+
+	for (auto const &site : sites) {
+		n_live += site.second.n_live;
+		n_live_bytes += site.second.n_live_bytes;
+		n_allocations += site.second.n_allocations;
+		n_bytes += site.second.n_bytes;
+	}
+
+	out << "heap profile: " << n_live << ": " << n_live_bytes << " [" << n_allocations
+		<< ": " << n_bytes << "] @ heap_v2/" << std::max<uint64_t>(period, 1) << "\n";
+	for (auto const &site : sites) {
+		site_report_t const &r = site.second;
+		out << r.n_live << ": " << r.n_live_bytes << " [" << r.n_allocations << ": "
+			<< r.n_bytes << "] @" << std::hex;
+		for (uint64_t frame : r.frames) {
+			out << " 0x" << frame;
+		}
+		out << std::dec << "\n";
+
+		// Mappings of the first sampling process still alive
+		if (pid == 0 && r.pid > 0 && kill(r.pid, 0) == 0) {
+			pid = r.pid;
+		}
+	}
+
+	// Mappings, for pprof to symbolise the frames
+	std::ifstream maps("/proc/" + std::to_string(pid) + "/maps");
+	if (pid != 0 && maps) {
+		out << "\nMAPPED_LIBRARIES:\n" << maps.rdbuf();
+	} else {
+		std::cerr << "No sampling process alive, profile written without mappings" << std::endl;
+	}
+
+	return static_cast<bool>(out);
+}
+#endif
+
+int main (int argc, char *argv[])
+{
+	char const *map_name = (argc > 1) ? argv[1] : nullptr;
+	char const *profile_path = (argc > 2) ? argv[2] : nullptr;
+	size_t n_columns = (argc > 3) ? strtoul(argv[3], nullptr, 10) : DUMP_DEFAULT_COLUMNS;
+
+	if (map_name == nullptr || n_columns == 0) {
+		std::cerr << "Usage: " << argv[0] << " <map name> [profile file] [columns]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::map<uint64_t, site_report_t> sites;
+	uint64_t period = 0;
+	bool consistent = true;
+
+	try {
+		Shared_Allocator<uint8_t>::inspect(map_name, [&] (Static_Allocator<uint8_t> allocator,
+			int heap)
+		{
+			std::vector<block_visit_t> blocks;
+			bool complete = walk(allocator, blocks);
+
+			report_map((heap < 0) ? std::string("backing allocator") :
+				"heap " + std::to_string(heap), allocator.allocator_info_p()->capacity,
+				blocks, complete, n_columns);
+#if defined(ALLOCATOR_PROFILE)
+			period = std::max(period, collect_sites(allocator, blocks, sites, consistent));
+#endif
+		});
+	} catch (std::exception const &e) {
+		std::cerr << map_name << ": " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+#if defined(ALLOCATOR_PROFILE)
+	if (sites.empty()) {
+		std::cout << "No sampled allocations (see set_sample_period())" << std::endl;
+		return EXIT_SUCCESS;
+	}
+	if (!consistent) {
+		std::cout << "(profile copied while being updated, counts may be off by one)" << std::endl;
+	}
+
+	// Top sites by bytes held
+	std::vector<site_report_t const *> top;
+	for (auto const &site : sites) {
+		top.push_back(&(site.second));
+	}
+	std::sort(top.begin(), top.end(), [] (site_report_t const *a, site_report_t const *b) {
+		return a->n_live_bytes > b->n_live_bytes;
+	});
+
+	std::cout << "sites (sampled every " << period << " bytes, held bytes scaled up):" << std::endl
+		<< std::right << std::setw(14) << "held" << std::setw(10) << "samples"
+		<< std::setw(14) << "allocated" << "  frames" << std::endl;
+	for (size_t i = 0; i < top.size() && i < DUMP_TOP_SITES; ++i) {
+		std::cout << std::setw(14) << std::setprecision(0) << scaled_bytes(*top[i], period)
+			<< std::setw(10) << top[i]->n_live << std::setw(14) << top[i]->n_bytes << " " << std::hex;
+		for (size_t k = 0; k < top[i]->frames.size() && k < 4; ++k) {
+			std::cout << " 0x" << top[i]->frames[k];
+		}
+		std::cout << std::dec << std::endl;
+	}
+
+	if (profile_path != nullptr && !write_profile(profile_path, sites, period)) {
+		std::cerr << profile_path << ": cannot write profile" << std::endl;
+		return EXIT_FAILURE;
+	}
+#else
+	(void)profile_path;
+	(void)consistent;
+	(void)period;
+#endif
+
+	return EXIT_SUCCESS;
+}
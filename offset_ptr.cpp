@@ -0,0 +1,312 @@
+#if !defined(OFFSET_PTR_H)
+#define OFFSET_PTR_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Self-relative fancy pointer. Stores the distance from its own address to t *
+ *  he pointee instead of the pointee's address, so a pointer stored in a shar *
+ *  ed map remains valid in every process that maps it, wherever the map is pl *
+ *  aced. It satisfies the NullablePointer and random access iterator require  *
+ *  ments, and may be used as the pointer type of an allocator.                *
+ *                                                                             *
+ *  Copying recomputes the distance, so an Offset_Ptr is not trivially copyabl *
+ *  e: do not memcpy it, and only dereference it in the process it was assigne *
+ *  d in unless both it and its pointee live in the same map.                  *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+template <class T>
+class Offset_Ptr
+{
+private:
+
+    // Distance from this object to the pointee (NULL_OFFSET if null). One
+    // byte past itself is never a valid pointee of an object-sized pointer
+    static constexpr std::ptrdiff_t NULL_OFFSET = 1;
+
+    // Distance in bytes
+    std::ptrdiff_t d_offset;
+
+
+    // Inline method: Distance from this object to ptr
+    inline std::ptrdiff_t offset_to (void const volatile *ptr) const
+    {
+        if (ptr == nullptr) {
+            return NULL_OFFSET;
+        }
+        return reinterpret_cast<uint8_t const volatile *>(ptr) -
+            reinterpret_cast<uint8_t const volatile *>(this);
+    }
+
+public:
+
+    // Alias: Pointee type
+    using element_type       = T;
+
+    // Alias: Value types
+    using value_type         = typename std::remove_cv<T>::type;
+
+    // Alias: Difference between pointers
+    using difference_type    = std::ptrdiff_t;
+
+    // Alias: Self (iterator requirements)
+    using pointer            = Offset_Ptr<T>;
+
+    // Alias: Reference
+    using reference          = typename std::add_lvalue_reference<T>::type;
+
+    // Alias: Iterator category
+    using iterator_category  = std::random_access_iterator_tag;
+
+    // Rebinding support: Pointer to arbitrary type
+    template <class U>
+    using rebind             = Offset_Ptr<U>;
+
+
+    // Null constructor
+    Offset_Ptr () noexcept:
+        d_offset(NULL_OFFSET)
+    {
+        // Nothing to do
+    }
+
+    // Null constructor
+    Offset_Ptr (std::nullptr_t) noexcept:
+        d_offset(NULL_OFFSET)
+    {
+        // Nothing to do
+    }
+
+    // Constructor
+    Offset_Ptr (T *ptr) noexcept:
+        d_offset(offset_to(ptr))
+    {
+        // Nothing to do
+    }
+
+    // Copy constructor
+    Offset_Ptr (const Offset_Ptr &origin) noexcept:
+        d_offset(offset_to(origin.get()))
+    {
+        // Nothing to do
+    }
+
+    // Support for converting pointers
+    template <class U, class = typename std::enable_if<
+        std::is_convertible<U *, T *>::value>::type>
+    Offset_Ptr (const Offset_Ptr<U> &origin) noexcept:
+        d_offset(offset_to(static_cast<T *>(origin.get())))
+    {
+        // Nothing to do
+    }
+
+    // Support for explicitly converting pointers (e.g. from void)
+    template <class U, class = typename std::enable_if<
+        !std::is_convertible<U *, T *>::value>::type, class = void>
+    explicit Offset_Ptr (const Offset_Ptr<U> &origin) noexcept:
+        d_offset(offset_to(static_cast<T *>(origin.get())))
+    {
+        // Nothing to do
+    }
+
+    // Operator: Copy assignment
+    Offset_Ptr &operator= (const Offset_Ptr &origin) noexcept
+    {
+        d_offset = offset_to(origin.get());
+        return *this;
+    }
+
+    // Operator: Assignment from raw pointer
+    Offset_Ptr &operator= (T *ptr) noexcept
+    {
+        d_offset = offset_to(ptr);
+        return *this;
+    }
+
+    // Returns the raw pointer
+    T *get () const noexcept
+    {
+        uintptr_t address = (d_offset == NULL_OFFSET) ? 0 :
+            reinterpret_cast<uintptr_t>(this) + d_offset;
+
+        // Opaque to the compiler's object-size analysis: the pointee is never
+        // part of this object, and callers that checked for null never take
+        // the null path. Either would otherwise be traced through the address
+        // and flagged as an overflow on every access (-Wstringop-overflow)
+        __asm__ ("" : "+r" (address));
+        return reinterpret_cast<T *>(address);
+    }
+
+    // Pointer to an object (pointer_traits requirement)
+    template <class U = T>
+    static Offset_Ptr pointer_to (U &r) noexcept
+    {
+        return Offset_Ptr(std::addressof(r));
+    }
+
+    // Operator: Dereference
+    reference operator* () const
+    {
+        return *get();
+    }
+
+    // Operator: Member access
+    T *operator-> () const noexcept
+    {
+        return get();
+    }
+
+    // Operator: Subscript
+    reference operator[] (difference_type i) const
+    {
+        return get()[i];
+    }
+
+    // Operator: Test for null
+    explicit operator bool () const noexcept
+    {
+        return d_offset != NULL_OFFSET;
+    }
+
+    // Operator: Pre-increment
+    Offset_Ptr &operator++ () noexcept
+    {
+        d_offset += sizeof(T);
+        return *this;
+    }
+
+    // Operator: Post-increment
+    Offset_Ptr operator++ (int) noexcept
+    {
+        Offset_Ptr origin(*this);
+        ++(*this);
+        return origin;
+    }
+
+    // Operator: Pre-decrement
+    Offset_Ptr &operator-- () noexcept
+    {
+        d_offset -= sizeof(T);
+        return *this;
+    }
+
+    // Operator: Post-decrement
+    Offset_Ptr operator-- (int) noexcept
+    {
+        Offset_Ptr origin(*this);
+        --(*this);
+        return origin;
+    }
+
+    // Operator: Advance
+    Offset_Ptr &operator+= (difference_type n) noexcept
+    {
+        d_offset += n * static_cast<difference_type>(sizeof(T));
+        return *this;
+    }
+
+    // Operator: Retreat
+    Offset_Ptr &operator-= (difference_type n) noexcept
+    {
+        d_offset -= n * static_cast<difference_type>(sizeof(T));
+        return *this;
+    }
+
+    // Operator: Offset
+    friend Offset_Ptr operator+ (Offset_Ptr p, difference_type n) noexcept
+    {
+        return Offset_Ptr(p.get() + n);
+    }
+
+    // Operator: Offset
+    friend Offset_Ptr operator+ (difference_type n, Offset_Ptr p) noexcept
+    {
+        return Offset_Ptr(p.get() + n);
+    }
+
+    // Operator: Offset
+    friend Offset_Ptr operator- (Offset_Ptr p, difference_type n) noexcept
+    {
+        return Offset_Ptr(p.get() - n);
+    }
+
+    // Operator: Distance
+    friend difference_type operator- (const Offset_Ptr &a, const Offset_Ptr &b) noexcept
+    {
+        return a.get() - b.get();
+    }
+
+    // Operators: Comparison
+    friend bool operator== (const Offset_Ptr &a, const Offset_Ptr &b) noexcept
+    {
+        return a.get() == b.get();
+    }
+
+    friend bool operator!= (const Offset_Ptr &a, const Offset_Ptr &b) noexcept
+    {
+        return a.get() != b.get();
+    }
+
+    friend bool operator< (const Offset_Ptr &a, const Offset_Ptr &b) noexcept
+    {
+        return a.get() < b.get();
+    }
+
+    friend bool operator> (const Offset_Ptr &a, const Offset_Ptr &b) noexcept
+    {
+        return a.get() > b.get();
+    }
+
+    friend bool operator<= (const Offset_Ptr &a, const Offset_Ptr &b) noexcept
+    {
+        return a.get() <= b.get();
+    }
+
+    friend bool operator>= (const Offset_Ptr &a, const Offset_Ptr &b) noexcept
+    {
+        return a.get() >= b.get();
+    }
+
+    friend bool operator== (const Offset_Ptr &a, std::nullptr_t) noexcept
+    {
+        return !a;
+    }
+
+    friend bool operator!= (const Offset_Ptr &a, std::nullptr_t) noexcept
+    {
+        return static_cast<bool>(a);
+    }
+
+    friend bool operator== (std::nullptr_t, const Offset_Ptr &a) noexcept
+    {
+        return !a;
+    }
+
+    friend bool operator!= (std::nullptr_t, const Offset_Ptr &a) noexcept
+    {
+        return static_cast<bool>(a);
+    }
+};
+
+
+
+// Alias: Raw pointer, for use where an Offset_Ptr is accepted as parameter
+template <class T>
+using Raw_Ptr = T *;
+
+#endif
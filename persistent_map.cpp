@@ -0,0 +1,395 @@
+#if !defined(PERSISTENT_MAP_H)
+#define PERSISTENT_MAP_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Persistent heap: a Static_Allocator map in a memory-mapped regular file (o *
+ *  r a file on a DAX device). Since the allocator keeps all of its state, as  *
+ *  offsets, inside the map, reopening the file restores the heap and every ob *
+ *  ject in it wherever the file is mapped, without deserialisation. A root of *
+ *  fset (see set_root()) lets the reopening process find its data again.      *
+ *                                                                             *
+ *  The file starts with a persistent_header_t holding a magic number, a layou *
+ *  t version, the build options changing the allocator layout (ALLOCATOR_FEAT *
+ *  URES) and the size of the map, protected by a checksum, and a flag which i *
+ *  s cleared while the file is open. A file written by a build with other opt *
+ *  ions is rejected. Reopening a cleanly closed file is a matter of mapping i *
+ *  t. Otherwise the allocator metadata is rebuilt from the block headers (see *
+ *  Static_Allocator::recover()), which the allocator writes in an order that  *
+ *  keeps them consistent at every store.                                      *
+ *                                                                             *
+ *  After a crash of the process, the page cache holds every store, so the hea *
+ *  p always recovers. After a power failure, only what was flushed by sync()  *
+ *  or persist() (or written back by the kernel) is guaranteed to be on disk;  *
+ *  recovery then throws if the block headers on disk are torn. The map must b *
+ *  e serialised by the caller, like the Static_Allocator.                     *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+// C++ libraries
+#include <system_error>
+#include <stdexcept>
+#include <cstddef>
+
+// C libraries
+extern "C" {
+	#include <string.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+}
+
+// Custom headers
+#include "static_allocator.cpp"
+
+
+// Magic number identifying a persistent map file ("PMAP")
+#define PERSISTENT_MAP_MAGIC         0x504d4150
+
+// Layout version of the file (bump on any layout change, of the allocator too)
+#define PERSISTENT_MAP_VERSION       2
+
+// Offset of the allocator map within the file (header rounded up to a cache line)
+#define PERSISTENT_MAP_OFFSET        64
+
+
+// Structure: Header at the start of a persistent map file
+typedef struct persistent_header_t {
+	uint32_t magic;               // PERSISTENT_MAP_MAGIC
+	uint32_t version;             // PERSISTENT_MAP_VERSION
+	uint32_t features;            // ALLOCATOR_FEATURES of the build that created it
+	uint64_t capacity;            // Size of the allocator map
+	uint64_t map_offset;          // Offset of the allocator map in the file
+	uint64_t checksum;            // Of the fields above
+	uint32_t clean;               // Set when closed, cleared while open
+	uint32_t recovered;           // Times the map was recovered after a crash
+	uint64_t root;                // Offset of the root object in the map (0 = none)
+} persistent_header_t;
+
+static_assert(sizeof(persistent_header_t) <= PERSISTENT_MAP_OFFSET,
+	"Header must fit before the allocator map");
+
+
+class Persistent_Map
+{
+private:
+
+	// File descriptor of the backing file
+	int d_fd;
+
+	// Mapping of the whole file
+	persistent_header_t *d_header_p;
+
+	// Allocator over the map in the file
+	Static_Allocator<uint8_t> d_allocator;
+
+	// Whether the last open recovered the map
+	bool d_recovered;
+
+
+	// Inline method: Checksum of the immutable header fields (FNV-1a)
+	static inline uint64_t checksum_of (persistent_header_t const *header)
+	{
+		uint64_t fields[] = {header->magic, header->version, header->features,
+			header->capacity, header->map_offset};
+		uint64_t hash = 14695981039346656037ULL;
+		for (uint64_t field : fields) {
+			for (size_t i = 0; i < sizeof(field); ++i) {
+				hash = (hash ^ ((field >> (8 * i)) & 0xff)) * 1099511628211ULL;
+			}
+		}
+		return hash;
+	}
+
+	// Inline method: Start of the allocator map
+	inline uint8_t *map () const
+	{
+		return reinterpret_cast<uint8_t *>(d_header_p) + d_header_p->map_offset;
+	}
+
+	// Flush a range of the mapping (rounded out to pages) to the file
+	void flush (void const *ptr, size_t n_bytes) const
+	{
+		size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		uintptr_t start = reinterpret_cast<uintptr_t>(ptr) & ~(page_size - 1);
+		uintptr_t end = reinterpret_cast<uintptr_t>(ptr) + n_bytes;
+
+		if (msync(reinterpret_cast<void *>(start), end - start, MS_SYNC) == -1)
+		{
+			throw std::system_error(errno, std::generic_category(), "msync");
+		}
+	}
+
+	// Map the whole file, closing it on failure
+	void map_file (size_t file_size)
+	{
+		void *ptr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			d_fd, 0);
+
+		if (ptr == MAP_FAILED) {
+			int err = errno;
+			close(d_fd);
+			throw std::system_error(err, std::generic_category(), "mmap");
+		}
+		d_header_p = reinterpret_cast<persistent_header_t *>(ptr);
+	}
+
+	// Release the mapping and file (on failure during construction)
+	void release (size_t file_size)
+	{
+		ALLOCATOR_ANNOTATE_TAGS(d_header_p, file_size);
+		munmap(d_header_p, file_size);
+		close(d_fd);
+	}
+
+	// Whether the file holds no map yet: it is empty, or was left by a
+	// create() that failed before writing the magic number (written last)
+	bool is_blank (size_t file_size) const
+	{
+		uint32_t magic = 0;
+		return file_size == 0 || (pread(d_fd, &magic, sizeof(magic), 0) ==
+			static_cast<ssize_t>(sizeof(magic)) && magic == 0);
+	}
+
+	// Install a new map in a blank file
+	void create (size_t capacity)
+	{
+		size_t file_size = PERSISTENT_MAP_OFFSET + capacity;
+
+		// Check: Capacity holds a map (the file is not sized otherwise)
+		if (capacity < Static_Allocator<uint8_t>::MIN_CAPACITY) {
+			close(d_fd);
+			throw std::invalid_argument("Capacity too small for a persistent map");
+		}
+
+		if (ftruncate(d_fd, static_cast<off_t>(file_size)) == -1) {
+			int err = errno;
+			close(d_fd);
+			throw std::system_error(err, std::generic_category(), "ftruncate");
+		}
+		map_file(file_size);
+
+		try {
+			d_allocator = Static_Allocator<uint8_t>(
+				reinterpret_cast<uint8_t *>(d_header_p) + PERSISTENT_MAP_OFFSET, capacity);
+
+			// Make the map durable before the header that validates it
+			flush(reinterpret_cast<uint8_t *>(d_header_p) + PERSISTENT_MAP_OFFSET, capacity);
+			d_header_p->version = PERSISTENT_MAP_VERSION;
+			d_header_p->features = ALLOCATOR_FEATURES;
+			d_header_p->capacity = capacity;
+			d_header_p->map_offset = PERSISTENT_MAP_OFFSET;
+			d_header_p->clean = 0;
+			d_header_p->recovered = 0;
+			d_header_p->root = 0;
+
+			// The magic number last, so a file without it is blank
+			persistent_header_t header = *d_header_p;
+			header.magic = PERSISTENT_MAP_MAGIC;
+			d_header_p->checksum = checksum_of(&header);
+			d_header_p->magic = PERSISTENT_MAP_MAGIC;
+			flush(d_header_p, sizeof(persistent_header_t));
+		} catch (...) {
+			release(file_size);
+			throw;
+		}
+	}
+
+	// Open the map in an existing file, recovering it if not closed cleanly
+	void open_existing (size_t file_size)
+	{
+		// Check: File holds at least a header
+		if (file_size < PERSISTENT_MAP_OFFSET) {
+			close(d_fd);
+			throw std::runtime_error("Persistent map has invalid header");
+		}
+		map_file(file_size);
+
+		// Check: Header is intact and describes this file
+		if (d_header_p->magic != PERSISTENT_MAP_MAGIC ||
+			d_header_p->version != PERSISTENT_MAP_VERSION ||
+			d_header_p->checksum != checksum_of(d_header_p) ||
+			d_header_p->map_offset + d_header_p->capacity != file_size)
+		{
+			release(file_size);
+			throw std::runtime_error("Persistent map has invalid header");
+		}
+
+		// Check: Allocator metadata has the layout of this build
+		if (d_header_p->features != ALLOCATOR_FEATURES) {
+			release(file_size);
+			throw std::runtime_error("Persistent map was built with other allocator options");
+		}
+
+		try {
+			d_allocator = Static_Allocator<uint8_t>::attach(map());
+
+			// Case: Not closed cleanly, rebuild the metadata and make it durable
+			if (d_header_p->clean == 0) {
+				d_allocator.recover();
+				flush(map(), d_header_p->capacity);
+				d_header_p->recovered++;
+				d_recovered = true;
+			}
+
+			// Mark open
+			d_header_p->clean = 0;
+			flush(d_header_p, sizeof(persistent_header_t));
+		} catch (...) {
+			release(file_size);
+			throw;
+		}
+	}
+
+	// Constructor: Open the map in file path (opened with flags), creating
+	// one of capacity bytes in a blank file if flags hold O_CREAT
+	Persistent_Map (char const *path, size_t capacity, int flags):
+		d_fd(-1), d_header_p(nullptr), d_recovered(false)
+	{
+		struct stat file_stat;
+
+		// Parameter check: Is path valid
+		if (path == nullptr) {
+			throw std::invalid_argument("Cannot open nullptr!");
+		}
+
+		if ((d_fd = open(path, O_RDWR | flags, S_IRUSR | S_IWUSR)) == -1) {
+			throw std::system_error(errno, std::generic_category(), "open");
+		}
+
+		if (fstat(d_fd, &file_stat) == -1) {
+			int err = errno;
+			close(d_fd);
+			throw std::system_error(err, std::generic_category(), "fstat");
+		}
+
+		// Case: No map in the file yet
+		if (is_blank(static_cast<size_t>(file_stat.st_size))) {
+			if ((flags & O_CREAT) == 0) {
+				close(d_fd);
+				throw std::runtime_error("Persistent map file holds no map");
+			}
+			create(capacity);
+			return;
+		}
+
+		open_existing(static_cast<size_t>(file_stat.st_size));
+
+		// Check: Existing map has the requested capacity
+		if (capacity != 0 && capacity != d_header_p->capacity) {
+			size_t file_size = d_header_p->map_offset + d_header_p->capacity;
+			d_header_p->clean = 1;
+			flush(d_header_p, sizeof(persistent_header_t));
+			release(file_size);
+			throw std::invalid_argument("Persistent map has a different capacity");
+		}
+	}
+
+public:
+
+	// Constructor: Open the map in file path, or create one of capacity bytes
+	// if the file is blank or does not exist. An existing map must have the
+	// capacity, unless it is zero
+	Persistent_Map (char const *path, size_t capacity):
+		Persistent_Map(path, capacity, O_CREAT)
+	{
+		// Nothing to do
+	}
+
+	// Constructor: Open the map in an existing file, of any capacity
+	explicit Persistent_Map (char const *path):
+		Persistent_Map(path, 0, 0)
+	{
+		// Nothing to do
+	}
+
+	Persistent_Map (const Persistent_Map &) = delete;
+	Persistent_Map &operator= (const Persistent_Map &) = delete;
+
+	// Destructor: Flush everything, then mark the file clean
+	~Persistent_Map () noexcept(false)
+	{
+		size_t file_size = d_header_p->map_offset + d_header_p->capacity;
+
+		flush(map(), d_header_p->capacity);
+		d_header_p->clean = 1;
+		flush(d_header_p, sizeof(persistent_header_t));
+
+		// Unmap (with no annotations of the map left behind)
+		ALLOCATOR_ANNOTATE_TAGS(d_header_p, file_size);
+		if (munmap(d_header_p, file_size) == -1) {
+			throw std::system_error(errno, std::generic_category(), "munmap");
+		}
+		if (close(d_fd) == -1) {
+			throw std::system_error(errno, std::generic_category(), "close");
+		}
+	}
+
+	// Allocator over the map (e.g. for containers kept in the file)
+	template <class U = uint8_t>
+	Static_Allocator<U> allocator () const
+	{
+		return Static_Allocator<U>(d_allocator);
+	}
+
+	// Object recorded by set_root() (nullptr if none)
+	template <class U>
+	U *root () const
+	{
+		if (d_header_p->root == 0) {
+			return nullptr;
+		}
+		return reinterpret_cast<U *>(map() + d_header_p->root);
+	}
+
+	// Record the object to find again after reopening (nullptr to clear)
+	void set_root (void const *ptr)
+	{
+		uint8_t const *obj_addr = reinterpret_cast<uint8_t const *>(ptr);
+
+		// Parameter check: Pointer address range
+		if (ptr != nullptr && !(obj_addr > map() &&
+			obj_addr < map() + d_header_p->capacity))
+		{
+			throw std::invalid_argument("Pointer originates outside valid bounds");
+		}
+
+		d_header_p->root = (ptr == nullptr) ? 0 : obj_addr - map();
+	}
+
+	// Flush point: Make every change to the map durable
+	void sync () const
+	{
+		flush(d_header_p, d_header_p->map_offset + d_header_p->capacity);
+	}
+
+	// Flush point: Make changes to n bytes at ptr durable
+	void persist (void const *ptr, size_t n_bytes) const
+	{
+		flush(ptr, n_bytes);
+	}
+
+	// Whether opening the map required a recovery
+	bool recovered () const
+	{
+		return d_recovered;
+	}
+
+	// Number of recoveries over the lifetime of the file
+	size_t n_recoveries () const
+	{
+		return d_header_p->recovered;
+	}
+};
+
+#endif
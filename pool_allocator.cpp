@@ -0,0 +1,346 @@
+#if !defined(POOL_ALLOCATOR_H)
+#define POOL_ALLOCATOR_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Fixed-size object pool (slab) allocator for node-based containers. Metadat *
+ *  a is installed within the provided static memory, followed by a Static_All *
+ *  ocator that manages the remainder of the map.                              *
+ *                                                                             *
+ *  Requests of up to POOL_MAX_SLOT_SIZE bytes are served from per-size-class  *
+ *  pools. Each pool carves slabs of equally sized slots out of the backing St *
+ *  atic_Allocator and keeps free slots on an intrusive stack, so slots carry  *
+ *  no header and allocation and deallocation are constant time. Because a re *
+ *  bound allocator selects its pool from sizeof(U), std::list and std::map n *
+ *  odes land in dense slabs of their own. Larger requests are forwarded to th *
+ *  e backing allocator. Slabs are not returned to the backing allocator.      *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+#include <iostream>
+#include <vector>
+#include <new>
+
+// Custom headers
+#include "static_allocator.cpp"
+
+
+// Granularity of the slot size classes
+#define POOL_SLOT_GRANULARITY        alignof(max_align_t)
+
+// Largest request served from a pool (bytes)
+#define POOL_MAX_SLOT_SIZE           256
+
+// Default slab size (bytes)
+#define POOL_DEFAULT_SLAB_SIZE       4096
+
+
+template <class T>
+class Pool_Allocator
+{
+private:
+
+    // Structure: Free slot (stack link installed in the slot itself)
+    typedef struct slot_t {
+        struct slot_t *next;         // Next free slot
+    } slot_t;
+
+    // Structure: Pool of equally sized slots
+    typedef struct pool_t {
+        slot_t *free_slots;          // Stack of free slots
+        size_t n_free;               // Number of slots on the stack
+    } pool_t;
+
+    // Number of size classes
+    static constexpr size_t POOL_CLASS_COUNT =
+        POOL_MAX_SLOT_SIZE / POOL_SLOT_GRANULARITY;
+
+    // Structure: Allocator information
+    typedef struct pool_info_t {
+        Static_Allocator<uint8_t> backing;  // Allocator for slabs and large requests
+        size_t slab_size;                   // Preferred slab size (bytes)
+        pool_t pools[POOL_CLASS_COUNT];     // Pools indexed by size class
+    } pool_info_t;
+
+    // Pointer to Allocator information (nested within memory block)
+    pool_info_t *d_pool_info_p;
+
+
+    // Inline method: Whether a request is served from a pool
+    static inline bool is_pooled (size_t n_bytes)
+    {
+        return n_bytes <= POOL_MAX_SLOT_SIZE;
+    }
+
+    // Inline method: Size class of a pooled request
+    static inline size_t class_of (size_t n_bytes)
+    {
+        return (n_bytes + POOL_SLOT_GRANULARITY - 1) / POOL_SLOT_GRANULARITY - 1;
+    }
+
+    // Refill a pool with a new slab (false if the backing memory is exhausted)
+    bool refill (size_t class_index)
+    {
+        size_t slot_size = (class_index + 1) * POOL_SLOT_GRANULARITY;
+        pool_t *pool = &(d_pool_info_p->pools[class_index]);
+        uint8_t *slab = nullptr;
+        size_t slab_size = d_pool_info_p->slab_size;
+
+        // Shrink the slab until it fits (down to a single slot)
+        for (; slab_size >= slot_size; slab_size /= 2) {
+            if ((slab = reinterpret_cast<uint8_t *>(
+                d_pool_info_p->backing.allocate_b(slab_size))) != nullptr) {
+                break;
+            }
+        }
+
+        if (slab == nullptr) {
+            return false;
+        }
+
+        // Push all slots on the stack
+        for (size_t i = 0; i + slot_size <= slab_size; i += slot_size) {
+            slot_t *slot = reinterpret_cast<slot_t *>(slab + i);
+            slot->next = pool->free_slots;
+            pool->free_slots = slot;
+            pool->n_free++;
+        }
+
+        return true;
+    }
+
+public:
+
+    // Alias: Value types
+    using value_type         = T;
+
+	// Alias: Pointer as pointer to value type
+	using pointer            = T *;
+
+	// Alias: Pointer to const
+	using const_pointer      = T const *;
+
+	// Alias: Most general pointer
+	using void_pointer       = void *;
+
+	// Alias: Most general pointer (to const)
+	using const_void_pointer = const void *;
+
+	// Alias: Reference
+	using reference          = T&;
+
+	// Alias: Constant reference
+	using const_reference    = const T&;
+
+	// Alias: Allocation and deallocation size
+	using size_type          = size_t;
+
+
+    // Rebinding support: Let container construct arbitrary type allocator
+    template <class U>
+    struct rebind {
+    	using other          = Pool_Allocator<U>;
+    };
+
+    // Operator: Move assignment
+    template <class U>
+    Pool_Allocator &operator=(Pool_Allocator<U> &&origin)
+    {
+        // Ownership transfer
+        this->d_pool_info_p =
+            reinterpret_cast<pool_info_t *>(origin.pool_info_p());
+
+        return *this;
+    }
+
+    // Empty constuctor that does nothing
+    Pool_Allocator ():
+        d_pool_info_p(nullptr)
+    {
+        // Nothing to do
+    }
+
+    // Constructor
+    Pool_Allocator (void *static_memory_map, size_t capacity,
+        size_t slab_size = POOL_DEFAULT_SLAB_SIZE)
+    {
+        size_t const unit_size = alignof(max_align_t);
+
+        // Metadata rounded up so that the backing map remains aligned
+        size_t info_size = (sizeof(pool_info_t) + unit_size - 1)
+            / unit_size * unit_size;
+
+        // Capacity check (backing allocator checks the remainder)
+        if (capacity < info_size) {
+            throw std::bad_alloc();
+        }
+
+        // Parameter check: A slab must hold at least the largest slot
+        if (slab_size < POOL_MAX_SLOT_SIZE) {
+            throw std::invalid_argument("Slab smaller than largest slot");
+        }
+
+        // Struct initialization
+        d_pool_info_p = reinterpret_cast<pool_info_t *>(static_memory_map);
+        new (&(d_pool_info_p->backing)) Static_Allocator<uint8_t>{
+            reinterpret_cast<uint8_t *>(static_memory_map) + info_size,
+            capacity - info_size};
+        d_pool_info_p->slab_size = slab_size;
+
+        for (size_t i = 0; i < POOL_CLASS_COUNT; ++i) {
+            d_pool_info_p->pools[i].free_slots = nullptr;
+            d_pool_info_p->pools[i].n_free = 0;
+        }
+    }
+
+    // Copy constructor
+    Pool_Allocator (const Pool_Allocator &origin)
+    {
+        // Simply copy the static memory pointer (not protected from race conditions)
+        d_pool_info_p = origin.pool_info_p();
+    }
+
+    // Destructor
+    ~Pool_Allocator ()
+    {
+        // No destructor needed: state is not saved in the class instance
+    }
+
+    // Support for allocating other types
+    template <class U>
+    Pool_Allocator (const Pool_Allocator<U> &other):
+        d_pool_info_p(reinterpret_cast<pool_info_t *>(other.pool_info_p()))
+    {
+        // Nothing to do
+    }
+
+    // Allocate #1: General allocation
+    pointer allocate (size_type n_obj)
+    {
+    	size_t n_bytes = (n_obj * sizeof(T));
+    	return reinterpret_cast<pointer>(this->allocate_b(n_bytes));
+    }
+
+    // Allocate #2: Placement support
+    pointer allocate (size_type n_obj, const_void_pointer hint)
+    {
+    	return allocate(n_obj);
+    }
+
+    // Allocate #3: Typeless allocation of n bytes
+    void_pointer allocate_b (size_t n_bytes)
+    {
+        // Check: Validity of fields
+        if (d_pool_info_p == nullptr) {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Check: Requested byte count
+    	if (n_bytes == 0) {
+            throw std::invalid_argument("Cannot allocate zero bytes");
+    	}
+
+        // Case: Large request
+        if (!is_pooled(n_bytes)) {
+            return d_pool_info_p->backing.allocate_b(n_bytes);
+        }
+
+        // Case: Pool empty and cannot be refilled
+        size_t class_index = class_of(n_bytes);
+        pool_t *pool = &(d_pool_info_p->pools[class_index]);
+        if (pool->free_slots == nullptr && !refill(class_index)) {
+            return NULL;
+        }
+
+        // Pop a slot
+        slot_t *slot = pool->free_slots;
+        pool->free_slots = slot->next;
+        pool->n_free--;
+
+        return reinterpret_cast<void *>(slot);
+    }
+
+    // Convert a reference to a pointer
+    pointer address (reference r) const
+    {
+    	return static_cast<pointer>(std::addressof(r));
+    }
+
+    // Converts a reference to a const pointer
+    const_pointer address (const_reference r) const
+    {
+    	return static_cast<const_pointer>(std::addressof(r));
+    }
+
+    // Deallocate
+    void deallocate (pointer ptr, size_type n_obj)
+    {
+        size_t n_bytes = (n_obj * sizeof(T));
+
+        // Check: Validity of state
+        if (d_pool_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Parameter check: Is pointer valid
+    	if (ptr == nullptr) {
+            throw std::invalid_argument("Cannot free nullptr!");
+    	}
+
+        // Case: Large request
+        if (!is_pooled(n_bytes)) {
+            return d_pool_info_p->backing.deallocate(
+                reinterpret_cast<uint8_t *>(ptr), n_bytes);
+        }
+
+        // Push the slot
+        pool_t *pool = &(d_pool_info_p->pools[class_of(n_bytes)]);
+        slot_t *slot = reinterpret_cast<slot_t *>(ptr);
+        slot->next = pool->free_slots;
+        pool->free_slots = slot;
+        pool->n_free++;
+    }
+
+    // Number of available bytes (backing memory plus free slots)
+    size_t free_size () const
+    {
+    	if (d_pool_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        size_t n_bytes = d_pool_info_p->backing.free_size();
+        for (size_t i = 0; i < POOL_CLASS_COUNT; ++i) {
+            n_bytes += d_pool_info_p->pools[i].n_free * (i + 1) * POOL_SLOT_GRANULARITY;
+        }
+
+        return n_bytes;
+    }
+
+    // Whether the backing memory is unified (slabs are never returned)
+    bool unified () const
+    {
+        if (d_pool_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        return d_pool_info_p->backing.unified();
+    }
+
+    // Returns the allocator information
+    pool_info_t *pool_info_p () const
+    {
+        return d_pool_info_p;
+    }
+};
+
+#endif
@@ -17,73 +17,1258 @@
  *  w this is an abuse of templates, and will try to figure out a better way t *
  *  o do it. This neeeds to be compiled with -lpthread and -lrt. Also, I recom *
  *  mend forking after the initialization of the allocator in order to ensure  *
- *  the mapped memory is positioned homogenously across all processes. Otherwi *
- *  se this could cause errors. It is a known portability problem              *
+ *  the reference count is shared.                                             *
+ *                                                                             *
+ *  All metadata within the map is stored as offsets, the allocator handle hol *
+ *  ds a self-relative pointer to it, and by default containers receive self-r *
+ *  elative Offset_Ptr pointers. The map may therefore be attached at a differ *
+ *  ent address in every process. Containers that only accept raw pointers (s *
+ *  uch as node-based containers in libstdc++) can use Shared_Allocator<T, Raw *
+ *  _Ptr>, which must then be mapped at the same address in every process.     *
+ *                                                                             *
+ *  Unrelated or restarted processes join a live map by name with the attach c *
+ *  onstructor, which validates the magic and version in shared_map_info_t ins *
+ *  tead of reinitializing the map, and registers the process in it.           *
+ *                                                                             *
+ *  The locks are robust, process-shared mutexes: when a process dies holding  *
+ *  one, the next process to take it rebuilds the allocator metadata from the  *
+ *  block headers (see Static_Allocator::recover()) and carries on. Processes  *
+ *  holding handles are counted in a registry in the map, which is destroyed w *
+ *  ith the last live one, so a crashed process no longer keeps it alive. A pr *
+ *  ocess maps the map once: attaching again shares its mapping, which it unma *
+ *  ps with its last handle. A forked child holds the handles it inherited, an *
+ *  d fork() itself registers it (through pthread_atfork), so the map outlives *
+ *  the parent while the child is alive. Blocks allocated after set_owned_allo *
+ *  cations(true) are owned by their process, and freed when it is found dead  *
+ *  (on attach, on the last handle of a process, or by reap()); disown() hands *
+ *  one over to the map. Names reserved by a dead process are reused.          *
+ *                                                                             *
+ *  Large maps may be backed by transparent huge pages, bound or interleaved a *
+ *  cross NUMA nodes, and prefaulted, see shared_map_options_t. MAP_HUGETLB is *
+ *  not available for shm_open objects (they live on tmpfs, not hugetlbfs), so *
+ *  huge pages are requested with MADV_HUGEPAGE instead.                       *
+ *                                                                             *
+ *  A map created with shared_map_options_t::max_size grows on exhaustion: the *
+ *  object is extended with ftruncate by a segment (recorded in shared_map_inf *
+ *  o_t), the creator's backing options (kept there too) are applied to it, an *
+ *  d the backing allocator extends its last block over it. Every process maps *
+ *  max_size up front, so new segments appear in all of them without a remap.  *
+ *  release_segments() truncates fully free trailing segments again.           *
+ *                                                                             *
+ *  Requests of up to SHARED_MAX_SLOT_SIZE bytes are served from lock-free siz *
+ *  e-class free lists of fixed slots. Each list head packs a slot offset (rel *
+ *  ative to the start of the map) with an ABA tag in one 64-bit atomic, so fo *
+ *  rked workers allocate and free concurrently without any system call. Only  *
+ *  refilling a list with a new slab, and larger requests, take the process-sh *
+ *  ared lock. Slabs are not returned to the backing allocator, and are carved *
+ *  from its lowest free block so that they do not pin the segments added by g *
+ *  rowth. Slot offsets are 32-bit counts of SHARED_SLOT_GRANULARITY bytes, wh *
+ *  ich limits maps (with their max_size) to SHARED_MAX_MAP_SIZE, 64 GiB.      *
+ *                                                                             *
+ *  With shared_map_options_t::n_heaps, part of the map is divided into sub-he *
+ *  aps, each a Static_Allocator with its own lock and metadata on its own cac *
+ *  he lines. Large requests and slab refills are then served from the home he *
+ *  ap of the caller (that of the CPU it runs on, or the one given to set_home *
+ *  _heap()), falling back to the backing allocator when it is full. A block f *
+ *  reed by a process with another home heap is pushed on a lock-free return s *
+ *  tack of its heap, and freed on the next allocation from it, so the metadat *
+ *  a of a heap stays in the caches of its own processes.                      *
+ *                                                                             *
+ *  Objects may be constructed under a name (see construct()), so that any pro *
+ *  cess attached to the map finds them with find(). The directory is a fixed- *
+ *  size open-addressing hash table allocated in the map on first use and root *
+ *  ed in shared_map_info_t. Names are never rewritten once entered, so lookup *
+ *  s take no lock. Objects still named when the map is destroyed are not dest *
+ *  royed.                                                                     *
  *                                                                             *
  *******************************************************************************
 */
 
-// C++ libraries
-#include <iostream>
-#include <vector>
+// C++ libraries
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <typeinfo>
+#include <mutex>
+
+// C libraries
+extern "C" {
+	#include <stdlib.h>
+	#include <stdint.h>
+	#include <string.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <stdio.h>
+	#include <signal.h>
+	#include <pthread.h>
+	#include <sched.h>
+	#include <linux/mempolicy.h>
+}
+
+// Custom headers
+#include "static_allocator.cpp"
+#include "offset_ptr.cpp"
+
+
+// Max length of the shared allocator
+#define MAX_SHM_MAP_NAME_SIZE        32
+
+// Granularity of the lock-free slot size classes
+#define SHARED_SLOT_GRANULARITY      alignof(max_align_t)
+
+// Largest map, header and growth included (slot links are 32-bit granule counts)
+#define SHARED_MAX_MAP_SIZE          (static_cast<size_t>(UINT32_MAX) * SHARED_SLOT_GRANULARITY)
+
+// Largest request served from the lock-free slot lists (bytes)
+#define SHARED_MAX_SLOT_SIZE         256
+
+// Slab size carved from the backing allocator on refill (bytes)
+#define SHARED_SLAB_SIZE             1024
+
+// Alignment of the allocator map within the shared map (a cache line)
+#define SHARED_MAP_ALIGNMENT         64
+
+// Magic number identifying an initialized shared map ("SHMA")
+#define SHARED_MAP_MAGIC             0x53484d41
+
+// Layout version of shared_map_info_t (bump on any layout change)
+#define SHARED_MAP_VERSION           11
+
+// Build options changing the layout of the map (see ALLOCATOR_FEATURES)
+#define SHARED_MAP_FEATURES          ALLOCATOR_FEATURES
+
+// Max number of segments a growing map consists of
+#define SHARED_MAX_SEGMENTS          32
+
+// Entries of the named object directory (a power of two)
+#define SHARED_DIRECTORY_SIZE        64
+
+// Max length of the name of an object in the directory
+#define MAX_SHARED_OBJECT_NAME_SIZE  31
+
+// Max number of sub-heaps a map is divided into
+#define SHARED_MAX_HEAPS             64
+
+// Max number of processes holding handles on a map at once
+#define SHARED_MAX_PROCESSES         128
+
+
+// Structure: Optional backing properties of a shared map
+typedef struct shared_map_options_t {
+	bool huge_pages;              // Back with transparent huge pages (MADV_HUGEPAGE)
+	bool populate;                // Prefault the whole map up front (MAP_POPULATE)
+	int numa_policy;              // MPOL_DEFAULT, MPOL_BIND, MPOL_INTERLEAVE, ...
+	unsigned long numa_nodemask;  // Nodes used by numa_policy (bit n = node n)
+	size_t max_size;              // Size the map may grow to on exhaustion (0 = fixed)
+	bool annotate;                // Annotate blocks for ASan/Memcheck (see allocator_annotate.cpp)
+	uint32_t n_heaps;             // Sub-heaps serving large requests (0 = none)
+	size_t heap_size;             // Size of each sub-heap (0 = half the map, shared out)
+} shared_map_options_t;
+
+// Structure: Snapshot of shared map statistics
+typedef struct shared_map_stats_t {
+	allocator_stats_t backing;    // Backing allocator (slabs count as allocations)
+	size_t n_slot_allocations;    // Allocations served from the slot lists
+	size_t n_slot_deallocations;  // Deallocations returned to the slot lists
+	size_t n_slot_failed;         // Slotted allocations that returned NULL
+	size_t n_remote_deallocations; // Blocks freed to the return stack of another heap
+} shared_map_stats_t;
+
+
+// Home heap of the calling thread, -1 for that of the current CPU (one per
+// program, and inherited across fork, see Shared_Allocator::set_home_heap())
+inline int &shared_home_heap ()
+{
+	static thread_local int home_heap = -1;
+	return home_heap;
+}
+
+// Whether blocks allocated by the calling thread are owned by its process
+// (see Shared_Allocator::set_owned_allocations())
+inline bool &shared_owned_allocations ()
+{
+	static thread_local bool owned = false;
+	return owned;
+}
+
+
+// Structure: Map this process holds handles on. The handlers reach the map
+// through the type that mapped it (its layout does not depend on the type)
+typedef struct shared_process_map_t {
+	void *map;                    // Mapping of the map in this process
+	uint32_t n_handles;           // Handles this process holds on it
+	void (*reserve)(void *map, pid_t forker); // Reserve a registry entry for a child
+	void (*claim)(void *map, pid_t forker, uint32_t n_handles); // Claim it in the child
+} shared_process_map_t;
+
+// Structure: Maps of this process (see shared_process_maps())
+typedef struct shared_process_maps_t {
+	std::mutex lock;              // Held across fork(), so the child sees its handles
+	std::vector<shared_process_map_t> maps;
+	pid_t forker;                 // Process that last forked (in the child, its parent)
+} shared_process_maps_t;
+
+// Fork handler (before fork): Reserve an entry for the child in every map
+inline void shared_fork_prepare ();
+
+// Fork handler (in the parent)
+inline void shared_fork_parent ();
+
+// Fork handler (in the child): Register in every map inherited
+inline void shared_fork_child ();
+
+// Maps this process holds handles on. A forked child inherits the handles
+// its parent held, so fork() registers it in their maps (never destroyed,
+// as handles may outlive static objects)
+inline shared_process_maps_t &shared_process_maps ()
+{
+	static shared_process_maps_t *maps = [] {
+		int err;
+		if ((err = pthread_atfork(shared_fork_prepare, shared_fork_parent,
+			shared_fork_child)) != 0)
+		{
+			throw std::system_error(err, std::generic_category(), "pthread_atfork");
+		}
+		return new shared_process_maps_t();
+	}();
+	return *maps;
+}
+
+inline void shared_fork_prepare ()
+{
+	shared_process_maps_t &process = shared_process_maps();
+
+	process.lock.lock();
+	process.forker = getpid();
+	for (shared_process_map_t const &m : process.maps) {
+		m.reserve(m.map, process.forker);
+	}
+}
+
+inline void shared_fork_parent ()
+{
+	shared_process_maps().lock.unlock();
+}
+
+inline void shared_fork_child ()
+{
+	shared_process_maps_t &process = shared_process_maps();
+
+	for (shared_process_map_t const &m : process.maps) {
+		m.claim(m.map, process.forker, m.n_handles);
+	}
+	process.lock.unlock();
+}
+
+
+template <class T, template <class> class Pointer = Offset_Ptr>
+class Shared_Allocator
+{
+private:
+
+	// Number of lock-free slot size classes
+	static constexpr size_t SHARED_CLASS_COUNT =
+		SHARED_MAX_SLOT_SIZE / SHARED_SLOT_GRANULARITY;
+
+	// Structure: Free slot (link installed in the slot itself)
+	typedef struct slot_t {
+		std::atomic<uint32_t> next;  // Offset of next free slot (0 = none)
+	} slot_t;
+
+	// Structure: Named object directory entry
+	typedef struct directory_entry_t {
+		std::atomic<uint32_t> state; // DIRECTORY_EMPTY, _RESERVED, _READY or _REMOVED
+		uint32_t hash;               // Hash of name
+		uint64_t type_hash;          // Hash of the type name of the object
+		size_t offset;               // Offset of the object from the start of the map
+		pid_t reserver;              // Process constructing the object (while _RESERVED)
+		char name[MAX_SHARED_OBJECT_NAME_SIZE + 1];
+	} directory_entry_t;
+
+	// Structure: Sub-heap, at the start of its part of the map. The lock and
+	// the return stack sit on separate cache lines, as remote processes only
+	// touch the latter
+	typedef struct heap_t {
+		alignas(SHARED_MAP_ALIGNMENT) pthread_mutex_t lock; // Access-control mutex of the heap (robust)
+		alignas(SHARED_MAP_ALIGNMENT) std::atomic<size_t> returned; // First block freed remotely (0 = none)
+		std::atomic<size_t> n_returned;           // Blocks freed remotely
+	} heap_t;
+
+	// Structure: Block freed by a process other than its heap's, in the block
+	typedef struct returned_t {
+		size_t next;                 // Offset of the next returned block (0 = none)
+		size_t n_bytes;              // Size it was requested with
+	} returned_t;
+
+	// Structure: Registry entry of a process holding handles on the map
+	typedef struct process_t {
+		pid_t pid;                   // Process (0 = free entry, -pid = held for a child of pid)
+		uint32_t n_handles;          // Handles it constructed and still holds
+		uintptr_t mapping;           // Its own mapping of the map (0 = none, valid there only)
+	} process_t;
+
+	// Offset of the allocator map of a sub-heap from the start of its part
+	static constexpr size_t SHARED_HEAP_OFFSET = sizeof(heap_t);
+
+	// States of a directory entry (a removed entry keeps its name for reuse)
+	static constexpr uint32_t DIRECTORY_EMPTY = 0;
+	static constexpr uint32_t DIRECTORY_RESERVED = 1;   // Object being constructed
+	static constexpr uint32_t DIRECTORY_READY = 2;
+	static constexpr uint32_t DIRECTORY_REMOVED = 3;
+
+	// Structure: Metadata for shared memory management
+	typedef struct {
+		std::atomic<uint32_t> magic; // SHARED_MAP_MAGIC once fully initialized
+		uint32_t version;        // SHARED_MAP_VERSION
+		uint32_t features;       // SHARED_MAP_FEATURES of the creator
+		pthread_mutex_t lock;    // Access-control mutex (robust)
+		size_t shm_map_offset;   // Offset of allocator map from this structure
+		size_t shm_map_size;     // Size of the shared map
+		size_t shm_map_reserved; // Bytes mapped by every process (header included)
+		uint32_t n_segments;     // Segments the map consists of
+		size_t segment_ends[SHARED_MAX_SEGMENTS]; // Map size up to the end of each segment
+		shared_map_options_t options; // Backing options of the creator (for new segments)
+		char shm_map_name[MAX_SHM_MAP_NAME_SIZE + 1];   // Name of the shared map
+		std::atomic<uint64_t> free_slots[SHARED_CLASS_COUNT]; // Tag << 32 | offset
+		std::atomic<size_t> n_slot_allocations;   // Slot list counters
+		std::atomic<size_t> n_slot_deallocations;
+		std::atomic<size_t> n_slot_failed;
+		std::atomic<size_t> directory; // Offset of the named object directory (0 = none)
+		uint32_t n_heaps;        // Sub-heaps (0 = none)
+		size_t heap_size;        // Size of each sub-heap
+		size_t heaps;            // Offset of the first sub-heap (the others follow)
+		std::atomic<bool> owned_blocks; // Whether a block was ever given an owner
+		process_t processes[SHARED_MAX_PROCESSES]; // Processes holding handles
+	} shared_map_info_t;
+
+	// Offset of the allocator map (header rounded up, so blocks may be aligned
+	// up to a cache line and the header shares no line with them)
+	static constexpr size_t SHARED_MAP_OFFSET = (sizeof(shared_map_info_t) +
+		SHARED_MAP_ALIGNMENT - 1) / SHARED_MAP_ALIGNMENT * SHARED_MAP_ALIGNMENT;
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free,
+		"Lock-free slot lists need address-free 64-bit atomics");
+
+
+	// Pointer: Metadata (self-relative, so the handle may live in the map)
+	Offset_Ptr<shared_map_info_t> d_shared_map_info_p;
+
+	// Friend: Handles of all value types exchange maps
+	template <class U, template <class> class P>
+	friend class Shared_Allocator;
+
+
+	// Inline method: Swap maps (and so the references held) with another handle
+	template <class U>
+	inline void exchange_map (Shared_Allocator<U, Pointer> &other)
+	{
+		using other_info_t = typename Shared_Allocator<U, Pointer>::shared_map_info_t;
+		shared_map_info_t *held = d_shared_map_info_p.get();
+
+		d_shared_map_info_p = reinterpret_cast<shared_map_info_t *>(
+			other.d_shared_map_info_p.get());
+		other.d_shared_map_info_p = reinterpret_cast<other_info_t *>(held);
+	}
+
+
+	// Unmap n_bytes at ptr
+	static void unmap (void *ptr, size_t n_bytes)
+	{
+		if (munmap(ptr, n_bytes) == -1) {
+			throw std::system_error(errno, std::generic_category(), "munmap");
+		}
+	}
+
+	// Check the header of a mapped object of shm_obj_size bytes. Returns
+	// why it cannot be attached, nullptr if it can
+	static char const *header_error (shared_map_info_t const *info, size_t shm_obj_size)
+	{
+		if (info->magic.load(std::memory_order_acquire) != SHARED_MAP_MAGIC ||
+			info->version != SHARED_MAP_VERSION ||
+			info->shm_map_offset != SHARED_MAP_OFFSET ||
+			info->shm_map_size + SHARED_MAP_OFFSET > shm_obj_size ||
+			info->shm_map_reserved > SHARED_MAX_MAP_SIZE ||
+			info->shm_map_reserved < shm_obj_size)
+		{
+			return "Shared map has invalid header";
+		}
+		if (info->features != SHARED_MAP_FEATURES) {
+			return "Shared map was built with other allocator options";
+		}
+		return nullptr;
+	}
+
+	// Initialise a robust, process-shared mutex in the map
+	static void init_lock (pthread_mutex_t *lock)
+	{
+		pthread_mutexattr_t attr;
+		int err;
+
+		if ((err = pthread_mutexattr_init(&attr)) != 0) {
+			throw std::system_error(err, std::generic_category(), "pthread_mutexattr_init");
+		}
+		if ((err = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED)) != 0 ||
+			(err = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST)) != 0 ||
+			(err = pthread_mutex_init(lock, &attr)) != 0)
+		{
+			pthread_mutexattr_destroy(&attr);
+			throw std::system_error(err, std::generic_category(), "pthread_mutex_init");
+		}
+		pthread_mutexattr_destroy(&attr);
+	}
+
+	// Take a robust mutex. If its holder died, repair() restores what the
+	// mutex protects before the mutex is marked consistent again
+	template <class Repair>
+	static void lock_robust (pthread_mutex_t *lock, Repair repair)
+	{
+		int err = pthread_mutex_lock(lock);
+
+		// Case: Holder died, possibly half-way through an update
+		if (err == EOWNERDEAD) {
+			try {
+				repair();
+			} catch (...) {
+				pthread_mutex_unlock(lock);
+				throw;
+			}
+			err = pthread_mutex_consistent(lock);
+		}
+		if (err != 0) {
+			throw std::system_error(err, std::generic_category(), "pthread_mutex_lock");
+		}
+	}
+
+	// Release a robust mutex
+	static void unlock_robust (pthread_mutex_t *lock)
+	{
+		int err;
+
+		if ((err = pthread_mutex_unlock(lock)) != 0) {
+			throw std::system_error(err, std::generic_category(), "pthread_mutex_unlock");
+		}
+	}
+
+	// Inline method: Get exclusive access to shared memory
+	inline void take_lock ()
+	{
+		lock_robust(&(d_shared_map_info_p->lock), [this] { recover_map(); });
+	}
+
+	// Inline method: Drop exclusive access to shared memory
+	inline void drop_lock ()
+	{
+		unlock_robust(&(d_shared_map_info_p->lock));
+	}
+
+	// Inline method: Get exclusive access to a sub-heap
+	static inline void take_lock (heap_t *heap)
+	{
+		lock_robust(&(heap->lock), [heap] { heap_allocator(heap).recover(); });
+	}
+
+	// Inline method: Drop exclusive access to a sub-heap
+	static inline void drop_lock (heap_t *heap)
+	{
+		unlock_robust(&(heap->lock));
+	}
+
+	// Repair the map after the holder of its lock died (lock held): blocks
+	// are rebuilt from their headers, and the segments are brought in line
+	// with the size of the backing allocator
+	void recover_map ()
+	{
+		shared_map_info_t *info = d_shared_map_info_p.get();
+		Static_Allocator<T> allocator = static_allocator();
+		size_t capacity = allocator.allocator_info_p()->capacity;
+
+		allocator.recover();
+
+		// Case: Died growing the map, once the allocator was extended
+		if (capacity > info->segment_ends[info->n_segments - 1]) {
+			info->segment_ends[info->n_segments++] = capacity;
+		}
+
+		// Case: Died releasing segments, once the allocator was truncated
+		while (info->n_segments > 1 && info->segment_ends[info->n_segments - 1] > capacity) {
+			info->n_segments--;
+		}
+		info->shm_map_size = capacity;
+	}
+
+	// Whether process pid is alive (a zombie is not). A recycled pid passes
+	// for the process that had it, so this errs on the side of alive
+	static bool process_alive (pid_t pid)
+	{
+		char path[32], stat[256];
+		int fd;
+		ssize_t n;
+
+		if (kill(pid, 0) == -1 && errno == ESRCH) {
+			return false;
+		}
+
+		// Zombies still take signals: check the state in /proc (if mounted)
+		snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+		if ((fd = open(path, O_RDONLY)) == -1) {
+			return true;
+		}
+		n = read(fd, stat, sizeof(stat) - 1);
+		close(fd);
+		if (n <= 0) {
+			return true;
+		}
+		stat[n] = '\0';
+
+		// State follows the command name, which may itself hold parentheses
+		char const *end = strrchr(stat, ')');
+		return end == nullptr || end[1] == '\0' || (end[2] != 'Z' && end[2] != 'X');
+	}
+
+	// Count a handle of the calling process in the registry (lock held).
+	// Returns the entry of the process
+	process_t *add_handle ()
+	{
+		pid_t pid = getpid();
+		process_t *entry = nullptr;
+
+		for (process_t &process : d_shared_map_info_p->processes) {
+			if (process.pid == pid) {
+				process.n_handles++;
+				return &process;
+			}
+			if (process.pid == 0 && entry == nullptr) {
+				entry = &process;
+			}
+		}
+
+		// Case: Registry full, make room by reaping dead processes
+		if (entry == nullptr && reap_dead() != 0) {
+			for (process_t &process : d_shared_map_info_p->processes) {
+				if (process.pid == 0) {
+					entry = &process;
+					break;
+				}
+			}
+		}
+		if (entry == nullptr) {
+			throw std::runtime_error("Too many processes attached to shared map");
+		}
+
+		entry->pid = pid;
+		entry->n_handles = 1;
+		entry->mapping = 0;
+		return entry;
+	}
+
+	// Drop a handle of the calling process from the registry (lock held),
+	// reaping dead processes when it was its last. Returns the number of
+	// processes still holding handles (children being forked included), and
+	// the mapping of the calling process in *mapping if the handle was its
+	// last (else 0)
+	size_t drop_handle (uintptr_t *mapping)
+	{
+		pid_t pid = getpid();
+		size_t n_processes = 0;
+
+		*mapping = 0;
+		for (process_t &process : d_shared_map_info_p->processes) {
+			if (process.pid == pid && --(process.n_handles) == 0) {
+				*mapping = process.mapping;
+				process.pid = 0;
+				process.mapping = 0;
+				reap_dead();
+			}
+		}
+		for (process_t const &process : d_shared_map_info_p->processes) {
+			n_processes += (process.pid != 0);
+		}
+		return n_processes;
+	}
+
+	// Release what dead processes left behind (lock held): their registry
+	// entries (and those held for children they never forked), and the
+	// blocks they owned. Returns the number of entries freed
+	size_t reap_dead ()
+	{
+		shared_map_info_t *info = d_shared_map_info_p.get();
+		size_t n_dead = 0;
+
+		for (process_t &process : info->processes) {
+			if (process.pid != 0 && !process_alive(std::abs(process.pid))) {
+				process.pid = 0;
+				process.n_handles = 0;
+				process.mapping = 0;
+				n_dead++;
+			}
+		}
+
+		// Case: Blocks may have owners, free those of dead ones (owners are
+		// mostly alike, so the last answer is kept)
+		if (info->owned_blocks.load(std::memory_order_relaxed)) {
+			pid_t last_pid = 0;
+			bool last_gone = false;
+			auto gone = [&] (size_t owner) {
+				if (static_cast<pid_t>(owner) != last_pid) {
+					last_pid = static_cast<pid_t>(owner);
+					last_gone = !process_alive(last_pid);
+				}
+				return last_gone;
+			};
+
+			static_allocator().reclaim(gone);
+			for (size_t i = 0; i < info->n_heaps; ++i) {
+				heap_t *heap = heap_at(i);
+
+				take_lock(heap);
+				try {
+					drain(heap);
+					heap_allocator(heap).reclaim(gone);
+				} catch (...) {
+					drop_lock(heap);
+					throw;
+				}
+				drop_lock(heap);
+			}
+		}
+
+		return n_dead;
+	}
+
+	// Constructor: View of a map for the fork handlers, which holds no handle
+	// (cleared before it is destroyed)
+	explicit Shared_Allocator (shared_map_info_t *info):
+		d_shared_map_info_p(info)
+	{
+		// Nothing to do
+	}
+
+	// Fork handler (see shared_process_maps()): Before the calling process
+	// forks, hold a registry entry for the child, so the map lives on even
+	// if the parent drops its handles before the child runs. Handlers must
+	// not throw: a map whose lock fails is left to the child (see below)
+	static void fork_reserve (void *map, pid_t forker)
+	{
+		Shared_Allocator view(static_cast<shared_map_info_t *>(map));
+
+		if (view.try_take_lock()) {
+			for (process_t &process : view.d_shared_map_info_p->processes) {
+				if (process.pid == 0) {
+					process.pid = -forker;
+					process.n_handles = 0;
+					process.mapping = 0;
+					break;
+				}
+			}
+			pthread_mutex_unlock(&(view.d_shared_map_info_p->lock));
+		}
+		view.d_shared_map_info_p = nullptr;
+	}
+
+	// Fork handler: In the child, take over the entry its parent held for
+	// it (or a new one, if there was none) with the n_handles handles it
+	// inherited, and the mapping they use. If the registry is full, the
+	// inherited handles stay unregistered
+	static void fork_claim (void *map, pid_t forker, uint32_t n_handles)
+	{
+		Shared_Allocator view(static_cast<shared_map_info_t *>(map));
+
+		if (view.try_take_lock()) {
+			process_t *entry = nullptr;
+			for (process_t &process : view.d_shared_map_info_p->processes) {
+				if (process.pid == -forker) {
+					entry = &process;
+					break;
+				}
+			}
+			try {
+				if (entry == nullptr && view.d_shared_map_info_p->magic.load(
+					std::memory_order_relaxed) == SHARED_MAP_MAGIC)
+				{
+					entry = view.add_handle();
+				}
+			} catch (...) {
+				entry = nullptr;
+			}
+			if (entry != nullptr) {
+				entry->pid = getpid();
+				entry->n_handles = n_handles;
+				entry->mapping = reinterpret_cast<uintptr_t>(map);
+			}
+			pthread_mutex_unlock(&(view.d_shared_map_info_p->lock));
+		}
+		view.d_shared_map_info_p = nullptr;
+	}
+
+	// Inline method: Take the lock of the map, returning false instead of
+	// throwing if it cannot be taken (for the fork handlers)
+	inline bool try_take_lock () noexcept
+	{
+		try {
+			take_lock();
+		} catch (...) {
+			return false;
+		}
+		return true;
+	}
+
+	// Count a handle of the calling process on map in the process's own
+	// list, after it was counted in the registry of the map
+	static void register_map (void *map)
+	{
+		shared_process_maps_t &process = shared_process_maps();
+		std::lock_guard<std::mutex> guard(process.lock);
+
+		for (shared_process_map_t &m : process.maps) {
+			if (m.map == map) {
+				m.n_handles++;
+				return;
+			}
+		}
+		process.maps.push_back(shared_process_map_t{map, 1, fork_reserve, fork_claim});
+	}
+
+	// Drop a handle of the calling process on map from the process's own
+	// list, before it is dropped from the registry of the map
+	static void unregister_map (void *map)
+	{
+		shared_process_maps_t &process = shared_process_maps();
+		std::lock_guard<std::mutex> guard(process.lock);
+
+		for (size_t i = 0; i < process.maps.size(); ++i) {
+			if (process.maps[i].map == map) {
+				if (--(process.maps[i].n_handles) == 0) {
+					process.maps.erase(process.maps.begin() + i);
+				}
+				return;
+			}
+		}
+	}
+
+	// Inline method: Record the calling process as owner of block ptr of
+	// allocator, if its thread allocates owned blocks (allocator lock held)
+	template <class U>
+	inline void own (Static_Allocator<U> allocator, void *ptr)
+	{
+		if (ptr != nullptr && shared_owned_allocations()) {
+			allocator.set_owner(ptr, static_cast<size_t>(getpid()));
+			d_shared_map_info_p->owned_blocks.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	// Inline method: Sub-heap at index
+	inline heap_t *heap_at (size_t index) const
+	{
+		return reinterpret_cast<heap_t *>(reinterpret_cast<uint8_t *>(
+			d_shared_map_info_p.get()) + d_shared_map_info_p->heaps +
+			index * d_shared_map_info_p->heap_size);
+	}
+
+	// Inline method: Sub-heap holding ptr (nullptr if it is not in one)
+	inline heap_t *heap_of (void const *ptr) const
+	{
+		shared_map_info_t *info = d_shared_map_info_p.get();
+		size_t offset = reinterpret_cast<uint8_t const *>(ptr) -
+			reinterpret_cast<uint8_t *>(info);
+
+		if (offset < info->heaps || offset >= info->heaps + info->n_heaps * info->heap_size) {
+			return nullptr;
+		}
+		return heap_at((offset - info->heaps) / info->heap_size);
+	}
+
+	// Inline method: Home heap of the caller (nullptr if the map has none)
+	inline heap_t *home_heap () const
+	{
+		uint32_t n_heaps = d_shared_map_info_p->n_heaps;
+		int home = shared_home_heap();
+
+		if (n_heaps == 0) {
+			return nullptr;
+		}
+		if (home < 0 && (home = sched_getcpu()) < 0) {
+			home = 0;
+		}
+		return heap_at(static_cast<size_t>(home) % n_heaps);
+	}
+
+	// Inline method: Allocator of a sub-heap
+	static inline Static_Allocator<uint8_t> heap_allocator (heap_t *heap)
+	{
+		return Static_Allocator<uint8_t>::attach(reinterpret_cast<uint8_t *>(heap) +
+			SHARED_HEAP_OFFSET);
+	}
+
+	// Free the blocks other processes returned to heap (its lock held)
+	void drain (heap_t *heap)
+	{
+		// Case: Nothing returned (checked first, sparing the line a write)
+		if (heap->returned.load(std::memory_order_relaxed) == 0) {
+			return;
+		}
+
+		Static_Allocator<uint8_t> allocator = heap_allocator(heap);
+		size_t offset = heap->returned.exchange(0, std::memory_order_acquire);
+		while (offset != 0) {
+			returned_t *r = reinterpret_cast<returned_t *>(reinterpret_cast<uint8_t *>(
+				d_shared_map_info_p.get()) + offset);
+			offset = r->next;
+			allocator.deallocate(reinterpret_cast<uint8_t *>(r), r->n_bytes);
+		}
+	}
+
+	// Run operation on the allocator of the home heap, with its lock held
+	// and its returned blocks freed first. Returns false if there are no heaps
+	template <class Operation>
+	bool in_home_heap (Operation operation)
+	{
+		heap_t *heap = home_heap();
+
+		if (heap == nullptr) {
+			return false;
+		}
+
+		take_lock(heap);
+		try {
+			drain(heap);
+			operation(heap_allocator(heap));
+		} catch (...) {
+			drop_lock(heap);
+			throw;
+		}
+		drop_lock(heap);
+		return true;
+	}
+
+	// Free a block of a sub-heap: directly if it is the caller's home heap,
+	// else by pushing it on the return stack of the heap (lock-free), so the
+	// metadata of the heap stays in the caches of its own processes
+	void heap_deallocate (heap_t *heap, void *ptr, size_t n_bytes)
+	{
+		// Case: Home heap
+		if (heap == home_heap()) {
+			take_lock(heap);
+			try {
+				heap_allocator(heap).deallocate(static_cast<uint8_t *>(ptr), n_bytes);
+			} catch (...) {
+				drop_lock(heap);
+				throw;
+			}
+			drop_lock(heap);
+			return;
+		}
+
+		returned_t *r = static_cast<returned_t *>(ptr);
+		size_t offset = static_cast<uint8_t *>(ptr) -
+			reinterpret_cast<uint8_t *>(d_shared_map_info_p.get());
+		size_t head = heap->returned.load(std::memory_order_relaxed);
+
+		r->n_bytes = n_bytes;
+		do {
+			r->next = head;
+		} while (!heap->returned.compare_exchange_weak(head, offset,
+			std::memory_order_release, std::memory_order_relaxed));
+		heap->n_returned.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Carve the sub-heaps out of the backing allocator (at creation)
+	void install_heaps (shared_map_options_t const &options)
+	{
+		shared_map_info_t *info = d_shared_map_info_p.get();
+		size_t heap_size = options.heap_size;
+		void *heaps;
+
+		// Default: Half of the map, shared out (in whole cache lines)
+		if (heap_size == 0) {
+			heap_size = info->shm_map_size / 2 / options.n_heaps;
+		}
+		heap_size = heap_size / SHARED_MAP_ALIGNMENT * SHARED_MAP_ALIGNMENT;
+
+		// Check: Every sub-heap holds a map, and all fit the map (aligned
+		// within one block, so no free block is split off in front of them)
+		if (heap_size < SHARED_HEAP_OFFSET + Static_Allocator<uint8_t>::MIN_CAPACITY ||
+			(heaps = static_allocator().allocate_b(options.n_heaps * heap_size +
+				SHARED_MAP_ALIGNMENT)) == nullptr)
+		{
+			throw std::invalid_argument("Shared map too small for its sub-heaps");
+		}
+
+		info->heaps = static_cast<uint8_t *>(heaps) - reinterpret_cast<uint8_t *>(info);
+		info->heaps = (info->heaps + SHARED_MAP_ALIGNMENT - 1) / SHARED_MAP_ALIGNMENT *
+			SHARED_MAP_ALIGNMENT;
+		info->heap_size = heap_size;
+		for (size_t i = 0; i < options.n_heaps; ++i) {
+			heap_t *heap = heap_at(i);
+
+			init_lock(&(heap->lock));
+			new (&(heap->returned)) std::atomic<size_t>(0);
+			new (&(heap->n_returned)) std::atomic<size_t>(0);
+			Static_Allocator<uint8_t>{reinterpret_cast<uint8_t *>(heap) + SHARED_HEAP_OFFSET,
+				heap_size - SHARED_HEAP_OFFSET}.set_annotations(options.annotate);
+		}
+		info->n_heaps = options.n_heaps;
+	}
+
+	// Inline method: Whether a request is served from the slot lists
+	static inline bool is_slotted (size_t n_bytes)
+	{
+		return n_bytes <= SHARED_MAX_SLOT_SIZE;
+	}
+
+	// Inline method: Size class of a slotted request
+	static inline size_t class_of (size_t n_bytes)
+	{
+		return (n_bytes + SHARED_SLOT_GRANULARITY - 1) / SHARED_SLOT_GRANULARITY - 1;
+	}
+
+	// Inline method: Slot at offset (in granules from the start of the map)
+	inline slot_t *slot_at (uint32_t offset) const
+	{
+		return reinterpret_cast<slot_t *>(reinterpret_cast<uint8_t *>(
+			d_shared_map_info_p.get()) + static_cast<size_t>(offset) * SHARED_SLOT_GRANULARITY);
+	}
+
+	// Inline method: Offset (in granules from the start of the map) of slot
+	inline uint32_t offset_of (void *slot) const
+	{
+		return static_cast<uint32_t>((reinterpret_cast<uint8_t *>(slot) -
+			reinterpret_cast<uint8_t *>(d_shared_map_info_p.get())) / SHARED_SLOT_GRANULARITY);
+	}
+
+	// Push the chain of slots [first, last] on a list
+	void push_slots (size_t class_index, uint32_t first, uint32_t last)
+	{
+		std::atomic<uint64_t> &head = d_shared_map_info_p->free_slots[class_index];
+		uint64_t old_head = head.load(std::memory_order_relaxed), new_head;
+
+		do {
+			slot_at(last)->next.store(static_cast<uint32_t>(old_head),
+				std::memory_order_relaxed);
+			new_head = ((old_head >> 32) + 1) << 32 | first;
+		} while (!head.compare_exchange_weak(old_head, new_head,
+			std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// Pop a slot from a list (nullptr if empty)
+	slot_t *pop_slot (size_t class_index)
+	{
+		std::atomic<uint64_t> &head = d_shared_map_info_p->free_slots[class_index];
+		uint64_t old_head = head.load(std::memory_order_acquire), new_head;
+
+		do {
+			uint32_t offset = static_cast<uint32_t>(old_head);
+			if (offset == 0) {
+				return nullptr;
+			}
+
+			// May read a stale link if the slot was taken meanwhile: the tag fails the CAS
+			uint32_t next = slot_at(offset)->next.load(std::memory_order_relaxed);
+			new_head = ((old_head >> 32) + 1) << 32 | next;
+		} while (!head.compare_exchange_weak(old_head, new_head,
+			std::memory_order_acquire, std::memory_order_acquire));
+
+		return slot_at(static_cast<uint32_t>(old_head));
+	}
+
+	// Carve a slab into slots: keep one for the caller and publish the rest
+	slot_t *refill (size_t class_index)
+	{
+		size_t slot_size = (class_index + 1) * SHARED_SLOT_GRANULARITY;
+		uint8_t *slab = nullptr;
+		size_t slab_size = SHARED_SLAB_SIZE;
+
+		// Take a whole slab from the home heap, if any
+		in_home_heap([&] (Static_Allocator<uint8_t> heap) {
+			slab = reinterpret_cast<uint8_t *>(heap.allocate_b(slab_size));
+		});
+
+		// Else grow the map for a whole slab, else shrink the slab until it
+		// fits (down to a single slot). Slabs are never freed, so they are
+		// taken low in the map, clear of the segments growth adds
+		if (slab == nullptr) {
+			take_lock();
+			try {
+				if ((slab = reinterpret_cast<uint8_t *>(
+					static_allocator().allocate_low(slab_size))) == nullptr &&
+					grow(slab_size)) {
+					slab = reinterpret_cast<uint8_t *>(
+						static_allocator().allocate_low(slab_size));
+				}
+				for (; slab == nullptr && slab_size / 2 >= slot_size; ) {
+					slab_size /= 2;
+					slab = reinterpret_cast<uint8_t *>(
+						static_allocator().allocate_low(slab_size));
+				}
+			} catch (...) {
+				drop_lock();
+				throw;
+			}
+			drop_lock();
+		}
+
+		if (slab == nullptr) {
+			return nullptr;
+		}
+
+		// Link slots [1, n) privately, then publish them with one CAS
+		size_t n_slots = slab_size / slot_size;
+		for (size_t i = 1; i + 1 < n_slots; ++i) {
+			reinterpret_cast<slot_t *>(slab + i * slot_size)->next.store(
+				offset_of(slab + (i + 1) * slot_size), std::memory_order_relaxed);
+		}
+		if (n_slots > 1) {
+			push_slots(class_index, offset_of(slab + slot_size),
+				offset_of(slab + (n_slots - 1) * slot_size));
+		}
+
+		return reinterpret_cast<slot_t *>(slab);
+	}
+
+	// Inline method: Raw pointer from a (possibly fancy) pointer
+	static inline T *raw (T *ptr)
+	{
+		return ptr;
+	}
+
+	// Inline method: Raw pointer from a (possibly fancy) pointer
+	static inline T *raw (Offset_Ptr<T> const &ptr)
+	{
+		return ptr.get();
+	}
+
+	// Inline method: FNV-1a hash of a string
+	static inline uint64_t hash_of (char const *str)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for (; *str != '\0'; ++str) {
+			hash = (hash ^ static_cast<uint8_t>(*str)) * 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	// Inline method: Identity of a type, stable across processes of one build
+	template <class U>
+	static inline uint64_t type_hash_of ()
+	{
+		return hash_of(typeid(U).name());
+	}
+
+	// Check a directory name, returning its hash
+	static uint32_t check_name (char const *name)
+	{
+		// Parameter check: Name fits an entry
+		if (name == nullptr || name[0] == '\0' ||
+			strnlen(name, MAX_SHARED_OBJECT_NAME_SIZE + 1) > MAX_SHARED_OBJECT_NAME_SIZE)
+		{
+			throw std::invalid_argument("Invalid or too long object name");
+		}
+		return static_cast<uint32_t>(hash_of(name));
+	}
+
+	// Entry holding name (in any state but empty), or nullptr. Lock-free: an
+	// entry's name is written before the entry is first published
+	directory_entry_t *lookup (char const *name, uint32_t hash) const
+	{
+		size_t offset = d_shared_map_info_p->directory.load(std::memory_order_acquire);
+		if (offset == 0) {
+			return nullptr;
+		}
+
+		directory_entry_t *table = reinterpret_cast<directory_entry_t *>(
+			reinterpret_cast<uint8_t *>(d_shared_map_info_p.get()) + offset);
+		for (size_t i = 0; i < SHARED_DIRECTORY_SIZE; ++i) {
+			directory_entry_t *e = table + ((hash + i) & (SHARED_DIRECTORY_SIZE - 1));
+			uint32_t state = e->state.load(std::memory_order_acquire);
+
+			// Case: End of the probe sequence
+			if (state == DIRECTORY_EMPTY) {
+				return nullptr;
+			}
+			if (e->hash == hash && strcmp(e->name, name) == 0) {
+				return e;
+			}
+		}
+		return nullptr;
+	}
+
+	// Reserve an entry for name (building the directory on first use).
+	// Returns nullptr if the name is already reserved or in use
+	template <class U>
+	directory_entry_t *reserve (char const *name, uint32_t hash)
+	{
+		directory_entry_t *e = nullptr;
+
+		take_lock();
+
+		// Case: First named object, build the directory (for good, so low)
+		size_t offset = d_shared_map_info_p->directory.load(std::memory_order_relaxed);
+		if (offset == 0) {
+			void *table = static_allocator().allocate_low(
+				SHARED_DIRECTORY_SIZE * sizeof(directory_entry_t));
+			if (table == nullptr) {
+				drop_lock();
+				throw std::bad_alloc();
+			}
+			for (size_t i = 0; i < SHARED_DIRECTORY_SIZE; ++i) {
+				new (&(reinterpret_cast<directory_entry_t *>(table)[i].state))
+					std::atomic<uint32_t>(DIRECTORY_EMPTY);
+			}
+			offset = reinterpret_cast<uint8_t *>(table) -
+				reinterpret_cast<uint8_t *>(d_shared_map_info_p.get());
+			d_shared_map_info_p->directory.store(offset, std::memory_order_release);
+		}
+
+		// Probe for the name, or the first empty entry
+		directory_entry_t *table = reinterpret_cast<directory_entry_t *>(
+			reinterpret_cast<uint8_t *>(d_shared_map_info_p.get()) + offset);
+		for (size_t i = 0; i < SHARED_DIRECTORY_SIZE; ++i) {
+			e = table + ((hash + i) & (SHARED_DIRECTORY_SIZE - 1));
+			uint32_t state = e->state.load(std::memory_order_relaxed);
+
+			// Case: New name
+			if (state == DIRECTORY_EMPTY) {
+				e->hash = hash;
+				strncpy(e->name, name, MAX_SHARED_OBJECT_NAME_SIZE + 1);
+				break;
+			}
 
-// C libraries
-extern "C" {
-	#include <stdlib.h>
-	#include <string.h>
-	#include <unistd.h>
-	#include <errno.h>
-	#include <fcntl.h>
-	#include <sys/stat.h>
-	#include <sys/mman.h>
-	#include <semaphore.h>
-}
+			// Case: Known name, reusable only once removed (or if the process
+			// constructing it died)
+			if (e->hash == hash && strcmp(e->name, name) == 0) {
+				if (state != DIRECTORY_REMOVED && !(state == DIRECTORY_RESERVED &&
+					!process_alive(e->reserver))) {
+					drop_lock();
+					return nullptr;
+				}
+				break;
+			}
+			e = nullptr;
+		}
 
-// Custom headers
-#include "static_allocator.cpp"
+		// Case: Directory full
+		if (e == nullptr) {
+			drop_lock();
+			throw std::bad_alloc();
+		}
 
+		e->type_hash = type_hash_of<U>();
+		e->reserver = getpid();
+		e->state.store(DIRECTORY_RESERVED, std::memory_order_release);
+		drop_lock();
+		return e;
+	}
 
-// Max length of the shared allocator
-#define MAX_SHM_MAP_NAME_SIZE        32
+	// Construct an object into a reserved entry and publish it
+	template <class U, class... Args>
+	U *construct_into (directory_entry_t *e, Args&&... args)
+	{
+		U *ptr;
 
+		try {
+			ptr = new_object<U>(std::forward<Args>(args)...);
+		} catch (...) {
+			e->state.store(DIRECTORY_REMOVED, std::memory_order_release);
+			throw;
+		}
 
-template <class T>
-class Shared_Allocator
-{
-private:
+		e->offset = reinterpret_cast<uint8_t *>(ptr) -
+			reinterpret_cast<uint8_t *>(d_shared_map_info_p.get());
+		e->state.store(DIRECTORY_READY, std::memory_order_release);
+		return ptr;
+	}
 
-	// Structure: Metadata for shared memory management
-	typedef struct {
-		sem_t sem;               // Access-control semaphore
-		unsigned int ref_count;  // Reference count semaphore
-		void *shm_map_ptr;       // Pointer to map in process space
-		size_t shm_map_size;     // Size of the shared map
-		char shm_map_name[MAX_SHM_MAP_NAME_SIZE + 1];   // Name of the shared map
-	} shared_map_info_t;
+	// Extend the map by a segment fitting n_bytes (lock held). Returns
+	// false if the map is fixed, or cannot grow any further
+	bool grow (size_t n_bytes)
+	{
+		shared_map_info_t *info = d_shared_map_info_p.get();
+		size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+		// Segment: The size of the first one, or enough for the request
+		size_t step = std::max(info->segment_ends[0], n_bytes + page_size);
+		step = (step + page_size - 1) / page_size * page_size;
+		size_t new_size = std::min(info->shm_map_size + step,
+			info->shm_map_reserved - info->shm_map_offset);
+
+		// Case: Fixed or exhausted
+		if (new_size <= info->shm_map_size || info->n_segments == SHARED_MAX_SEGMENTS) {
+			return false;
+		}
 
+		resize_object(new_size + info->shm_map_offset);
 
-	// Pointer: Metadata
-	shared_map_info_t *d_shared_map_info_p;
+		// Apply the backing options to the segment before it is first touched
+		uintptr_t map = reinterpret_cast<uintptr_t>(info) + info->shm_map_offset;
+		uintptr_t start = (map + info->shm_map_size) & ~(page_size - 1);
+		apply_map_options(reinterpret_cast<void *>(start), map + new_size - start,
+			info->options, false);
 
-	// Object: Static data allocator that actually manages the memory
-	Static_Allocator<T> d_static_allocator;
+		if (!static_allocator().extend(new_size)) {
+			return false;
+		}
 
+		info->segment_ends[info->n_segments++] = new_size;
+		info->shm_map_size = new_size;
+		return true;
+	}
 
-	// Inline method: Get exclusive access to shared memory
-	inline void take_sem ()
+	// Set the size of the shared memory object (lock held)
+	void resize_object (size_t shm_obj_size)
 	{
-		if (sem_wait(&(d_shared_map_info_p->sem)) == -1)
+		int shm_obj_fd;
+
+		if ((shm_obj_fd = shm_open(d_shared_map_info_p->shm_map_name, O_RDWR, 0)) == -1)
+		{
+			throw std::system_error(errno, std::generic_category(), "shm_open");
+		}
+		if (ftruncate(shm_obj_fd, static_cast<off_t>(shm_obj_size)) == -1)
 		{
-			throw std::system_error(errno, std::generic_category(), "sem_wait");
+			int err = errno;
+			close(shm_obj_fd);
+			throw std::system_error(err, std::generic_category(), "ftruncate");
 		}
+		close(shm_obj_fd);
 	}
 
-	// Inline method: Drop exclusive access to shared memory
-	inline void drop_sem ()
+	// Apply huge-page, NUMA and prefault options to a mapping
+	static void apply_map_options (void *shm_map_ptr, size_t shm_map_size,
+		shared_map_options_t const &options, bool set_numa_policy)
 	{
-		if (sem_post(&(d_shared_map_info_p->sem)) == -1)
+		// Huge pages (shmem THP: honoured when shmem_enabled is advise/always)
+		if (options.huge_pages &&
+			madvise(shm_map_ptr, shm_map_size, MADV_HUGEPAGE) == -1)
 		{
-			throw std::system_error(errno, std::generic_category(), "sem_wait");
+			throw std::system_error(errno, std::generic_category(), "madvise");
+		}
+
+		// NUMA placement: Stored with the object, so only its creator sets it
+		if (set_numa_policy && options.numa_policy != MPOL_DEFAULT &&
+			syscall(SYS_mbind, shm_map_ptr, shm_map_size, options.numa_policy,
+				&(options.numa_nodemask), sizeof(options.numa_nodemask) * 8, 0) == -1)
+		{
+			throw std::system_error(errno, std::generic_category(), "mbind");
+		}
+
+		// Prefault after the policy is in place, so pages land where intended
+		if (options.populate &&
+			madvise(shm_map_ptr, shm_map_size, MADV_POPULATE_WRITE) == -1)
+		{
+			if (errno != EINVAL) {
+				throw std::system_error(errno, std::generic_category(), "madvise");
+			}
+
+			// Kernel predates MADV_POPULATE_WRITE: read-fault every page
+			size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			for (size_t i = 0; i < shm_map_size; i += page_size) {
+				(void)(reinterpret_cast<uint8_t volatile *>(shm_map_ptr)[i]);
+			}
 		}
 	}
 
@@ -93,16 +1278,16 @@ public:
     using value_type         = T;
 
 	// Alias: Pointer as pointer to value type
-	using pointer            = T *;
+	using pointer            = Pointer<T>;
 
 	// Alias: Pointer to const
-	using const_pointer      = T const *;
+	using const_pointer      = Pointer<T const>;
 
 	// Alias: Most general pointer
-	using void_pointer       = void *;
+	using void_pointer       = Pointer<void>;
 
 	// Alias: Most general pointer (to const)
-	using const_void_pointer = const void *;
+	using const_void_pointer = Pointer<const void>;
 
 	// Alias: Reference
 	using reference          = T&;
@@ -113,36 +1298,53 @@ public:
 	// Alias: Allocation and deallocation size
 	using size_type          = size_t;
 
+	// Traits: Containers take the allocator along on copy, move and swap, so
+	// moving a container between maps steals its memory instead of copying
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap            = std::true_type;
+
+	// Traits: Allocators of different maps are not interchangeable
+	using is_always_equal    = std::false_type;
+
     // Rebinding support: Let container construct arbitrary type allocator
     template <class U>
     struct rebind {
-    	using other          = Shared_Allocator<U>;
+    	using other          = Shared_Allocator<U, Pointer>;
     };
 
+    // Operator: Copy assignment
+    Shared_Allocator &operator=(const Shared_Allocator &origin)
+    {
+        // Take a reference on the new map, the copy releases the old one
+        Shared_Allocator copy(origin);
+        exchange_map(copy);
+        return *this;
+    }
+
     // Operator: Move assignment
     template <class U>
-    Shared_Allocator &operator=(Shared_Allocator<U> &&origin)
+    Shared_Allocator &operator=(Shared_Allocator<U, Pointer> &&origin)
     {
         // Self-assign check
-        if (&origin == this) { return *this; }
-
-        // Release held resources 
-        // None
+        if (static_cast<void *>(&origin) == this) { return *this; }
 
-        // Ownership transfer
-        this->d_shared_map_info_p = origin.shared_map_info_p();
-        this->d_static_allocator = origin.static_allocator();
-
-        // Note: We don't adjust the reference count because the ownership
-        // is being transferred (i.e. net reference count remains unchanged)
-
-        // HINT: Copy the pointer values, and null the origin ones
-        // HINT: In a copy you just make a new and then copy contents by value
+        // Ownership transfer: The origin takes over (and eventually releases)
+        // the reference held so far, so the net reference count is unchanged
+        exchange_map(origin);
         return *this;
     }
 
 	// Constructor
-	Shared_Allocator (char const *shared_map_name, size_t shared_map_size)
+	Shared_Allocator (char const *shared_map_name, size_t shared_map_size):
+		Shared_Allocator(shared_map_name, shared_map_size, shared_map_options_t{})
+	{
+		// Nothing to do
+	}
+
+	// Constructor: With huge-page, NUMA and prefault options
+	Shared_Allocator (char const *shared_map_name, size_t shared_map_size,
+		shared_map_options_t const &options)
 	{
 		int err;              // Contains return value (usually errno)
 		int shm_obj_fd = -1;  // File-descriptor for shared memory file
@@ -156,6 +1358,19 @@ public:
 			throw std::invalid_argument("Shared map name too long");
 		}
 
+		// Parameter check: Number of sub-heaps
+		if (options.n_heaps > SHARED_MAX_HEAPS)
+		{
+			throw std::invalid_argument("Too many sub-heaps");
+		}
+
+		// Parameter check: Every slot offset fits in a slot link
+		if (std::max(shared_map_size, options.max_size) >
+			SHARED_MAX_MAP_SIZE - SHARED_MAP_OFFSET)
+		{
+			throw std::invalid_argument("Shared map too large");
+		}
+
 		// Parameters: Shared Memory Object
 		int shm_flags = O_CREAT | O_RDWR | O_TRUNC;  // Create/reset map
 		mode_t shm_mode = S_IRUSR | S_IWUSR;         // Read/Write for user
@@ -168,7 +1383,11 @@ public:
 		}
 
 		// Parameters: Shared Memory Object Properties
-		size_t required_shared_map_size = shared_map_size + sizeof(shared_map_info_t);
+		size_t required_shared_map_size = shared_map_size + SHARED_MAP_OFFSET;
+
+		// Parameters: Address space for growth (beyond the object until it grows)
+		size_t reserved_shared_map_size =
+			std::max(shared_map_size, options.max_size) + SHARED_MAP_OFFSET;
 
 		// Set size via ftruncate
 		if ((err = ftruncate(shm_obj_fd, required_shared_map_size)) == -1)
@@ -183,7 +1402,7 @@ public:
 		off_t mmap_offset = 0;                  // Zero offset
 
 		// Map shared memory into process
-		if ((shm_map_ptr = mmap(mmap_addr, required_shared_map_size, mmap_prot,
+		if ((shm_map_ptr = mmap(mmap_addr, reserved_shared_map_size, mmap_prot,
 			mmap_flags, shm_obj_fd, mmap_offset))
 			== MAP_FAILED)
 		{
@@ -194,37 +1413,185 @@ public:
 			close(shm_obj_fd);
 		}
 
-		// Parameters: Information structure
-		void *free_shm_map_ptr = reinterpret_cast<uint8_t *>(shm_map_ptr) 
-		    + sizeof(shared_map_info_t);
+		// Apply backing options before the map is first touched
+		apply_map_options(shm_map_ptr, required_shared_map_size, options, true);
 
 		// Install information structure
 		d_shared_map_info_p = reinterpret_cast<shared_map_info_t *>(shm_map_ptr);
-		d_shared_map_info_p->ref_count = 1;
-		d_shared_map_info_p->shm_map_ptr = free_shm_map_ptr;
+		d_shared_map_info_p->shm_map_offset = SHARED_MAP_OFFSET;
 		d_shared_map_info_p->shm_map_size = shared_map_size;
+		d_shared_map_info_p->shm_map_reserved = reserved_shared_map_size;
+		d_shared_map_info_p->n_segments = 1;
+		d_shared_map_info_p->segment_ends[0] = shared_map_size;
+		d_shared_map_info_p->options = options;
 
 		// Copy in name
 		strncpy(d_shared_map_info_p->shm_map_name, shared_map_name, 
 			MAX_SHM_MAP_NAME_SIZE);
 
-		// Parameters: Unnamed semaphore
-		int sem_pshared = 1;       // Share between processes, NOT threads
-		int sem_init_value = 1;    // Init in an open state
+		// Empty slot lists
+		for (size_t i = 0; i < SHARED_CLASS_COUNT; ++i) {
+			new (&(d_shared_map_info_p->free_slots[i])) std::atomic<uint64_t>(0);
+		}
+		new (&(d_shared_map_info_p->n_slot_allocations)) std::atomic<size_t>(0);
+		new (&(d_shared_map_info_p->n_slot_deallocations)) std::atomic<size_t>(0);
+		new (&(d_shared_map_info_p->n_slot_failed)) std::atomic<size_t>(0);
+
+		// No directory until the first named object, no sub-heaps until installed
+		new (&(d_shared_map_info_p->directory)) std::atomic<size_t>(0);
+		d_shared_map_info_p->n_heaps = 0;
+		d_shared_map_info_p->heap_size = 0;
+		d_shared_map_info_p->heaps = 0;
+
+		// Registry: This process holds the first handle, no block has an owner
+		new (&(d_shared_map_info_p->owned_blocks)) std::atomic<bool>(false);
+		for (process_t &process : d_shared_map_info_p->processes) {
+			process.pid = 0;
+			process.n_handles = 0;
+			process.mapping = 0;
+		}
+		d_shared_map_info_p->processes[0].pid = getpid();
+		d_shared_map_info_p->processes[0].n_handles = 1;
+		d_shared_map_info_p->processes[0].mapping = reinterpret_cast<uintptr_t>(shm_map_ptr);
+
+		// Init robust mutex (taken over, with the map repaired, if its holder dies)
+		init_lock(&(d_shared_map_info_p->lock));
+
+		// Setup the static allocator (handles are recreated on use). Checker
+		// state is per process, so blocks are only annotated on request
+		Static_Allocator<T>{reinterpret_cast<uint8_t *>(shm_map_ptr) + 
+			d_shared_map_info_p->shm_map_offset, d_shared_map_info_p->shm_map_size}
+			.set_annotations(options.annotate);
+
+		// Divide part of the map into sub-heaps, each with its own metadata
+		if (options.n_heaps != 0) {
+			install_heaps(options);
+		}
+
+		// Publish the header last, so attaching processes see a complete map
+		d_shared_map_info_p->version = SHARED_MAP_VERSION;
+		d_shared_map_info_p->features = SHARED_MAP_FEATURES;
+		new (&(d_shared_map_info_p->magic)) std::atomic<uint32_t>(0);
+		d_shared_map_info_p->magic.store(SHARED_MAP_MAGIC, std::memory_order_release);
+		register_map(shm_map_ptr);
+	}
+
+	// Constructor: Attach to a live map created by another process
+	explicit Shared_Allocator (char const *shared_map_name):
+		Shared_Allocator(shared_map_name, shared_map_options_t{})
+	{
+		// Nothing to do
+	}
+
+	// Constructor: Attach with huge-page and prefault options (NUMA policy
+	// is a property of the map set by its creator)
+	Shared_Allocator (char const *shared_map_name,
+		shared_map_options_t const &options)
+	{
+		int shm_obj_fd = -1;  // File-descriptor for shared memory file
+		void *shm_map_ptr = nullptr; // Pointer to mapped shared memory
+		struct stat shm_obj_stat;    // Properties of the shared memory file
+		d_shared_map_info_p = nullptr;
+
+		// Check: Name is appropriate length
+		if (strnlen(shared_map_name, MAX_SHM_MAP_NAME_SIZE + 1) 
+			>= MAX_SHM_MAP_NAME_SIZE + 1)
+		{
+			throw std::invalid_argument("Shared map name too long");
+		}
+
+		// Open existing POSIX shared memory map (no create, no truncate)
+		if ((shm_obj_fd = shm_open(shared_map_name, O_RDWR, 0)) == -1)
+		{
+			throw std::system_error(errno, std::generic_category(), "shm_open");
+		}
+
+		// Size of the existing map
+		if (fstat(shm_obj_fd, &shm_obj_stat) == -1)
+		{
+			int err = errno;
+			close(shm_obj_fd);
+			throw std::system_error(err, std::generic_category(), "fstat");
+		}
+
+		// Check: Map large enough to hold the header
+		size_t shm_obj_size = static_cast<size_t>(shm_obj_stat.st_size);
+		if (shm_obj_size < SHARED_MAP_OFFSET)
+		{
+			close(shm_obj_fd);
+			throw std::runtime_error("Shared map has no header");
+		}
+
+		// Map shared memory into process (at any address)
+		if ((shm_map_ptr = mmap(nullptr, shm_obj_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, shm_obj_fd, 0)) == MAP_FAILED)
+		{
+			int err = errno;
+			close(shm_obj_fd);
+			throw std::system_error(err, std::generic_category(), "mmap");
+		}
 
-		// Init unnamed semaphore
-		if ((err = sem_init(&(d_shared_map_info_p->sem), sem_pshared,
-			sem_init_value)) != 0)
+		// Check: Header is valid and matches the object
+		shared_map_info_t *info = reinterpret_cast<shared_map_info_t *>(shm_map_ptr);
+		if (char const *error = header_error(info, shm_obj_size))
 		{
-			throw std::system_error(errno, std::generic_category(), "sem_init");
+			munmap(shm_map_ptr, shm_obj_size);
+			close(shm_obj_fd);
+			throw std::runtime_error(error);
+		}
+
+		// Case: Growing map, take the address space for its growth too
+		size_t reserved_shared_map_size = info->shm_map_reserved;
+		if (reserved_shared_map_size > shm_obj_size) {
+			munmap(shm_map_ptr, shm_obj_size);
+			if ((shm_map_ptr = mmap(nullptr, reserved_shared_map_size,
+				PROT_READ | PROT_WRITE, MAP_SHARED, shm_obj_fd, 0)) == MAP_FAILED)
+			{
+				int err = errno;
+				close(shm_obj_fd);
+				throw std::system_error(err, std::generic_category(), "mmap");
+			}
+			info = reinterpret_cast<shared_map_info_t *>(shm_map_ptr);
+		}
+		close(shm_obj_fd);
+
+		// Apply backing options to this process's mapping
+		try {
+			apply_map_options(shm_map_ptr, shm_obj_size, options, false);
+		} catch (...) {
+			munmap(shm_map_ptr, reserved_shared_map_size);
+			throw;
 		}
 
-		// Setup the static allocator
-		Static_Allocator<T> static_allocator{d_shared_map_info_p->shm_map_ptr, 
-			d_shared_map_info_p->shm_map_size};
+		// Join the map, unless its last process destroyed it meanwhile, and
+		// release what dead processes left behind (e.g. after a crash)
+		d_shared_map_info_p = info;
+		uintptr_t mapping;
+		take_lock();
+		try {
+			if (info->magic.load(std::memory_order_relaxed) != SHARED_MAP_MAGIC) {
+				throw std::runtime_error("Shared map was destroyed");
+			}
+			reap_dead();
+			process_t *entry = add_handle();
+			if (entry->mapping == 0) {
+				entry->mapping = reinterpret_cast<uintptr_t>(shm_map_ptr);
+			}
+			mapping = entry->mapping;
+		} catch (...) {
+			drop_lock();
+			munmap(shm_map_ptr, reserved_shared_map_size);
+			throw;
+		}
+		drop_lock();
 
-		// Assign (move operator of class will simply transfer ownership)
-		d_static_allocator = static_allocator;
+		// Case: Process has a mapping of the map already, share that one
+		// (its backing options stay those it was attached with)
+		if (mapping != reinterpret_cast<uintptr_t>(shm_map_ptr)) {
+			d_shared_map_info_p = reinterpret_cast<shared_map_info_t *>(mapping);
+			munmap(shm_map_ptr, reserved_shared_map_size);
+		}
+		register_map(d_shared_map_info_p.get());
 	}
 
     // Copy constructor
@@ -232,55 +1599,115 @@ public:
     {
     	// Simply copy info for shared memory and allocator
     	d_shared_map_info_p = origin.shared_map_info_p();
-    	d_static_allocator = origin.static_allocator();
 
-    	// Update the reference count
-    	take_sem();
-    	d_shared_map_info_p->ref_count++;
-    	drop_sem();
+    	// Count the handle for this process
+    	take_lock();
+    	try {
+    		add_handle();
+    	} catch (...) {
+    		drop_lock();
+    		throw;
+    	}
+    	drop_lock();
+    	register_map(d_shared_map_info_p.get());
     }
 
     // Support for allocating other types
     template <class U>
-    Shared_Allocator (const Shared_Allocator<U> &other);
+    Shared_Allocator (const Shared_Allocator<U, Pointer> &other):
+    	d_shared_map_info_p(reinterpret_cast<shared_map_info_t *>(
+    		other.shared_map_info_p()))
+    {
+    	// Count the handle for this process
+    	take_lock();
+    	try {
+    		add_handle();
+    	} catch (...) {
+    		drop_lock();
+    		throw;
+    	}
+    	drop_lock();
+    	register_map(d_shared_map_info_p.get());
+    }
+
+    // Operator: Equality (memory from one may be freed by the other)
+    template <class U>
+    bool operator== (const Shared_Allocator<U, Pointer> &other) const
+    {
+    	return reinterpret_cast<void *>(shared_map_info_p()) ==
+    		reinterpret_cast<void *>(other.shared_map_info_p());
+    }
+
+    // Operator: Inequality
+    template <class U>
+    bool operator!= (const Shared_Allocator<U, Pointer> &other) const
+    {
+    	return !(*this == other);
+    }
 
 	// Destructor: We cannot recover from exceptions here - termianate on throw
 	~Shared_Allocator () noexcept(false)
 	{
 		bool destroy = false;
+		size_t n_processes;
+		uintptr_t mapping;
 
-		// Check: update reference count
-		take_sem();
-		d_shared_map_info_p->ref_count -= 1;
-		destroy = (d_shared_map_info_p->ref_count == 0);
-		drop_sem();
+		// Case: Cleared view of a map (see fork_reserve())
+		if (d_shared_map_info_p.get() == nullptr) {
+			return;
+		}
+		unregister_map(d_shared_map_info_p.get());
+
+		// Check: Drop the handle, the map goes with the last live process
+		// (unpublished first, so that no process attaches meanwhile)
+		take_lock();
+		try {
+			n_processes = drop_handle(&mapping);
+		} catch (...) {
+			drop_lock();
+			throw;
+		}
+		if ((destroy = (n_processes == 0))) {
+			d_shared_map_info_p->magic.store(0, std::memory_order_relaxed);
+		}
+		drop_lock();
 
 		// Optionally: Remove infrastructure if no references left
 		if (destroy)
 		{
 			int err;
-			std::cout << "[" << getpid() << "] "
-			    << "~Shared_Allocator(destroy=true)" << std::endl;
-			// #1: delete semaphore
-			if (sem_destroy(&(d_shared_map_info_p->sem)) == -1)
+			ALLOCATOR_TRACE_EVENT(static_allocator().trace_ring(), TRACE_MAP_DESTROY,
+				getpid(), d_shared_map_info_p->shm_map_size);
+
+			// #1: delete mutexes
+			for (size_t i = 0; i < d_shared_map_info_p->n_heaps; ++i) {
+				if ((err = pthread_mutex_destroy(&(heap_at(i)->lock))) != 0)
+				{
+					throw std::system_error(err, std::generic_category(),
+						"pthread_mutex_destroy");
+				}
+			}
+			if ((err = pthread_mutex_destroy(&(d_shared_map_info_p->lock))) != 0)
 			{
-				throw std::system_error(errno, std::generic_category(), 
-					"sem_destroy");
+				throw std::system_error(err, std::generic_category(), 
+					"pthread_mutex_destroy");
 			}
 
 			// #2: copy the name + size out so we can unlink after unmap
 			char shm_map_name[MAX_SHM_MAP_NAME_SIZE + 1];
 			memcpy(shm_map_name, d_shared_map_info_p->shm_map_name, 
 				MAX_SHM_MAP_NAME_SIZE + 1);
-			size_t shm_map_size = d_shared_map_info_p->shm_map_size + 
-				sizeof(shared_map_info_t);
+			size_t shm_map_size = d_shared_map_info_p->shm_map_reserved;
 
-			// #3: unmap the memory page
-			if ((err = munmap(d_shared_map_info_p, shm_map_size)) == -1)
+			// #3: unmap the memory page (with no annotations left behind), and
+			// the process's own mapping if this handle used an inherited one
+			ALLOCATOR_ANNOTATE_TAGS(d_shared_map_info_p.get(), shm_map_size);
+			if (mapping != 0 && mapping != reinterpret_cast<uintptr_t>(
+				d_shared_map_info_p.get()))
 			{
-				throw std::system_error(errno, std::generic_category(), 
-					"munmap");
+				unmap(reinterpret_cast<void *>(mapping), shm_map_size);
 			}
+			unmap(d_shared_map_info_p.get(), shm_map_size);
 
 
 			// #4: Unlink the shared object
@@ -290,15 +1717,27 @@ public:
 					"shm_unlink");
 			}
 		} else {
-			std::cout << "[" << getpid() << "] "
-			    << "~Shared_Allocator(destroy=false)" << std::endl;
+			ALLOCATOR_TRACE_EVENT(static_allocator().trace_ring(), TRACE_MAP_DETACH,
+				getpid(), n_processes);
+
+			// Case: Last handle of the process, release its mapping
+			if (mapping != 0) {
+				size_t shm_map_size = d_shared_map_info_p->shm_map_reserved;
+				ALLOCATOR_ANNOTATE_TAGS(reinterpret_cast<void *>(mapping), shm_map_size);
+				unmap(reinterpret_cast<void *>(mapping), shm_map_size);
+			}
 		}
 	}
 
 	// Allocate #1: General allocation
 	pointer allocate (size_type n_obj)
 	{
-		return d_static_allocator.allocate(n_obj);
+		// Case: Over-aligned type (never served from the slot lists)
+		if (alignof(T) > SHARED_SLOT_GRANULARITY) {
+			return pointer(reinterpret_cast<T *>(
+				allocate_aligned(n_obj * sizeof(T), alignof(T))));
+		}
+		return pointer(reinterpret_cast<T *>(allocate_b(n_obj * sizeof(T))));
 	}
 
 	// Allocate #2: Placement support
@@ -308,108 +1747,692 @@ public:
 	}
 
 	// Allocate #3: Typeless allocation of n bytes
-	void_pointer allocate_b (size_t n_bytes)
+	void *allocate_b (size_t n_bytes)
+	{
+		void *ptr;
+
+		// Case: Large request (from the home heap, else the backing allocator)
+		if (n_bytes == 0 || !is_slotted(n_bytes)) {
+			if (in_home_heap([&] (Static_Allocator<uint8_t> heap) {
+				own(heap, ptr = heap.allocate_b(n_bytes)); }) && ptr != nullptr)
+			{
+				return ptr;
+			}
+
+			take_lock();
+			try {
+				while ((ptr = static_allocator().allocate_b(n_bytes)) == nullptr &&
+					grow(n_bytes));
+				own(static_allocator(), ptr);
+			} catch (...) {
+				drop_lock();
+				throw;
+			}
+			drop_lock();
+			return ptr;
+		}
+
+		// Pop a slot, or refill the list if empty
+		size_t class_index = class_of(n_bytes);
+		if ((ptr = pop_slot(class_index)) == nullptr) {
+			ptr = refill(class_index);
+		}
+
+		if (ptr != nullptr) {
+			d_shared_map_info_p->n_slot_allocations.fetch_add(1, std::memory_order_relaxed);
+			ALLOCATOR_TRACE_EVENT(static_allocator().trace_ring(), TRACE_ALLOCATE,
+				n_bytes, offset_of(ptr) * SHARED_SLOT_GRANULARITY);
+		} else {
+			d_shared_map_info_p->n_slot_failed.fetch_add(1, std::memory_order_relaxed);
+			ALLOCATOR_TRACE_EVENT(static_allocator().trace_ring(), TRACE_ALLOCATE_FAILED,
+				n_bytes, free_size());
+		}
+		return ptr;
+	}
+
+	// Allocate #4: Typeless allocation of n bytes at a multiple of alignment.
+	// Release with deallocate_aligned() and the same alignment
+	void *allocate_aligned (size_t n_bytes, size_t alignment)
+	{
+		void *ptr;
+
+		// Case: Slots are suitably aligned
+		if (alignment <= SHARED_SLOT_GRANULARITY) {
+			return allocate_b(n_bytes);
+		}
+
+		// Case: Home heap has room
+		if (in_home_heap([&] (Static_Allocator<uint8_t> heap) {
+			own(heap, ptr = heap.allocate_aligned(n_bytes, alignment)); }) && ptr != nullptr)
+		{
+			return ptr;
+		}
+
+		take_lock();
+		try {
+			while ((ptr = static_allocator().allocate_aligned(n_bytes, alignment))
+				== nullptr && grow(n_bytes + alignment));
+			own(static_allocator(), ptr);
+		} catch (...) {
+			drop_lock();
+			throw;
+		}
+		drop_lock();
+		return ptr;
+	}
+
+	// Allocate #5: Up to count blocks of n bytes each. Slots are popped
+	// without locking, anything else is carved under a single acquisition of
+	// the lock. Returns the number of blocks stored in out
+	size_t allocate_bulk (size_t n_bytes, size_t count, void **out)
 	{
-		return d_static_allocator.allocate_b(n_bytes);
+		size_t n_done = 0;
+
+		// Case: Large request (from the home heap, the rest from the backing
+		// allocator)
+		if (n_bytes == 0 || !is_slotted(n_bytes)) {
+			in_home_heap([&] (Static_Allocator<uint8_t> heap) {
+				n_done = heap.allocate_bulk(n_bytes, count, out);
+				for (size_t i = 0; i < n_done; ++i) {
+					own(heap, out[i]);
+				}
+			});
+			if (n_done == count) {
+				return n_done;
+			}
+
+			take_lock();
+			try {
+				size_t n_heap = n_done;
+				n_done += static_allocator().allocate_bulk(n_bytes, count - n_done,
+					out + n_done);
+				while (n_done < count && grow((count - n_done) * n_bytes)) {
+					n_done += static_allocator().allocate_bulk(n_bytes,
+						count - n_done, out + n_done);
+				}
+				for (size_t i = n_heap; i < n_done; ++i) {
+					own(static_allocator(), out[i]);
+				}
+			} catch (...) {
+				drop_lock();
+				throw;
+			}
+			drop_lock();
+			return n_done;
+		}
+
+		// Pop slots, refilling (one slab per lock) whenever the list runs dry
+		size_t class_index = class_of(n_bytes);
+		for (; n_done < count; ++n_done) {
+			if ((out[n_done] = pop_slot(class_index)) == nullptr &&
+				(out[n_done] = refill(class_index)) == nullptr) {
+				break;
+			}
+		}
+
+		d_shared_map_info_p->n_slot_allocations.fetch_add(n_done, std::memory_order_relaxed);
+		if (n_done < count) {
+			d_shared_map_info_p->n_slot_failed.fetch_add(1, std::memory_order_relaxed);
+		}
+		return n_done;
 	}
 
     // Convert a reference to a pointer
     pointer address (reference r) const
     {
-    	return static_cast<pointer>(std::addressof(r));
+    	return pointer(std::addressof(r));
     }
 
     // Converts a reference to a const pointer
     const_pointer address (const_reference r) const
     {
-    	return static_cast<const_pointer>(std::addressof(r));
+    	return const_pointer(std::addressof(r));
     }
 
     // Deallocate
     void deallocate (pointer ptr, size_type n_obj)
     {
-    	return d_static_allocator.deallocate(ptr, n_obj);
+    	deallocate_aligned(raw(ptr), n_obj * sizeof(T), alignof(T));
+    }
+
+    // Deallocate n bytes obtained from allocate_aligned()
+    void deallocate_aligned (void *ptr, size_t n_bytes, size_t alignment)
+    {
+    	// Case: Large or over-aligned request
+    	if (ptr == nullptr || !is_slotted(n_bytes) ||
+    		alignment > SHARED_SLOT_GRANULARITY) {
+    		heap_t *heap;
+
+    		// Case: From a sub-heap
+    		if (ptr != nullptr && (heap = heap_of(ptr)) != nullptr) {
+    			heap_deallocate(heap, ptr, n_bytes);
+    			return;
+    		}
+
+    		take_lock();
+    		try {
+    			Static_Allocator<uint8_t>(static_allocator()).deallocate(
+    				static_cast<uint8_t *>(ptr), n_bytes);
+    		} catch (...) {
+    			drop_lock();
+    			throw;
+    		}
+    		drop_lock();
+    		return;
+    	}
+
+    	// Push the slot
+    	uint32_t offset = offset_of(ptr);
+    	ALLOCATOR_TRACE_EVENT(static_allocator().trace_ring(), TRACE_DEALLOCATE,
+    		n_bytes, static_cast<size_t>(offset) * SHARED_SLOT_GRANULARITY);
+    	push_slots(class_of(n_bytes), offset, offset);
+    	d_shared_map_info_p->n_slot_deallocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Deallocate count blocks of n bytes each (e.g. from allocate_bulk)
+    void deallocate_bulk (void * const *ptrs, size_t count, size_t n_bytes)
+    {
+    	if (count == 0) {
+    		return;
+    	}
+
+    	// Case: Large request, with sub-heaps (each block goes to its own heap)
+    	if (!is_slotted(n_bytes) && d_shared_map_info_p->n_heaps != 0) {
+    		for (size_t i = 0; i < count; ++i) {
+    			deallocate_aligned(ptrs[i], n_bytes, SHARED_SLOT_GRANULARITY);
+    		}
+    		return;
+    	}
+
+    	// Case: Large request
+    	if (!is_slotted(n_bytes)) {
+    		take_lock();
+    		try {
+    			Static_Allocator<uint8_t>(static_allocator()).deallocate_bulk(
+    				ptrs, count, n_bytes);
+    		} catch (...) {
+    			drop_lock();
+    			throw;
+    		}
+    		drop_lock();
+    		return;
+    	}
+
+    	// Chain the slots privately, then publish them with one CAS
+    	for (size_t i = 0; i + 1 < count; ++i) {
+    		reinterpret_cast<slot_t *>(ptrs[i])->next.store(offset_of(ptrs[i + 1]),
+    			std::memory_order_relaxed);
+    	}
+    	push_slots(class_of(n_bytes), offset_of(ptrs[0]), offset_of(ptrs[count - 1]));
+    	d_shared_map_info_p->n_slot_deallocations.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    // Construct an object in the map (e.g. a Shared_Mutex or a queue from
+    // shared_sync.cpp). Throws std::bad_alloc when the map is exhausted
+    template <class U, class... Args>
+    U *new_object (Args&&... args)
+    {
+    	void *ptr = allocate_aligned(sizeof(U), alignof(U));
+
+    	if (ptr == nullptr) {
+    		throw std::bad_alloc();
+    	}
+
+    	try {
+    		return new (ptr) U(std::forward<Args>(args)...);
+    	} catch (...) {
+    		deallocate_aligned(ptr, sizeof(U), alignof(U));
+    		throw;
+    	}
+    }
+
+    // Destroy an object constructed by new_object() (in any process)
+    template <class U>
+    void delete_object (U *ptr)
+    {
+    	if (ptr == nullptr) {
+    		return;
+    	}
+
+    	ptr->~U();
+    	deallocate_aligned(reinterpret_cast<void *>(ptr), sizeof(U), alignof(U));
+    }
+
+    // Construct an object in the map under a name (of up to
+    // MAX_SHARED_OBJECT_NAME_SIZE characters) for find() in any process.
+    // Throws std::invalid_argument if the name is taken, std::bad_alloc if
+    // the map or directory is full
+    template <class U, class... Args>
+    U *construct (char const *name, Args&&... args)
+    {
+    	directory_entry_t *e = reserve<U>(name, check_name(name));
+
+    	if (e == nullptr) {
+    		throw std::invalid_argument("Object name already in use");
+    	}
+    	return construct_into<U>(e, std::forward<Args>(args)...);
+    }
+
+    // Object constructed under name, constructing it if there is none. Waits
+    // if another process is constructing it at the same time
+    template <class U, class... Args>
+    U *find_or_construct (char const *name, Args&&... args)
+    {
+    	uint32_t hash = check_name(name);
+
+    	for (;;) {
+    		U *ptr;
+    		directory_entry_t *e;
+
+    		if ((ptr = find<U>(name)) != nullptr) {
+    			return ptr;
+    		}
+    		if ((e = reserve<U>(name, hash)) != nullptr) {
+    			return construct_into<U>(e, std::forward<Args>(args)...);
+    		}
+
+    		// Case: Being constructed elsewhere
+    		sched_yield();
+    	}
+    }
+
+    // Object constructed under name (nullptr if none, or not yet complete).
+    // Lock-free. Throws std::runtime_error if it was constructed as another type
+    template <class U>
+    U *find (char const *name) const
+    {
+    	directory_entry_t *e = lookup(name, check_name(name));
+
+    	if (e == nullptr || e->state.load(std::memory_order_acquire) != DIRECTORY_READY) {
+    		return nullptr;
+    	}
+
+    	// Check: Type matches the constructed one
+    	if (e->type_hash != type_hash_of<U>()) {
+    		throw std::runtime_error("Named object has a different type");
+    	}
+
+    	return reinterpret_cast<U *>(reinterpret_cast<uint8_t *>(
+    		d_shared_map_info_p.get()) + e->offset);
+    }
+
+    // Destroy the object constructed under name. Returns false if there is
+    // none (or another process destroyed it first). Other processes must no
+    // longer use the object
+    template <class U>
+    bool destroy (char const *name)
+    {
+    	U *ptr = find<U>(name);
+
+    	if (ptr == nullptr) {
+    		return false;
+    	}
+
+    	// Claim the entry, so that only one process destroys the object
+    	directory_entry_t *e = lookup(name, check_name(name));
+    	uint32_t expected = DIRECTORY_READY;
+    	if (!e->state.compare_exchange_strong(expected, DIRECTORY_REMOVED,
+    		std::memory_order_acq_rel)) {
+    		return false;
+    	}
+
+    	delete_object(ptr);
+    	return true;
     }
 
-    // Available memory to allocate
+    // Available memory to allocate, in the sub-heaps too (free slots in the
+    // slot lists and blocks on return stacks excluded, see consolidate())
     size_t free_size () const
     {
-    	return d_static_allocator.free_size();
+    	size_t n_free = static_allocator().free_size();
+
+    	for (size_t i = 0; i < d_shared_map_info_p->n_heaps; ++i) {
+    		n_free += heap_allocator(heap_at(i)).free_size();
+    	}
+    	return n_free;
     }
 
     bool unified () const
     {
-    	return d_static_allocator.unified();
+    	for (size_t i = 0; i < d_shared_map_info_p->n_heaps; ++i) {
+    		if (!heap_allocator(heap_at(i)).unified()) {
+    			return false;
+    		}
+    	}
+    	return static_allocator().unified();
     }
 
-	shared_map_info_t *shared_map_info_p () const
-	{
-		return this->d_shared_map_info_p;
-	}
+    // Free the blocks waiting on the return stacks of the sub-heaps (which
+    // are otherwise freed when their heap next allocates)
+    void consolidate ()
+    {
+    	for (size_t i = 0; i < d_shared_map_info_p->n_heaps; ++i) {
+    		heap_t *heap = heap_at(i);
+
+    		take_lock(heap);
+    		try {
+    			drain(heap);
+    		} catch (...) {
+    			drop_lock(heap);
+    			throw;
+    		}
+    		drop_lock(heap);
+    	}
+    }
 
-	Static_Allocator<T> static_allocator () const
-	{
-		return this->d_static_allocator;
-	}
-};
+    // Number of sub-heaps
+    size_t n_heaps () const
+    {
+    	return d_shared_map_info_p->n_heaps;
+    }
 
+    // Assign the calling thread (and processes it forks) to sub-heap index
+    // (modulo the number of heaps), or -1 to that of the CPU it runs on
+    static void set_home_heap (int index)
+    {
+    	shared_home_heap() = index;
+    }
 
-int main ()
-{
-	char const *shared_map_name = "rosmem";
-	size_t shared_map_size = 4096;
+    // Make blocks (above SHARED_MAX_SLOT_SIZE) allocated by the calling thread
+    // owned by its process, so that they are freed once it dies, see reap()
+    static void set_owned_allocations (bool owned)
+    {
+    	shared_owned_allocations() = owned;
+    }
+
+    // Hand an owned block of n bytes (as given to allocate_aligned()) over to
+    // the map, e.g. once it is shared with other processes, so that it
+    // outlives its owner
+    void disown (void *ptr, size_t n_bytes, size_t alignment = 1)
+    {
+    	heap_t *heap;
+
+    	// Case: Slots are never owned
+    	if (ptr == nullptr || (n_bytes != 0 && is_slotted(n_bytes) &&
+    		alignment <= SHARED_SLOT_GRANULARITY)) {
+    		return;
+    	}
+
+    	// Case: From a sub-heap
+    	if ((heap = heap_of(ptr)) != nullptr) {
+    		take_lock(heap);
+    		heap_allocator(heap).set_owner(ptr, 0);
+    		drop_lock(heap);
+    		return;
+    	}
+
+    	take_lock();
+    	Static_Allocator<uint8_t>(static_allocator()).set_owner(ptr, 0);
+    	drop_lock();
+    }
 
-	// Get process PID
-	int pid = getpid();
+    // Release what dead processes left behind: their registry entries, and
+    // the blocks they owned. Also done whenever a process attaches, or drops
+    // its last handle. Returns the number of dead processes reaped
+    size_t reap ()
+    {
+    	size_t n_dead;
+
+    	take_lock();
+    	try {
+    		n_dead = reap_dead();
+    	} catch (...) {
+    		drop_lock();
+    		throw;
+    	}
+    	drop_lock();
+    	return n_dead;
+    }
 
-	// Make the shared allocator
-	Shared_Allocator<int> my_allocator{shared_map_name, shared_map_size};
+    // Number of processes holding handles to the map (dead ones included,
+    // until reaped)
+    size_t n_processes () const
+    {
+    	size_t n_processes = 0;
 
-	// Display the number of bytes
-	std::cout << "[" << pid << "] "
-			  << "Bytes (asked = " << shared_map_size
-	          << ", free = "  << my_allocator.free_size()
-	          << ")" << std::endl;
+    	for (process_t const &process : d_shared_map_info_p->processes) {
+    		n_processes += (process.pid != 0);
+    	}
+    	return n_processes;
+    }
 
-	// Allocate a vector
-	{
-		std::vector<int, Shared_Allocator<int>> my_vector{6, my_allocator};
+    // Current size of the map (grows up to max_size on exhaustion)
+    size_t map_size () const
+    {
+    	return d_shared_map_info_p->shm_map_size;
+    }
 
-		// Zero the vector
-		std::fill(my_vector.begin(), my_vector.end(), 0);
+    // Give back trailing segments added by growth which are entirely free,
+    // shrinking the shared memory object. Slabs only land in a segment when
+    // the map was full below it, and then keep it. Returns the number of
+    // bytes released
+    size_t release_segments ()
+    {
+    	shared_map_info_t *info = d_shared_map_info_p.get();
+    	size_t old_size, n_released;
+
+    	take_lock();
+    	try {
+    		old_size = info->shm_map_size;
+    		while (info->n_segments > 1 && static_allocator().truncate(
+    			info->segment_ends[info->n_segments - 2]))
+    		{
+    			info->shm_map_size = info->segment_ends[--(info->n_segments) - 1];
+    		}
+    		if ((n_released = old_size - info->shm_map_size) != 0) {
+    			resize_object(info->shm_map_offset + info->shm_map_size);
+    		}
+    	} catch (...) {
+    		drop_lock();
+    		throw;
+    	}
+    	drop_lock();
+
+    	return n_released;
+    }
 
-		// Fork here
-		if (fork() == 0) {
-			pid = getpid();
-			my_vector[3] = 4;
-			my_vector[4] = 5;
-			my_vector[5] = 6;
-		} else {
-			my_vector[0] = 1;
-			my_vector[1] = 2;
-			my_vector[2] = 3;
-		}
+    // Free the pages inside free blocks of the backing allocator, in the
+    // object itself (MADV_REMOVE) and so for every process. They fault back
+    // in, zeroed, when reused. Free slots are not trimmed. Returns the number
+    // of bytes released
+    size_t trim (size_t min_bytes = 0)
+    {
+    	size_t n_trimmed;
+
+    	take_lock();
+    	try {
+    		n_trimmed = static_allocator().trim(min_bytes, MADV_REMOVE);
+    	} catch (...) {
+    		drop_lock();
+    		throw;
+    	}
+    	drop_lock();
+
+    	for (size_t i = 0; i < d_shared_map_info_p->n_heaps; ++i) {
+    		heap_t *heap = heap_at(i);
+
+    		take_lock(heap);
+    		try {
+    			drain(heap);
+    			n_trimmed += heap_allocator(heap).trim(min_bytes, MADV_REMOVE);
+    		} catch (...) {
+    			drop_lock(heap);
+    			throw;
+    		}
+    		drop_lock(heap);
+    	}
+
+    	return n_trimmed;
+    }
+
+    // Consistent snapshot of the statistics (lock-free, from any process)
+    shared_map_stats_t stats () const
+    {
+    	shared_map_stats_t snapshot;
+
+    	snapshot.backing = static_allocator().stats();
+    	snapshot.n_slot_allocations =
+    		d_shared_map_info_p->n_slot_allocations.load(std::memory_order_relaxed);
+    	snapshot.n_slot_deallocations =
+    		d_shared_map_info_p->n_slot_deallocations.load(std::memory_order_relaxed);
+    	snapshot.n_slot_failed =
+    		d_shared_map_info_p->n_slot_failed.load(std::memory_order_relaxed);
+    	snapshot.n_remote_deallocations = 0;
+    	for (size_t i = 0; i < d_shared_map_info_p->n_heaps; ++i) {
+    		snapshot.n_remote_deallocations +=
+    			heap_at(i)->n_returned.load(std::memory_order_relaxed);
+    	}
+
+    	return snapshot;
+    }
 
-		// Both sleep for some time to allow each other to catch up
-		sleep(1);
-		// TODO: Need sync here
+    // Snapshot of the statistics of sub-heap index (lock-free)
+    allocator_stats_t heap_stats (size_t index) const
+    {
+    	// Parameter check: Index of a sub-heap
+    	if (index >= d_shared_map_info_p->n_heaps) {
+    		throw std::invalid_argument("No such sub-heap");
+    	}
+    	return heap_allocator(heap_at(index)).stats();
+    }
 
-		// Print some output
-		std::cout << "[" << pid << "] "
-	        << "Sum of vector = " << 
-		    (my_vector[0] + my_vector[1] + my_vector[2] + 
-		     my_vector[3] + my_vector[4] + my_vector[5]) << std::endl;
+    // Bytes in the largest free block of the backing allocator, walking its
+    // list under the lock (stats() only reports a bound, which this tightens)
+    size_t largest_free_block ()
+    {
+    	size_t n_bytes = 0;
+
+    	take_lock();
+    	try {
+    		n_bytes = static_allocator().largest_free_block();
+    	} catch (...) {
+    		drop_lock();
+    		throw;
+    	}
+    	drop_lock();
+
+    	return n_bytes;
+    }
 
-		// TODO: Need some kind of barrier here for deallocation control
+#if defined(ALLOCATOR_PROFILE)
+    // Sample allocations from the backing allocator and every sub-heap at
+    // an average of one per n bytes (0 to stop), see allocator_profile.cpp.
+    // Slots are carved from sampled slabs, so they count as their slab
+    void set_sample_period (size_t n_bytes)
+    {
+    	take_lock();
+    	try {
+    		static_allocator().set_sample_period(n_bytes);
+    	} catch (...) {
+    		drop_lock();
+    		throw;
+    	}
+    	drop_lock();
+
+    	for (size_t i = 0; i < d_shared_map_info_p->n_heaps; ++i) {
+    		heap_t *heap = heap_at(i);
+
+    		take_lock(heap);
+    		try {
+    			heap_allocator(heap).set_sample_period(n_bytes);
+    		} catch (...) {
+    			drop_lock(heap);
+    			throw;
+    		}
+    		drop_lock(heap);
+    	}
+    }
+#endif
+
+    // Visit the allocator maps of the shared map name without attaching to
+    // it: fn(allocator, heap) for the backing allocator (heap -1) and every
+    // sub-heap. The object is mapped read-only and no lock is taken, so the
+    // processes using the map carry on; fn sees a snapshot that may be torn
+    // (see Static_Allocator::for_each_block()), and must not allocate
+    template <class F>
+    static void inspect (char const *shared_map_name, F fn)
+    {
+    	int shm_obj_fd = -1;         // File-descriptor for shared memory file
+    	void *shm_map_ptr = nullptr; // Pointer to mapped shared memory
+    	struct stat shm_obj_stat;    // Properties of the shared memory file
+
+    	// Check: Name is appropriate length
+    	if (strnlen(shared_map_name, MAX_SHM_MAP_NAME_SIZE + 1)
+    		>= MAX_SHM_MAP_NAME_SIZE + 1)
+    	{
+    		throw std::invalid_argument("Shared map name too long");
+    	}
+
+    	if ((shm_obj_fd = shm_open(shared_map_name, O_RDONLY, 0)) == -1)
+    	{
+    		throw std::system_error(errno, std::generic_category(), "shm_open");
+    	}
+    	if (fstat(shm_obj_fd, &shm_obj_stat) == -1)
+    	{
+    		int err = errno;
+    		close(shm_obj_fd);
+    		throw std::system_error(err, std::generic_category(), "fstat");
+    	}
+
+    	// Check: Map large enough to hold the header
+    	size_t shm_obj_size = static_cast<size_t>(shm_obj_stat.st_size);
+    	if (shm_obj_size < SHARED_MAP_OFFSET)
+    	{
+    		close(shm_obj_fd);
+    		throw std::runtime_error("Shared map has no header");
+    	}
+
+    	// Map the header, then the whole reservation (segments may be added
+    	// while fn runs)
+    	if ((shm_map_ptr = mmap(nullptr, SHARED_MAP_OFFSET, PROT_READ, MAP_SHARED,
+    		shm_obj_fd, 0)) == MAP_FAILED)
+    	{
+    		int err = errno;
+    		close(shm_obj_fd);
+    		throw std::system_error(err, std::generic_category(), "mmap");
+    	}
+    	shared_map_info_t const *info = static_cast<shared_map_info_t const *>(shm_map_ptr);
+    	size_t reserved_shared_map_size = info->shm_map_reserved;
+    	char const *error = header_error(info, shm_obj_size);
+    	munmap(shm_map_ptr, SHARED_MAP_OFFSET);
+    	if (error != nullptr) {
+    		close(shm_obj_fd);
+    		throw std::runtime_error(error);
+    	}
+    	shm_map_ptr = mmap(nullptr, reserved_shared_map_size, PROT_READ, MAP_SHARED,
+    		shm_obj_fd, 0);
+    	int err = errno;
+    	close(shm_obj_fd);
+    	if (shm_map_ptr == MAP_FAILED) {
+    		throw std::system_error(err, std::generic_category(), "mmap");
+    	}
+
+    	try {
+    		uint8_t *base = static_cast<uint8_t *>(shm_map_ptr);
+    		info = reinterpret_cast<shared_map_info_t const *>(base);
+
+    		fn(Static_Allocator<uint8_t>::attach(base + info->shm_map_offset), -1);
+    		for (uint32_t i = 0; i < info->n_heaps; ++i) {
+    			fn(heap_allocator(reinterpret_cast<heap_t *>(base + info->heaps +
+    				i * info->heap_size)), static_cast<int>(i));
+    		}
+    	} catch (...) {
+    		munmap(shm_map_ptr, reserved_shared_map_size);
+    		throw;
+    	}
+    	munmap(shm_map_ptr, reserved_shared_map_size);
     }
 
-	// Memory check
-	std::cout << "[" << getpid() << "] " <<
-	    "Bytes (allocated = " << my_allocator.free_size() << ")" << std::endl;
-	std::cout << "[" << getpid() << "] " <<
-	    "Unified = " << my_allocator.unified() << std::endl;
+	shared_map_info_t *shared_map_info_p () const
+	{
+		return this->d_shared_map_info_p.get();
+	}
 
-	return 0;
-}
+	Static_Allocator<T> static_allocator () const
+	{
+		return Static_Allocator<T>::attach(reinterpret_cast<uint8_t *>(
+			d_shared_map_info_p.get()) + d_shared_map_info_p->shm_map_offset);
+	}
+};
 
-#endif
\ No newline at end of file
+#endif
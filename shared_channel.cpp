@@ -0,0 +1,302 @@
+#if !defined(SHARED_CHANNEL_H)
+#define SHARED_CHANNEL_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Zero-copy message channel between processes, constructed inside a shared m *
+ *  ap next to the messages it carries (e.g. with Shared_Allocator::construct( *
+ *  ), so that unrelated processes find it by name). A producer constructs a m *
+ *  essage in the map (see emplace()), and publishes it by pushing its offset, *
+ *  relative to the channel, into a lock-free MPMC_Queue; the consumer reads t *
+ *  he message in place and frees it with release(). No bytes of a message are *
+ *  copied, and as offsets are self-relative the map may be attached at a diff *
+ *  erent address in every process.                                            *
+ *                                                                             *
+ *  Waiting is done on shared futexes, with a short spin first. A sleeper regi *
+ *  sters itself before its final check, so that the other side only makes a s *
+ *  ystem call when someone actually sleeps: an uncontended send or receive is *
+ *  a handful of atomics. send_bulk() and receive_bulk() publish or take many  *
+ *  messages under a single notification. eventfd is not used, as its descript *
+ *  or cannot be shared through the map with unrelated processes.              *
+ *                                                                             *
+ *  close() wakes all waiters: receive() then drains the remaining messages be *
+ *  fore returning nullptr, and send() throws.                                 *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+// C++ libraries
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <climits>
+
+// Custom headers
+#include "shared_sync.cpp"
+
+
+// Attempts to send or receive made before going to sleep (on multiple CPUs)
+#define SHARED_CHANNEL_SPIN          256
+
+
+template <class T, size_t N = 1024>
+class Shared_Channel
+{
+private:
+
+	// Structure: Futex waited on by one side of the channel (consumers for
+	// messages, producers for room), bumped by the other whenever it sleeps
+	typedef struct event_t {
+		alignas(SHARED_SYNC_CACHE_LINE) std::atomic<uint32_t> seq;
+		std::atomic<uint32_t> n_waiting;
+	} event_t;
+
+	// Offsets of published messages, relative to the channel
+	MPMC_Queue<intptr_t, N> d_ring;
+
+	// Events: Messages published, room made
+	event_t d_filled;
+	event_t d_drained;
+
+	// Whether close() was called
+	alignas(SHARED_SYNC_CACHE_LINE) std::atomic<bool> d_closed;
+
+
+	// Inline method: Wake up to n_waiters sleeping on event, if any sleep
+	// (the fence orders the preceding push or pop before the check)
+	static inline void notify (event_t &event, int n_waiters)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (event.n_waiting.load(std::memory_order_relaxed) != 0) {
+			event.seq.fetch_add(1, std::memory_order_release);
+			futex_wake(&(event.seq), n_waiters);
+		}
+	}
+
+	// Retry attempt until it succeeds, spinning first (unless on a single
+	// CPU, where the other side cannot run meanwhile) and then sleeping on
+	// event. A sleeper counts itself before its last attempt, so an update
+	// made after that attempt always finds it
+	template <class Attempt>
+	static void wait_for (event_t &event, Attempt attempt)
+	{
+		static size_t const n_spins =
+			(sysconf(_SC_NPROCESSORS_ONLN) > 1) ? SHARED_CHANNEL_SPIN : 0;
+
+		for (size_t i = 0; i < n_spins; ++i) {
+			if (attempt()) {
+				return;
+			}
+		}
+
+		for (;;) {
+			event.n_waiting.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			uint32_t seq = event.seq.load(std::memory_order_acquire);
+			bool done = attempt();
+			if (!done) {
+				futex_wait(&(event.seq), seq);
+			}
+			event.n_waiting.fetch_sub(1, std::memory_order_relaxed);
+			if (done || attempt()) {
+				return;
+			}
+		}
+	}
+
+	// Inline method: Offset of msg relative to the channel
+	inline intptr_t offset_of (T const *msg) const
+	{
+		return reinterpret_cast<uint8_t const *>(msg) -
+			reinterpret_cast<uint8_t const *>(this);
+	}
+
+	// Inline method: Message at offset relative to the channel
+	inline T *message_at (intptr_t offset) const
+	{
+		return reinterpret_cast<T *>(const_cast<uint8_t *>(
+			reinterpret_cast<uint8_t const *>(this)) + offset);
+	}
+
+public:
+
+	Shared_Channel ():
+		d_closed(false)
+	{
+		new (&(d_filled.seq)) std::atomic<uint32_t>(0);
+		new (&(d_filled.n_waiting)) std::atomic<uint32_t>(0);
+		new (&(d_drained.seq)) std::atomic<uint32_t>(0);
+		new (&(d_drained.n_waiting)) std::atomic<uint32_t>(0);
+	}
+
+	Shared_Channel (const Shared_Channel &) = delete;
+	Shared_Channel &operator= (const Shared_Channel &) = delete;
+
+	// Construct a message with allocator (of the map holding the channel)
+	// and send it. Throws std::bad_alloc when the map is exhausted
+	template <class Allocator, class... Args>
+	T *emplace (Allocator &allocator, Args&&... args)
+	{
+		T *msg = allocator.template new_object<T>(std::forward<Args>(args)...);
+
+		try {
+			send(msg);
+		} catch (...) {
+			allocator.delete_object(msg);
+			throw;
+		}
+		return msg;
+	}
+
+	// Destroy a received message (in any process attached to the map)
+	template <class Allocator>
+	static void release (Allocator &allocator, T *msg)
+	{
+		allocator.delete_object(msg);
+	}
+
+	// Publish msg, which must be in the same map as the channel. Returns
+	// false if the channel is full or closed
+	bool try_send (T *msg)
+	{
+		// Parameter check: Message
+		if (msg == nullptr) {
+			throw std::invalid_argument("Cannot send nullptr!");
+		}
+
+		if (d_closed.load(std::memory_order_acquire) || !d_ring.try_push(offset_of(msg))) {
+			return false;
+		}
+		notify(d_filled, 1);
+		return true;
+	}
+
+	// Publish msg, waiting while the channel is full. Throws
+	// std::runtime_error if the channel is closed
+	void send (T *msg)
+	{
+		bool sent = false;
+
+		wait_for(d_drained, [&] {
+			return (sent = try_send(msg)) || d_closed.load(std::memory_order_acquire);
+		});
+		if (!sent) {
+			throw std::runtime_error("Shared channel is closed");
+		}
+	}
+
+	// Publish count messages, waiting while the channel is full, with one
+	// notification per batch that fits. Throws std::runtime_error if the
+	// channel is closed (the messages from the first unsent one are the
+	// caller's)
+	void send_bulk (T *const *msgs, size_t count)
+	{
+		size_t n_sent = 0;
+
+		while (n_sent < count) {
+			size_t n_batch = 0;
+
+			wait_for(d_drained, [&] {
+				if (d_closed.load(std::memory_order_acquire)) {
+					return true;
+				}
+				while (n_sent + n_batch < count &&
+					d_ring.try_push(offset_of(msgs[n_sent + n_batch]))) {
+					n_batch++;
+				}
+				return n_batch != 0;
+			});
+			if (n_batch == 0) {
+				throw std::runtime_error("Shared channel is closed");
+			}
+			n_sent += n_batch;
+			notify(d_filled, static_cast<int>(std::min<size_t>(n_batch, INT_MAX)));
+		}
+	}
+
+	// Take the oldest message. Returns nullptr if there is none
+	T *try_receive ()
+	{
+		intptr_t offset;
+
+		if (!d_ring.try_pop(offset)) {
+			return nullptr;
+		}
+		notify(d_drained, 1);
+		return message_at(offset);
+	}
+
+	// Take the oldest message, waiting while there is none. Returns nullptr
+	// once the channel is closed and empty
+	T *receive ()
+	{
+		T *msg = nullptr;
+
+		wait_for(d_filled, [&] {
+			return (msg = try_receive()) != nullptr ||
+				d_closed.load(std::memory_order_acquire);
+		});
+		return (msg != nullptr) ? msg : try_receive();
+	}
+
+	// Take up to max_count messages into out, waiting while there is none,
+	// with one notification for the batch. Returns the number taken (0 once
+	// the channel is closed and empty)
+	size_t receive_bulk (T **out, size_t max_count)
+	{
+		size_t n_received = 0;
+		intptr_t offset;
+
+		if (max_count == 0) {
+			return 0;
+		}
+
+		wait_for(d_filled, [&] {
+			while (n_received < max_count && d_ring.try_pop(offset)) {
+				out[n_received++] = message_at(offset);
+			}
+			return n_received != 0 || d_closed.load(std::memory_order_acquire);
+		});
+		while (n_received < max_count && d_ring.try_pop(offset)) {
+			out[n_received++] = message_at(offset);
+		}
+		if (n_received != 0) {
+			notify(d_drained, static_cast<int>(std::min<size_t>(n_received, INT_MAX)));
+		}
+		return n_received;
+	}
+
+	// Refuse further messages and wake all waiters. Messages already
+	// published are still received
+	void close ()
+	{
+		d_closed.store(true, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		d_filled.seq.fetch_add(1, std::memory_order_release);
+		futex_wake(&(d_filled.seq), INT_MAX);
+		d_drained.seq.fetch_add(1, std::memory_order_release);
+		futex_wake(&(d_drained.seq), INT_MAX);
+	}
+
+	// Whether close() was called
+	bool closed () const
+	{
+		return d_closed.load(std::memory_order_acquire);
+	}
+
+	// Number of messages published and not yet received (a snapshot)
+	size_t size () const
+	{
+		return d_ring.size();
+	}
+};
+
+#endif
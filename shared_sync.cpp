@@ -0,0 +1,396 @@
+#if !defined(SHARED_SYNC_H)
+#define SHARED_SYNC_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Process-shared synchronisation primitives, meant to be constructed inside  *
+ *  a shared map (see Shared_Allocator::new_object()). Every primitive consist *
+ *  s of lock-free atomics only, holds no pointers, and may therefore be mappe *
+ *  d at a different address in every process.                                 *
+ *                                                                             *
+ *  The mutex, condition variable and barrier are built on futexes: they stay  *
+ *  in user space while uncontended and only enter the kernel to sleep or to w *
+ *  ake a sleeper. Shared (not FUTEX_PRIVATE_FLAG) futexes are used, as waiter *
+ *  s live in different processes.                                             *
+ *                                                                             *
+ *  The queues are bounded lock-free ring buffers of trivially copyable elemen *
+ *  ts: SPSC_Queue for one producer and one consumer, MPMC_Queue (after Dmitry *
+ *  Vyukov) for any number of each. Neither ever makes a system call; try_push *
+ *  () and try_pop() return false when the queue is full or empty.             *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+// C++ libraries
+#include <atomic>
+#include <system_error>
+#include <stdexcept>
+#include <type_traits>
+#include <new>
+
+// C libraries
+extern "C" {
+	#include <errno.h>
+	#include <unistd.h>
+	#include <limits.h>
+	#include <sys/syscall.h>
+	#include <linux/futex.h>
+}
+
+
+// Assumed cache-line size, separating indices written by different processes
+#define SHARED_SYNC_CACHE_LINE       64
+
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+	std::atomic<uint32_t>::is_always_lock_free,
+	"Futex words must be plain lock-free 32-bit atomics");
+
+
+// Sleep while *word holds expected (returns at once if it does not)
+static inline void futex_wait (std::atomic<uint32_t> *word, uint32_t expected)
+{
+	if (syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT,
+		expected, nullptr, nullptr, 0) == -1 && errno != EAGAIN && errno != EINTR)
+	{
+		throw std::system_error(errno, std::generic_category(), "futex_wait");
+	}
+}
+
+// Wake up to n_waiters sleeping on word
+static inline void futex_wake (std::atomic<uint32_t> *word, int n_waiters)
+{
+	if (syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE,
+		n_waiters, nullptr, nullptr, 0) == -1)
+	{
+		throw std::system_error(errno, std::generic_category(), "futex_wake");
+	}
+}
+
+
+// Mutex: Three states (0 = unlocked, 1 = locked, 2 = locked with sleepers),
+// so unlocking only makes a system call when someone may be asleep
+class Shared_Mutex
+{
+private:
+
+	std::atomic<uint32_t> d_state;
+
+	// Friend: Waiters relock in the contended state
+	friend class Shared_Condition;
+
+	// Take the lock, marking it contended (the caller may have had sleepers)
+	void lock_contended ()
+	{
+		while (d_state.exchange(2, std::memory_order_acquire) != 0) {
+			futex_wait(&d_state, 2);
+		}
+	}
+
+public:
+
+	Shared_Mutex ():
+		d_state(0)
+	{
+		// Nothing to do
+	}
+
+	Shared_Mutex (const Shared_Mutex &) = delete;
+	Shared_Mutex &operator= (const Shared_Mutex &) = delete;
+
+	// Take the lock, sleeping while it is held elsewhere
+	void lock ()
+	{
+		uint32_t expected = 0;
+
+		// Case: Uncontended
+		if (d_state.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+			return;
+		}
+		lock_contended();
+	}
+
+	// Take the lock if it is free
+	bool try_lock ()
+	{
+		uint32_t expected = 0;
+		return d_state.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+	}
+
+	// Release the lock, waking one sleeper if there may be any
+	void unlock ()
+	{
+		if (d_state.exchange(0, std::memory_order_release) == 2) {
+			futex_wake(&d_state, 1);
+		}
+	}
+};
+
+
+// Condition variable: Waiters sleep on a sequence number bumped by every
+// notification, so a notification between unlocking and sleeping is not lost
+class Shared_Condition
+{
+private:
+
+	std::atomic<uint32_t> d_seq;
+
+public:
+
+	Shared_Condition ():
+		d_seq(0)
+	{
+		// Nothing to do
+	}
+
+	Shared_Condition (const Shared_Condition &) = delete;
+	Shared_Condition &operator= (const Shared_Condition &) = delete;
+
+	// Release the (held) mutex, sleep until notified, and retake the mutex.
+	// Wake-ups may be spurious, so callers recheck their predicate
+	void wait (Shared_Mutex &mutex)
+	{
+		uint32_t seq = d_seq.load(std::memory_order_relaxed);
+
+		mutex.unlock();
+		futex_wait(&d_seq, seq);
+		mutex.lock_contended();
+	}
+
+	// Wait until pred() holds (checked with the mutex held)
+	template <class Predicate>
+	void wait (Shared_Mutex &mutex, Predicate pred)
+	{
+		while (!pred()) {
+			wait(mutex);
+		}
+	}
+
+	// Wake one waiter
+	void notify_one ()
+	{
+		d_seq.fetch_add(1, std::memory_order_relaxed);
+		futex_wake(&d_seq, 1);
+	}
+
+	// Wake all waiters
+	void notify_all ()
+	{
+		d_seq.fetch_add(1, std::memory_order_relaxed);
+		futex_wake(&d_seq, INT_MAX);
+	}
+};
+
+
+// Barrier: Reusable; the last of n_parties to arrive starts a new generation
+// and wakes the others
+class Shared_Barrier
+{
+private:
+
+	uint32_t const d_n_parties;
+	std::atomic<uint32_t> d_n_waiting;
+	std::atomic<uint32_t> d_generation;
+
+public:
+
+	explicit Shared_Barrier (uint32_t n_parties):
+		d_n_parties(n_parties), d_n_waiting(0), d_generation(0)
+	{
+		// Parameter check: At least one party
+		if (n_parties == 0) {
+			throw std::invalid_argument("Barrier needs at least one party");
+		}
+	}
+
+	Shared_Barrier (const Shared_Barrier &) = delete;
+	Shared_Barrier &operator= (const Shared_Barrier &) = delete;
+
+	// Wait for all parties. Returns true in exactly one of them (the last)
+	bool arrive_and_wait ()
+	{
+		uint32_t generation = d_generation.load(std::memory_order_acquire);
+
+		// Case: Last to arrive, release the others
+		if (d_n_waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == d_n_parties) {
+			d_n_waiting.store(0, std::memory_order_relaxed);
+			d_generation.fetch_add(1, std::memory_order_release);
+			futex_wake(&d_generation, INT_MAX);
+			return true;
+		}
+
+		while (d_generation.load(std::memory_order_acquire) == generation) {
+			futex_wait(&d_generation, generation);
+		}
+		return false;
+	}
+};
+
+
+// Queue: Single producer, single consumer. Each side owns one index and only
+// reads the other's, so no read-modify-write is needed
+template <class T, size_t N>
+class SPSC_Queue
+{
+private:
+
+	static_assert(N > 0 && (N & (N - 1)) == 0, "Capacity must be a power of two");
+	static_assert(std::is_trivially_copyable<T>::value,
+		"Elements are copied between processes byte-wise");
+
+	alignas(SHARED_SYNC_CACHE_LINE) std::atomic<size_t> d_head;  // Next to pop
+	alignas(SHARED_SYNC_CACHE_LINE) std::atomic<size_t> d_tail;  // Next to push
+	alignas(SHARED_SYNC_CACHE_LINE) T d_cells[N];
+
+public:
+
+	SPSC_Queue ():
+		d_head(0), d_tail(0)
+	{
+		// Nothing to do
+	}
+
+	SPSC_Queue (const SPSC_Queue &) = delete;
+	SPSC_Queue &operator= (const SPSC_Queue &) = delete;
+
+	// Append an element (producer only). Returns false if full
+	bool try_push (T const &value)
+	{
+		size_t tail = d_tail.load(std::memory_order_relaxed);
+
+		if (tail - d_head.load(std::memory_order_acquire) == N) {
+			return false;
+		}
+		d_cells[tail & (N - 1)] = value;
+		d_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Remove the oldest element (consumer only). Returns false if empty
+	bool try_pop (T &value)
+	{
+		size_t head = d_head.load(std::memory_order_relaxed);
+
+		if (head == d_tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = d_cells[head & (N - 1)];
+		d_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Number of elements (a snapshot when called concurrently)
+	size_t size () const
+	{
+		return d_tail.load(std::memory_order_acquire) -
+			d_head.load(std::memory_order_acquire);
+	}
+};
+
+
+// Queue: Multiple producers, multiple consumers. Every cell carries a sequence
+// number telling whether it is ready for the push or the pop of a given lap,
+// so producers and consumers only contend on their own index
+template <class T, size_t N>
+class MPMC_Queue
+{
+private:
+
+	static_assert(N > 1 && (N & (N - 1)) == 0, "Capacity must be a power of two");
+	static_assert(std::is_trivially_copyable<T>::value,
+		"Elements are copied between processes byte-wise");
+
+	// Structure: Slot of the ring
+	typedef struct cell_t {
+		std::atomic<size_t> seq;  // Position it can be pushed (== pos) or popped (== pos + 1) at
+		T value;
+	} cell_t;
+
+	alignas(SHARED_SYNC_CACHE_LINE) std::atomic<size_t> d_head;  // Next to pop
+	alignas(SHARED_SYNC_CACHE_LINE) std::atomic<size_t> d_tail;  // Next to push
+	alignas(SHARED_SYNC_CACHE_LINE) cell_t d_cells[N];
+
+public:
+
+	MPMC_Queue ():
+		d_head(0), d_tail(0)
+	{
+		for (size_t i = 0; i < N; ++i) {
+			new (&(d_cells[i].seq)) std::atomic<size_t>(i);
+		}
+	}
+
+	MPMC_Queue (const MPMC_Queue &) = delete;
+	MPMC_Queue &operator= (const MPMC_Queue &) = delete;
+
+	// Append an element. Returns false if full
+	bool try_push (T const &value)
+	{
+		size_t pos = d_tail.load(std::memory_order_relaxed);
+
+		for (;;) {
+			cell_t &cell = d_cells[pos & (N - 1)];
+			size_t seq = cell.seq.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+			// Case: Cell free for this lap, claim it
+			if (diff == 0) {
+				if (d_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = value;
+					cell.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+			// Case: Cell still holds the previous lap's element
+				return false;
+			} else {
+			// Case: Another producer claimed it, retry at the new tail
+				pos = d_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Remove the oldest element. Returns false if empty
+	bool try_pop (T &value)
+	{
+		size_t pos = d_head.load(std::memory_order_relaxed);
+
+		for (;;) {
+			cell_t &cell = d_cells[pos & (N - 1)];
+			size_t seq = cell.seq.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+			// Case: Cell filled for this lap, claim it
+			if (diff == 0) {
+				if (d_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					value = cell.value;
+					cell.seq.store(pos + N, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+			// Case: Cell not yet filled
+				return false;
+			} else {
+			// Case: Another consumer claimed it, retry at the new head
+				pos = d_head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Number of elements (a snapshot when called concurrently)
+	size_t size () const
+	{
+		size_t tail = d_tail.load(std::memory_order_acquire);
+		size_t head = d_head.load(std::memory_order_acquire);
+		return (tail > head) ? tail - head : 0;
+	}
+};
+
+#endif
@@ -16,13 +16,67 @@
  *  tion of the class's lifetime.                                              *
  *                                                                             *
  *  The copy constructor and move assignment                                   *
- *  operator both simply copy the pointer to the static memory block. The dest *
+ *  operator both simply copy the pointer to the static memory block, and two  *
+ *  allocators compare equal if they share a block. Containers propagate the a *
+ *  llocator on copy, move and swap, so moving a container is O(1). The dest   *
  *  ructor has no effect. It is assumed that the user will ensure atomic acces *
  *  s to the memory if memory allocation or destruction operations are perform *
  *  ed between threads or processes.                                           *
  *                                                                             *
- *  This allocator uses a single pool of variable memory blocks, with a        *
- *  first-fit allocation scheme                                                *
+ *  This allocator uses a single pool of variable memory blocks. The placement *
+ *  policy is a template parameter: Next_Fit (the default) resumes the search  *
+ *  where the previous one ended, First_Fit always searches from the head of t *
+ *  he list, and Best_Fit takes the smallest block that fits. Segregated_Fit a *
+ *  lso files every free block in two-level size-class bins (as in TLSF) kept  *
+ *  in the map, and takes one from the smallest non-empty class that fits, so  *
+ *  allocation takes constant time however fragmented the map. Free blocks car *
+ *  ry boundary tags (a footer and a back link), so deallocation coalesces wit *
+ *  h both neighbours in constant time instead of walking an address-ordered l *
+ *  ist.                                                                       *
+ *                                                                             *
+ *  Metadata within the map holds offsets from the start of the map rather tha *
+ *  n pointers, so a map may be attached at a different address in every proc *
+ *  ess (see attach()).                                                        *
+ *                                                                             *
+ *  Usage counters (see stats()) are kept in the map under a sequence lock, so *
+ *  any thread or process can read a consistent snapshot without walking the f *
+ *  ree list or taking the lock that serialises allocation. The largest free b *
+ *  lock is kept there as an upper bound, as allocation never walks the list t *
+ *  o find the next largest; largest_free_block() walks it to make the bound e *
+ *  xact.                                                                      *
+ *                                                                             *
+ *  Optionally (see set_deferred_coalescing()), small freed blocks are not mer *
+ *  ged but kept in quick lists, one per size, from which requests of the same *
+ *  size are served without a search. Quick-listed blocks are merged back in b *
+ *  ounded passes once the lists grow long, and all at once when a search fail *
+ *  s (see consolidate()).                                                     *
+ *                                                                             *
+ *  Free pages may be handed back to the operating system with trim(), which a *
+ *  dvises away the page-aligned interior of every free block while its bounda *
+ *  ry tags stay resident, so resident memory follows the working set rather t *
+ *  han the peak.                                                              *
+ *                                                                             *
+ *  For debugging, the Checked<Policy> policy wraps any placement policy: allo *
+ *  cated blocks then carry a magic number and a tail canary, checked (with th *
+ *  e size passed) whenever a block is freed or resized, and freed blocks are  *
+ *  poisoned, so double frees, wrong sizes and overruns throw instead of corru *
+ *  pting the free list. validate() checks the whole map in any mode. The unch *
+ *  ecked policies compile none of this in.                                    *
+ *                                                                             *
+ *  When built with AddressSanitizer (or with ALLOCATOR_VALGRIND under Memchec *
+ *  k), the allocator annotates its map (see allocator_annotate.cpp): free spa *
+ *  ce and the slack behind each allocation are poisoned, so use after free an *
+ *  d overflows within a block are reported, while the boundary tags stay acce *
+ *  ssible. set_annotations() turns this off for a map. The poison stays on th *
+ *  e storage until unannotate() is called, which the owner of the storage mus *
+ *  t do before reusing, unmapping or leaving it (a map in a local buffer woul *
+ *  d poison the stack).                                                       *
+ *                                                                             *
+ *  When built with ALLOCATOR_PROFILE, set_sample_period() samples allocations *
+ *  into a table in the map (see allocator_profile.cpp), with the call stack o *
+ *  f each, so that any process can tell which sites hold the space. for_each_ *
+ *  block() walks the blocks without writing to the map, e.g. for a heap dump  *
+ *  from another process.                                                      *
  *                                                                             *
  *******************************************************************************
 */
@@ -30,8 +84,127 @@
 
 #include <iostream>
 #include <vector>
+#include <atomic>
+#include <algorithm>
+#include <system_error>
+#include <cstring>
+
+// C libraries
+extern "C" {
+    #include <errno.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+}
+
+// Custom headers
+#include "allocator_trace.cpp"
+#include "allocator_annotate.cpp"
+#include "allocator_profile.cpp"
+
+
+// Buckets of the search-length histogram (bucket i counts searches that
+// visited up to 2^i free blocks, the last bucket counts all longer ones)
+#define ALLOCATOR_SEARCH_BUCKETS     8
+
+// Quick lists kept in deferred-coalescing mode (list i holds freed blocks of
+// MIN_BLOCK_UNITS + i units, i.e. requests of up to 32 * (i + 1) bytes)
+#define ALLOCATOR_QUICK_LISTS        8
+
+// Quick-listed blocks beyond which each deallocation runs a bounded pass
+#define ALLOCATOR_QUICK_LIMIT        64
+
+// Quick-listed blocks merged by each bounded pass
+#define ALLOCATOR_QUICK_BATCH        8
+
+// Build options changing the layout of allocator_info_t (ALLOCATOR_TRACE,
+// ALLOCATOR_PROFILE), recorded by maps that outlive a process so that one
+// built otherwise does not misread them
+#if defined(ALLOCATOR_TRACE)
+#define ALLOCATOR_FEATURE_TRACE      1
+#else
+#define ALLOCATOR_FEATURE_TRACE      0
+#endif
+#if defined(ALLOCATOR_PROFILE)
+#define ALLOCATOR_FEATURE_PROFILE    2
+#else
+#define ALLOCATOR_FEATURE_PROFILE    0
+#endif
+#define ALLOCATOR_FEATURES           (ALLOCATOR_FEATURE_TRACE | ALLOCATOR_FEATURE_PROFILE)
+
+
+// Structure: Snapshot of allocator statistics
+typedef struct allocator_stats_t {
+    size_t n_allocations;        // Successful allocations
+    size_t n_deallocations;      // Deallocations
+    size_t n_failed;             // Allocations that returned NULL
+    size_t used_bytes;           // Bytes in use (block headers included)
+    size_t peak_used_bytes;      // Highest value of used_bytes
+    size_t largest_free_block;   // Bound on bytes in the largest free block (see largest_free_block())
+    size_t n_free_blocks;        // Blocks on the free list
+    size_t n_quick_blocks;       // Freed blocks waiting in quick lists
+    size_t search_length[ALLOCATOR_SEARCH_BUCKETS]; // Histogram of blocks visited
+} allocator_stats_t;
+
+// Enumeration: State of a block visited by for_each_block()
+typedef enum {
+    BLOCK_USED,                  // Allocated
+    BLOCK_FREE,                  // On the free list
+    BLOCK_QUICK                  // Freed, waiting in a quick list
+} block_state_t;
+
+// Structure: Result of allocate_at_least (std::allocation_result in C++23)
+template <class Pointer>
+struct allocation_result_t {
+    Pointer ptr;                 // Allocated objects
+    size_t count;                // Number of objects that fit (at least requested)
+};
+
+// Placement policies: Selected at compile time (see Static_Allocator::find_fit)
+
+// Policy: Take the first block that fits, resuming where the last search ended
+struct Next_Fit {
+    static constexpr bool roving = true;     // Search starts at the roving pointer
+    static constexpr bool best_fit = false;  // Search stops at the first fit
+    static constexpr bool checked = false;   // Blocks carry no magic or canary
+    static constexpr bool segregated = false; // Search walks the free list
+};
+
+// Policy: Take the first block that fits, searching from the head of the list
+struct First_Fit {
+    static constexpr bool roving = false;
+    static constexpr bool best_fit = false;
+    static constexpr bool checked = false;
+    static constexpr bool segregated = false;
+};
+
+// Policy: Take the smallest block that fits (the whole list is searched,
+// unless a block fits so tightly that no remainder would be split off)
+struct Best_Fit {
+    static constexpr bool roving = false;
+    static constexpr bool best_fit = true;
+    static constexpr bool checked = false;
+    static constexpr bool segregated = false;
+};
+
+// Policy: Take a block from the smallest non-empty size class that fits,
+// found in constant time however fragmented the map (free blocks are also
+// filed in size-class bins, see Static_Allocator::find_bin)
+struct Segregated_Fit {
+    static constexpr bool roving = false;
+    static constexpr bool best_fit = false;
+    static constexpr bool checked = false;
+    static constexpr bool segregated = true;
+};
+
+// Policy: Placement of Base, with every block checked when it is freed or
+// resized (header magic, size and tail canary) and poisoned once free
+template <class Base>
+struct Checked: Base {
+    static constexpr bool checked = true;
+};
+
 
-template <class T>
+template <class T, class Policy = Next_Fit>
 class Static_Allocator
 {
 private:
@@ -39,337 +212,2441 @@ private:
     // Structure: Allocator header block
     typedef union block_h {
         struct {
-            union block_h *next;     // Next element in the linked-list
+            size_t next;             // Offset of next element in the linked-list
             size_t size;             // Size rounded to units of sizeof(block_h)
         } d;
         max_align_t align;           // Memory alignment element
     } block_h;
 
-    // Structure: Allocator information
-    typedef struct allocator_info_t {
-        void *static_memory_map;     // Pointer to memory map
-        void *free_memory_map;       // Pointer to free memory map
+    // Structure: Counters installed in the map. Updated by the (serialised)
+    // allocator under a sequence lock so other threads and processes can
+    // take consistent snapshots without holding the allocator's lock
+    typedef struct stats_counters_t {
+        std::atomic<size_t> seq;     // Odd while an update is in progress
+        std::atomic<size_t> n_allocations;
+        std::atomic<size_t> n_deallocations;
+        std::atomic<size_t> n_failed;
+        std::atomic<size_t> used_bytes;
+        std::atomic<size_t> peak_used_bytes;
+        std::atomic<size_t> largest_free_block;
+        std::atomic<size_t> n_free_blocks;
+        std::atomic<size_t> n_quick_blocks;
+        std::atomic<size_t> search_length[ALLOCATOR_SEARCH_BUCKETS];
+    } stats_counters_t;
+
+    // Segregated policy: Size classes in two levels, as in TLSF. The first
+    // level is the position of the highest bit of a block's size in units,
+    // the second the SEGREGATED_SL_LOG2 bits below it (sizes under
+    // SEGREGATED_SL_COUNT units are classed exactly)
+    static constexpr size_t SEGREGATED_SL_LOG2 = 4;
+    static constexpr size_t SEGREGATED_SL_COUNT = 1 << SEGREGATED_SL_LOG2;
+    static constexpr size_t SEGREGATED_FL_COUNT = 32;
+
+    // Segregated policy: Largest size of a block (units) with a size class
+    static constexpr size_t SEGREGATED_MAX_UNITS = (static_cast<size_t>(1) <<
+        (SEGREGATED_FL_COUNT + SEGREGATED_SL_LOG2 - 1)) - 1;
+
+    // Structure: Size-class bins of the segregated policy
+    typedef struct segregated_bins_t {
+        size_t bins[SEGREGATED_FL_COUNT][SEGREGATED_SL_COUNT]; // Offsets of bin heads (0 if empty)
+        uint16_t sl_bitmap[SEGREGATED_FL_COUNT]; // Non-empty bins of each first level
+        uint32_t fl_bitmap;          // First levels with a non-empty bin
+    } segregated_bins_t;
+
+    // Structure: No bins (other policies)
+    typedef struct no_bins_t {
+    } no_bins_t;
+
+    // Structure: Allocator information (installed at the start of the map).
+    // The segregated policy's bins come first, other policies add nothing
+    typedef struct allocator_info_t: std::conditional<Policy::segregated,
+        segregated_bins_t, no_bins_t>::type {
+        size_t free_memory_map;      // Offset of free memory map
         size_t capacity;             // Capacity of memory map
         size_t free_size;            // Number of bytes available
-        block_h *free_list;          // Linked list of memory blocks
+        size_t free_list;            // Offset of linked list of memory blocks
+        size_t quick_lists[ALLOCATOR_QUICK_LISTS]; // Offsets of quick-list heads (0 if empty)
+        size_t n_quick;              // Blocks held in quick lists
+        size_t quick_next;           // Quick list the next bounded pass starts at
+        bool deferred;               // Whether freed blocks are quick-listed
+        bool annotated;              // Whether blocks are annotated (see allocator_annotate.cpp)
+        stats_counters_t stats;      // Counters behind stats()
+#if defined(ALLOCATOR_TRACE)
+        trace_ring_t trace;          // Recent allocator events
+#endif
+#if defined(ALLOCATOR_PROFILE)
+        size_t profile;              // Offset of the profile table (0 = none)
+#endif
     } allocator_info_t;
 
-    // Pointer to Allocator information (nested within memory block)
-    allocator_info_t *d_allocator_info_p;
+    // Smallest free block: a header plus the unit holding the back link (and
+    // under the segregated policy the next one, for the bin links)
+    static constexpr size_t MIN_BLOCK_UNITS = Policy::segregated ? 3 : 2;
 
-public:
+    // Units past the header of a free block holding links, kept accessible
+    static constexpr size_t LINK_UNITS = MIN_BLOCK_UNITS - 1;
 
-    // Alias: Value types
-    using value_type         = T;
+    // Flag: Set in block_h::d.size while the block is free
+    static constexpr size_t FLAG_FREE = ~(~static_cast<size_t>(0) >> 1);
 
-	// Alias: Pointer as pointer to value type
-	using pointer            = T *;
+    // Flag: Set in block_h::d.size while the physically preceding block is free
+    static constexpr size_t FLAG_PREV_FREE = FLAG_FREE >> 1;
 
-	// Alias: Pointer to const
-	using const_pointer      = T const *;
+    // Flag: Set in block_h::d.size while the block is held in a quick list
+    static constexpr size_t FLAG_QUICK = FLAG_PREV_FREE >> 1;
 
-	// Alias: Most general pointer
-	using void_pointer       = void *;
+    // Mask: Bits of block_h::d.size holding the size
+    static constexpr size_t SIZE_MASK = FLAG_QUICK - 1;
 
-	// Alias: Most general pointer (to const)
-	using const_void_pointer = const void *;
+    // Metadata rounded up so that blocks remain aligned
+    static constexpr size_t INFO_SIZE = (sizeof(allocator_info_t) + sizeof(block_h) - 1)
+        / sizeof(block_h) * sizeof(block_h);
 
-	// Alias: Reference
-	using reference          = T&;
+    // Checked mode: Bytes reserved past every request for the tail canary
+    static constexpr size_t CANARY_SIZE = Policy::checked ? sizeof(uint64_t) : 0;
 
-	// Alias: Constant reference
-	using const_reference    = const T&;
+    // Checked mode: Magic (xor the block offset) in the d.next field of an
+    // allocated block, which otherwise holds its owner (see set_owner())
+    static constexpr size_t BLOCK_MAGIC = 0x5354414c4c4f43;
 
-	// Alias: Allocation and deallocation size
-	using size_type          = size_t;
+    // Checked mode: Tail canary, and byte written over freed memory
+    static constexpr uint64_t CANARY = 0xcafef00dd15ea5e5;
+    static constexpr uint8_t POISON = 0xdd;
 
+    // Friend: Arenas lay their map out at compile time
+    template <size_t N, size_t Align, class P>
+    friend class Static_Arena;
 
-    // Rebinding support: Let container construct arbitrary type allocator
-    template <class U>
-    struct rebind {
-    	using other          = Static_Allocator<U>;
-    };
+    // Pointer to Allocator information (nested within memory block)
+    allocator_info_t *d_allocator_info_p;
 
-    // Operator: Move assignment
-    template <class U>
-    Static_Allocator &operator=(Static_Allocator<U> &&origin)
+
+    // Offsets: All links stored in the map are byte offsets from the start of
+    // the map (where allocator_info_t lives), so the map stays valid wherever
+    // it is attached. Offset zero is the information structure, never a block
+
+    // Inline method: Block at offset
+    inline block_h *block_at (size_t offset) const
     {
-        // Self-assign check
-        if (&origin == this) { return *this; }
+        return reinterpret_cast<block_h *>(
+            reinterpret_cast<uint8_t *>(d_allocator_info_p) + offset);
+    }
 
-        // Release held resources 
-        // None
+    // Inline method: Offset of block
+    inline size_t offset_of (block_h const *b) const
+    {
+        return reinterpret_cast<uint8_t const *>(b) -
+            reinterpret_cast<uint8_t const *>(d_allocator_info_p);
+    }
 
-        // Ownership transfer
-        this->d_allocator_info_p = 
-            reinterpret_cast<allocator_info_t *>(origin.allocator_info_p());
+    // Boundary tags: A free block keeps the free-list successor in its header,
+    // the free-list predecessor in the d.next field of the unit past the
+    // header, and its size in the d.size field of its last unit (footer). The
+    // block following a free block carries FLAG_PREV_FREE so the footer is
+    // only ever read when it is valid. Adjacent free blocks are always merged.
+    // Splits write the new header before shrinking the old block, so the
+    // headers alone chain from the list head to the fence at every store
 
-        // HINT: Copy the pointer values, and null the origin ones
-        // HINT: In a copy you just make a new and then copy contents by value
-        return *this;
+    // Inline method: Size of a block in units (flags stripped)
+    static inline size_t units_of (block_h const *b)
+    {
+        return b->d.size & SIZE_MASK;
     }
 
-    // Empty constuctor that does nothing
-    Static_Allocator ():
-        d_allocator_info_p(nullptr)
+    // Inline method: Whether block is free
+    static inline bool is_free (block_h const *b)
     {
-        // Nothing to do
+        return (b->d.size & FLAG_FREE) != 0;
     }
 
-    // Constructor
-    Static_Allocator (void *static_memory_map, size_t capacity)
+    // Inline method: Free-list predecessor (offset) of a free block
+    static inline size_t &prev_of (block_h *b)
     {
-        // Required memory: Need space for metadata and two LL block
-        size_t minimum_memory_size = sizeof(allocator_info_t) + 2 * sizeof(block_h);
+        return (b + 1)->d.next;
+    }
 
-        // Capacity check
-        if (capacity < minimum_memory_size) {
-            throw std::bad_alloc();
-        }
+    // Inline method: Write the footer of a free block
+    static inline void set_footer (block_h *b)
+    {
+        (b + units_of(b) - 1)->d.size = units_of(b);
+    }
 
-        // Struct initialization
-        d_allocator_info_p = reinterpret_cast<allocator_info_t *>(static_memory_map);
+    // Inline method: Unlink a block from the free list
+    inline void unlink (block_h *b)
+    {
+        unfile_block(b);
+        block_at(prev_of(b))->d.next = b->d.next;
+        prev_of(block_at(b->d.next)) = prev_of(b);
+    }
 
-        // Set memory map pointer
-        d_allocator_info_p->static_memory_map = static_memory_map;
+    // Inline method: Link block b into the free list after block p
+    inline void link_after (block_h *p, block_h *b)
+    {
+        b->d.next = p->d.next;
+        prev_of(b) = offset_of(p);
+        prev_of(block_at(p->d.next)) = offset_of(b);
+        p->d.next = offset_of(b);
+        file_block(b);
+    }
 
-        // Set the capacity
-        d_allocator_info_p->capacity = capacity;
+    // Segregated policy: Every free block is also filed in the bin of its
+    // size class, a list threaded through the d.size field of the unit past
+    // the header (next block in the bin) and the d.next field of the unit
+    // after that (offset of the word pointing at the block: the bin head or
+    // the link of its predecessor), so a block leaves its bin without its
+    // size being known. Other policies compile none of this in
 
-        // Set pointer to head of free memory map
-        d_allocator_info_p->free_memory_map = reinterpret_cast<uint8_t *>(static_memory_map)
-            + minimum_memory_size - (2 * sizeof(block_h));
+    // Inline method: Next block (offset, 0 at the end) in the bin of a free block
+    static inline size_t &bin_next_of (block_h *b)
+    {
+        return (b + 1)->d.size;
+    }
 
-        // Set the free size
-        d_allocator_info_p->free_size = capacity - minimum_memory_size;
+    // Inline method: Offset of the word pointing at a free block in its bin
+    static inline size_t &bin_link_of (block_h *b)
+    {
+        return (b + 2)->d.next;
+    }
 
-        // Set the free list
-        d_allocator_info_p->free_list = nullptr;
+    // Inline method: Word at offset
+    inline size_t &word_at (size_t offset) const
+    {
+        return *reinterpret_cast<size_t *>(
+            reinterpret_cast<uint8_t *>(d_allocator_info_p) + offset);
     }
 
-    // Copy constructor
-    Static_Allocator (const Static_Allocator &origin)
+    // Inline method: Offset of word
+    inline size_t word_offset (size_t const *w) const
     {
-        // Simply copy the static memory pointer (not protected from race conditions)
-        d_allocator_info_p = origin.allocator_info_p();
+        return reinterpret_cast<uint8_t const *>(w) -
+            reinterpret_cast<uint8_t const *>(d_allocator_info_p);
     }
 
-    // Destructor
-    ~Static_Allocator ()
+    // Inline method: Position of the highest set bit (x must be nonzero)
+    static inline size_t floor_log2 (size_t x)
     {
-        // No destructor needed: state is not saved in the class instance
+        return (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(x);
     }
 
-    // Support for allocating other types
-    template <class U>
-    Static_Allocator (const Static_Allocator<U> &other);
+    // Inline method: Size class of a block of n_units (at most SEGREGATED_MAX_UNITS)
+    static inline void size_class (size_t n_units, size_t &fl, size_t &sl)
+    {
+        if (n_units < SEGREGATED_SL_COUNT) {
+            fl = 0;
+            sl = n_units;
+        } else {
+            size_t l = floor_log2(n_units);
+            fl = l - SEGREGATED_SL_LOG2 + 1;
+            sl = (n_units >> (l - SEGREGATED_SL_LOG2)) - SEGREGATED_SL_COUNT;
+        }
+    }
 
-    // Allocate #1: General allocation
-    pointer allocate (size_type n_obj)
+    // Inline method: Empty all bins
+    inline void reset_bins ()
     {
-        std::cout << "allocate(" << n_obj << ")" << std::endl;
+        if constexpr (Policy::segregated) {
+            segregated_bins_t &s = *d_allocator_info_p;
+            std::memset(&s, 0, sizeof(segregated_bins_t));
+        }
+    }
 
-    	size_t n_bytes = (n_obj * sizeof(T));
-    	return reinterpret_cast<pointer>(this->allocate_b(n_bytes));
+    // Inline method: File free block b in the bin of its size
+    inline void file_block (block_h *b)
+    {
+        if constexpr (Policy::segregated) {
+            segregated_bins_t &s = *d_allocator_info_p;
+            size_t fl, sl;
+            size_class(units_of(b), fl, sl);
+
+            size_t &head = s.bins[fl][sl];
+            bin_next_of(b) = head;
+            bin_link_of(b) = word_offset(&head);
+            if (head != 0) {
+                bin_link_of(block_at(head)) = word_offset(&bin_next_of(b));
+            }
+            head = offset_of(b);
+            s.sl_bitmap[fl] |= static_cast<uint16_t>(1 << sl);
+            s.fl_bitmap |= static_cast<uint32_t>(1) << fl;
+        }
     }
 
-    // Allocate #2: Placement support
-    pointer allocate (size_type n_obj, const_void_pointer hint)
+    // Inline method: Take free block b out of its bin
+    inline void unfile_block (block_h *b)
     {
-    	return allocate(n_obj);
+        if constexpr (Policy::segregated) {
+            size_t next = bin_next_of(b), link = bin_link_of(b);
+            word_at(link) = next;
+            if (next != 0) {
+                bin_link_of(block_at(next)) = link;
+                return;
+            }
+
+            // Case: Last in its bin, and first (linked from the bin head, as
+            // block offsets start past the information), so the bin empties
+            if (link < INFO_SIZE) {
+                segregated_bins_t &s = *d_allocator_info_p;
+                size_t i = (link - word_offset(&(s.bins[0][0]))) / sizeof(size_t);
+                size_t fl = i / SEGREGATED_SL_COUNT, sl = i % SEGREGATED_SL_COUNT;
+                s.sl_bitmap[fl] &= static_cast<uint16_t>(~(1 << sl));
+                if (s.sl_bitmap[fl] == 0) {
+                    s.fl_bitmap &= ~(static_cast<uint32_t>(1) << fl);
+                }
+            }
+        }
     }
 
-    // Allocate #3: Typeless allocation of n bytes
-    void_pointer allocate_b (size_t n_bytes)
+    // Inline method: File free block b again after its size changed in place
+    inline void refile_block (block_h *b)
     {
-    	block_h *last, *curr;
-    	size_t const unit_size = sizeof(block_h);
+        unfile_block(b);
+        file_block(b);
+    }
 
-        // Check: Validity of fields
-        if (d_allocator_info_p == nullptr || 
-            d_allocator_info_p->static_memory_map == nullptr) {
-            throw std::invalid_argument("Uninitialized static memory");
+    // Inline method: A free block of at least n_blocks units from the smallest
+    // non-empty class whose every block fits (NULL if none), in constant time
+    inline block_h *find_bin (size_t n_blocks) const
+    {
+        segregated_bins_t const &s = *d_allocator_info_p;
+
+        // Round up to the next class boundary (past the largest, none fits)
+        if (n_blocks >= SEGREGATED_SL_COUNT) {
+            n_blocks += (static_cast<size_t>(1) << (floor_log2(n_blocks) - SEGREGATED_SL_LOG2)) - 1;
+        }
+        if (n_blocks > SEGREGATED_MAX_UNITS) {
+            return nullptr;
+        }
+        size_t fl, sl;
+        size_class(n_blocks, fl, sl);
+
+        // Bins of the class and above on its first level, else the next level up
+        uint32_t sl_map = s.sl_bitmap[fl] & (~0u << sl);
+        if (sl_map == 0) {
+            uint64_t fl_map = s.fl_bitmap & (~static_cast<uint64_t>(0) << (fl + 1));
+            if (fl_map == 0) {
+                return nullptr;
+            }
+            fl = __builtin_ctzll(fl_map);
+            sl_map = s.sl_bitmap[fl];
         }
+        return block_at(s.bins[fl][__builtin_ctz(sl_map)]);
+    }
 
-    	// Check: Requested byte count
-    	if (n_bytes == 0) {
-            throw std::invalid_argument("Cannot allocate zero bytes");
-    	}
+    // Inline method: Units of a block holding n bytes (header and canary included)
+    static inline size_t units_for (size_t n_bytes)
+    {
+        return std::max((n_bytes + CANARY_SIZE + sizeof(block_h) - 1) / sizeof(block_h) + 1,
+            MIN_BLOCK_UNITS);
+    }
 
-    	// Compute blocks needed (one extra block for segment header)
-    	size_t n_blocks = (n_bytes + unit_size - 1) / unit_size + 1;
+    // Annotations: In annotated builds (see allocator_annotate.cpp) the
+    // interiors of free blocks and the slack of allocated blocks are
+    // inaccessible, while boundary tags (header, back link, footer) stay
+    // accessible. Free blocks are exposed whole before being split or merged,
+    // and their interiors hidden again afterwards
 
-    	// Check: Sufficient capacity
-    	if ((n_blocks * unit_size) > d_allocator_info_p->free_size) {
-    		return NULL;
-    	}
+    // Inline method: Whether this map is annotated
+    inline bool annotated () const
+    {
+#if defined(ALLOCATOR_ANNOTATE)
+        return d_allocator_info_p->annotated;
+#else
+        return false;
+#endif
+    }
 
-    	// If uninitialized: Create initial list structure
-    	if ((last = d_allocator_info_p->free_list) == NULL) {
-    		block_h *head = reinterpret_cast<block_h *>(
-                d_allocator_info_p->free_memory_map);
-    		head->d.size = 0;
+    // Inline method: Make n_units from b accessible to the allocator
+    inline void expose_units (block_h *b, size_t n_units) const
+    {
+        if (annotated()) {
+            ALLOCATOR_ANNOTATE_TAGS(b, n_units * sizeof(block_h));
+        }
+    }
 
-    		block_h *init = head + 1;
-    		init->d.size = (d_allocator_info_p->free_size) / unit_size;
-    		init->d.next = (d_allocator_info_p->free_list) = last = head;
+    // Inline method: Hide free block b past its links, but for the footer
+    inline void hide_free_block (block_h *b) const
+    {
+        if (annotated()) {
+            block_h *footer = b + units_of(b) - 1;
+            ALLOCATOR_ANNOTATE_FREE_SPACE(&((b + LINK_UNITS)->d.size),
+                (units_of(b) - LINK_UNITS) * sizeof(block_h) - sizeof(size_t));
+            ALLOCATOR_ANNOTATE_TAGS(&(footer->d.size), sizeof(size_t));
+        }
+    }
 
-    		head->d.next = init;
-    	}
+    // Inline method: Resize the payload of allocated block b in place
+    inline void resize_payload (block_h *b, size_t old_bytes, size_t n_bytes) const
+    {
+        if (annotated()) {
+            ALLOCATOR_ANNOTATE_RESIZED(b + 1, (units_of(b) - 1) * sizeof(block_h),
+                old_bytes, n_bytes);
+            ALLOCATOR_ANNOTATE_TAGS(reinterpret_cast<uint8_t *>(b + 1) + n_bytes, CANARY_SIZE);
+        }
+    }
 
-    	// Find free space: Stop if wrap-around occurs
-    	for (curr = last->d.next; ; last = curr, curr = curr->d.next) {
+    // Checked mode: An allocated block carries BLOCK_MAGIC in its header and
+    // the canary right after the n bytes requested, both verified (with the
+    // size) whenever the block is freed or resized. Freeing clears the magic
+    // and poisons the block, so a second free is caught. In unchecked mode
+    // all of this compiles away
 
-    		// Case: Enough space
-    		if (curr->d.size >= n_blocks) {
+    // Inline method: Hand out allocated block b for n bytes
+    inline void *hand_out (block_h *b, size_t n_bytes) const
+    {
+        if (annotated()) {
+            ALLOCATOR_ANNOTATE_FREE_SPACE(b + 1, (units_of(b) - 1) * sizeof(block_h));
+            ALLOCATOR_ANNOTATE_ALLOCATED(b + 1, n_bytes);
+            ALLOCATOR_ANNOTATE_TAGS(reinterpret_cast<uint8_t *>(b + 1) + n_bytes, CANARY_SIZE);
+        }
+        if constexpr (Policy::checked) {
+            b->d.next = BLOCK_MAGIC ^ offset_of(b);
+            set_canary(b, n_bytes);
+        } else {
+            b->d.next = 0;
+        }
+#if defined(ALLOCATOR_PROFILE)
+        if (d_allocator_info_p->profile != 0 && profile_sample(profile_table(), n_bytes)) {
+            profile_record(profile_table(), offset_of(b), n_bytes);
+        }
+#endif
+        return reinterpret_cast<void *>(b + 1);
+    }
 
-    			// Case: Exactly enough
-    			if (curr->d.size == n_blocks) {
-    				last->d.next = curr->d.next;
-    			} else {
-    			// Case: More than enough
-    				curr->d.size -= n_blocks;
-    				curr += curr->d.size;
-    				curr->d.size = n_blocks;
-    			}
+    // Inline method: Install the canary of block b after n bytes
+    static inline void set_canary (block_h *b, size_t n_bytes)
+    {
+        uint64_t canary = CANARY;
+        memcpy(reinterpret_cast<uint8_t *>(b + 1) + n_bytes, &canary, sizeof(canary));
+    }
 
-    			// Reassign free list head
-                d_allocator_info_p->free_list = last;
+    // Verify that block b is allocated to hold n bytes and intact (checked mode)
+    void check_block (block_h const *b, size_t n_bytes) const
+    {
+        uint64_t canary;
 
-    			// Update amount of free memory available
-    			d_allocator_info_p->free_size -= n_blocks * unit_size;
+        // Check: Header of a block in use
+        if (b->d.next != (BLOCK_MAGIC ^ offset_of(b)) ||
+            (b->d.size & (FLAG_FREE | FLAG_QUICK)) != 0)
+        {
+            throw std::invalid_argument("Double free or pointer not allocated from map");
+        }
 
-    			return reinterpret_cast<void *>(curr + 1);
-    		}
+        // Check: Size matches the block (which may have absorbed a remainder)
+        size_t n_blocks = units_for(n_bytes);
+        if (units_of(b) < n_blocks || units_of(b) - n_blocks >= MIN_BLOCK_UNITS) {
+            throw std::invalid_argument("Size does not match the allocated block");
+        }
 
-    		// Case: Insufficient. If at head, then no block found
-    		if (curr == (d_allocator_info_p->free_list)) {
-    			return NULL;
-    		}
-    	}
+        // Check: Nothing written past the end
+        memcpy(&canary, reinterpret_cast<uint8_t const *>(b + 1) + n_bytes, sizeof(canary));
+        if (canary != CANARY) {
+            throw std::runtime_error("Canary overwritten past the end of a block");
+        }
     }
 
-    // Convert a reference to a pointer
-    pointer address (reference r) const
+    // Inline method: Clear the magic of block b and poison its contents
+    static inline void poison (block_h *b)
     {
-    	return static_cast<pointer>(std::addressof(r));
+        b->d.next = 0;
+        memset(b + 1, POISON, (units_of(b) - 1) * sizeof(block_h));
     }
 
-    // Converts a reference to a const pointer
-    const_pointer address (const_reference r) const
+    // Stats: Only the allocating side writes the counters, so each counter is
+    // updated with a relaxed load and store (no read-modify-write) between
+    // stats_begin() and stats_end()
+
+    // Inline method: Open a stats update
+    inline stats_counters_t &stats_begin ()
     {
-    	return static_cast<const_pointer>(std::addressof(r));
+        stats_counters_t &c = d_allocator_info_p->stats;
+        c.seq.store(c.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return c;
     }
 
-    // Deallocate
-    void deallocate (pointer ptr, size_type n_obj)
+    // Inline method: Close a stats update
+    static inline void stats_end (stats_counters_t &c)
     {
-    	block_h *b, *p;
-    	size_t const unit_size = sizeof(block_h);
+        c.seq.store(c.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
 
-        std::cout << "deallocate(" << n_obj << ")" << std::endl;
+    // Inline method: Add to a counter
+    static inline void stats_add (std::atomic<size_t> &counter, size_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+            std::memory_order_relaxed);
+    }
 
-        // Check: Validity of state
-        if (d_allocator_info_p == nullptr)
-        {
-            throw std::invalid_argument("Uninitialized static memory");
+    // Inline method: Count a search that visited n_visited free blocks
+    static inline void stats_search (stats_counters_t &c, size_t n_visited)
+    {
+        size_t bucket = 0;
+        while (bucket + 1 < ALLOCATOR_SEARCH_BUCKETS && (static_cast<size_t>(1) << bucket) < n_visited) {
+            bucket++;
         }
+        stats_add(c.search_length[bucket], 1);
+    }
 
-    	// Parameter check: Is pointer valid
-    	if (ptr == nullptr) {
-            throw std::invalid_argument("Cannot free nullptr!");
-    	}
+    // Inline method: Keep the largest-block bound within the free bytes. Carving
+    // a block never rescans the list for the new largest one (the bound stays
+    // until largest_free_block() tightens it)
+    inline void stats_bound_largest (stats_counters_t &c) const
+    {
+        if (c.largest_free_block.load(std::memory_order_relaxed) > d_allocator_info_p->free_size) {
+            c.largest_free_block.store(d_allocator_info_p->free_size, std::memory_order_relaxed);
+        }
+    }
 
-    	// Address range of returned object
-        uint8_t *obj_addr_start = reinterpret_cast<uint8_t *>(ptr);
-        uint8_t *obj_addr_end   = obj_addr_start + (n_obj * sizeof(T));
+    // Free bytes of a new map (whole units between the list head and the fence)
+    static constexpr size_t initial_free_size (size_t capacity)
+    {
+        return (capacity - INFO_SIZE) / sizeof(block_h) * sizeof(block_h)
+            - (MIN_BLOCK_UNITS + 1) * sizeof(block_h);
+    }
 
-        // Address of range of static memory block
-        uint8_t *static_addr_start = 
-            reinterpret_cast<uint8_t *>(d_allocator_info_p->static_memory_map);
-        uint8_t *static_addr_end = static_addr_start + (d_allocator_info_p->capacity);
-    	
-        // Parameter check: Pointer address range
-    	if (!(obj_addr_start > static_addr_start && 
-            obj_addr_end <= static_addr_end))
-    	{
-            throw std::invalid_argument("Pointer originates outside valid bounds");  		
-    	}
+    // Information structure of a new map of capacity bytes. The free list is
+    // built on first use, so nothing else in the map needs initialising
+    static constexpr allocator_info_t initial_info (size_t capacity)
+    {
+        return allocator_info_t{
+            {},                              // bins (segregated policy, empty)
+            INFO_SIZE,                       // free_memory_map
+            capacity,                        // capacity
+            initial_free_size(capacity),     // free_size
+            0,                               // free_list (not yet built)
+            {},                              // quick_lists (empty)
+            0,                               // n_quick
+            0,                               // quick_next
+            false,                           // deferred
+            true,                            // annotated
+            {                                // stats (one free block)
+                {0}, {0}, {0}, {0}, {0}, {0},
+                {initial_free_size(capacity)}, {1}, {0}, {}
+            }
+#if defined(ALLOCATOR_TRACE)
+            , {}                             // trace (empty)
+#endif
+#if defined(ALLOCATOR_PROFILE)
+            , 0                              // profile (none)
+#endif
+        };
+    }
 
-    	// Block header
-    	b = (reinterpret_cast<block_h *>(ptr)) - 1;
+    // Create the initial list structure: one free block spanning the map
+    void build_free_list ()
+    {
+        size_t const unit_size = sizeof(block_h);
 
-    	// Locate insertion point
-    	for (p = d_allocator_info_p->free_list; 
-            !(b >= p && b < p->d.next); p = p->d.next) {
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        head->d.size = 0;
 
-    		// Case: Block comes at end of list
-    		if (p >= p->d.next && b > p) {
-    			break;
-    		}
+        block_h *init = head + MIN_BLOCK_UNITS;
+        init->d.size = ((d_allocator_info_p->free_size) / unit_size) | FLAG_FREE;
+        set_footer(init);
 
-    		// Case: End of list, but block first after wrap-around
-    		if (p >= p->d.next && b < p->d.next) {
-    			break;
-    		}
-    	}
+        // Fence: Zero-sized block in use, stops forward merges at the end
+        block_h *fence = init + units_of(init);
+        fence->d.size = FLAG_PREV_FREE;
 
-    	// Check: Forward merge possible
-    	if (b + b->d.size == p->d.next) {
-    		b->d.size += (p->d.next)->d.size;
-    		b->d.next = (p->d.next)->d.next;
-    	} else {
-    		b->d.next = p->d.next;
-    	}
+        head->d.next = prev_of(head) = offset_of(init);
+        init->d.next = prev_of(init) = offset_of(head);
+        d_allocator_info_p->free_list = offset_of(head);
+        file_block(init);
+        hide_free_block(init);
+    }
+
+    // Return an allocated block to the free list, merging with free neighbours.
+    // A block coming off a quick list was already counted as free (counted)
+    void release_block (block_h *b, stats_counters_t &c, bool counted = false)
+    {
+        size_t const unit_size = sizeof(block_h);
+        size_t b_units = units_of(b);
+        block_h *p;
+
+        // Update available memory size
+        if (!counted) {
+            d_allocator_info_p->free_size += b_units * unit_size;
+            stats_add(c.used_bytes, static_cast<size_t>(0) - b_units * unit_size);
+        }
 
-    	// Check: Backward merge possible
-    	if (p + p->d.size == b) {
-    		p->d.size += b->d.size;
-    		p->d.next = b->d.next;
+        // Physical successor
+        block_h *n = b + b_units;
+        expose_units(b, b_units);
+
+    	// Check: Backward merge possible (preceding block extends to b)
+    	if (b->d.size & FLAG_PREV_FREE) {
+            p = b - (b - 1)->d.size;
+    		p->d.size += b_units;
+            b = p;
     	} else {
-    		p->d.next = b;
+            b->d.size = b_units | FLAG_FREE;
+            link_after(block_at(d_allocator_info_p->free_list), b);
+            stats_add(c.n_free_blocks, 1);
+        }
+
+    	// Check: Forward merge possible
+    	if (is_free(n)) {
+            if (d_allocator_info_p->free_list == offset_of(n)) {
+                d_allocator_info_p->free_list = offset_of(b);
+            }
+            unlink(n);
+            b->d.size += units_of(n);
+            stats_add(c.n_free_blocks, static_cast<size_t>(-1));
     	}
 
-    	// Update free-list pointer
-    	d_allocator_info_p->free_list = p;
+        // Case: Merged, so the block grew on the list
+        if (units_of(b) != b_units) {
+            refile_block(b);
+        }
 
-    	// Update available memory size
-    	d_allocator_info_p->free_size += b->d.size * unit_size;
+        // Update counters (merging only ever grows the largest block)
+        if (units_of(b) * unit_size > c.largest_free_block.load(std::memory_order_relaxed)) {
+            c.largest_free_block.store(units_of(b) * unit_size, std::memory_order_relaxed);
+        }
+
+        // Install footer and flag the successor
+        set_footer(b);
+        (b + units_of(b))->d.size |= FLAG_PREV_FREE;
+        hide_free_block(b);
+
+    	// Update free-list pointer
+    	d_allocator_info_p->free_list = prev_of(b);
     }
 
-    // Number of available bytes
-    size_t free_size () const
+    // Deferred coalescing: A quick-listed block keeps its in-use header (plus
+    // FLAG_QUICK), so neighbours never merge with it, and is chained through
+    // d.next. Its bytes count as free, but it only serves requests of its size
+
+    // Inline method: Quick list for blocks of n_units (ALLOCATOR_QUICK_LISTS if none)
+    static inline size_t quick_index (size_t n_units)
     {
-    	if (d_allocator_info_p == nullptr) {
-            throw std::runtime_error("Uninitialized allocator information");
-        } else {
-            return d_allocator_info_p->free_size;
-        }
+        return std::min(n_units - MIN_BLOCK_UNITS, static_cast<size_t>(ALLOCATOR_QUICK_LISTS));
     }
 
-    // Whether the memory is unified
-    bool unified () const
+    // Free an allocated block: quick-list it in deferred mode, release it otherwise
+    void free_block (block_h *b, stats_counters_t &c)
     {
-        if (d_allocator_info_p == nullptr) {
-            throw std::runtime_error("Uninitialized allocator information");
-        }
+        size_t const unit_size = sizeof(block_h);
+        size_t k = quick_index(units_of(b));
 
-        if (d_allocator_info_p->static_memory_map == nullptr) {
-            std::cerr << __FILE__ << ":" << __LINE__ << ":" << __func__ << ": "
-            "Uninitialized allocator cannot be unified (no memory)" << std::endl;
-            return false;
+#if defined(ALLOCATOR_PROFILE)
+        if (d_allocator_info_p->profile != 0) {
+            profile_forget(profile_table(), offset_of(b));
+        }
+#endif
+        if (annotated()) {
+            ALLOCATOR_ANNOTATE_FREED(b + 1);
+            expose_units(b, units_of(b));
+        }
+        if constexpr (Policy::checked) {
+            poison(b);
         }
 
-        if (d_allocator_info_p->free_list == nullptr) {
-            std::cerr << __FILE__ << ":" << __LINE__ << ":" << __func__ << ": "
-            "Uninitialized allocator cannot be unified (no list)" << std::endl;
-            return false;
+        // Case: Merge now
+        if (!d_allocator_info_p->deferred || k == ALLOCATOR_QUICK_LISTS) {
+            release_block(b, c);
+            return;
         }
 
-        block_h *b = reinterpret_cast<block_h *>(d_allocator_info_p->free_list);
+        b->d.size |= FLAG_QUICK;
+        b->d.next = d_allocator_info_p->quick_lists[k];
+        d_allocator_info_p->quick_lists[k] = offset_of(b);
+        d_allocator_info_p->n_quick++;
+        d_allocator_info_p->free_size += units_of(b) * unit_size;
+
+        stats_add(c.used_bytes, static_cast<size_t>(0) - units_of(b) * unit_size);
+        stats_add(c.n_quick_blocks, 1);
 
-        return ((b->d.next)->d.next == b);
+        if (annotated()) {
+            ALLOCATOR_ANNOTATE_FREE_SPACE(b + 1, (units_of(b) - 1) * unit_size);
+        }
+    }
+
+    // Free block of at least n_blocks units chosen by the policy (NULL if
+    // none), counting the blocks visited
+    block_h *find_fit (size_t n_blocks, size_t &n_visited) const
+    {
+        if constexpr (Policy::segregated) {
+            n_visited++;
+            return find_bin(n_blocks);
+        }
+
+        block_h *start = Policy::roving ? block_at(d_allocator_info_p->free_list) :
+            block_at(d_allocator_info_p->free_memory_map);
+        block_h *best = nullptr;
+
+        // Stop if wrap-around occurs (the list head is zero-sized, never a fit)
+        for (block_h *curr = block_at(start->d.next); ; curr = block_at(curr->d.next)) {
+            n_visited++;
+
+            // Case: Enough space
+            if (units_of(curr) >= n_blocks) {
+                if constexpr (!Policy::best_fit) {
+                    return curr;
+                }
+
+                // Case: Tighter than the best so far, stop if nothing to split
+                if (best == nullptr || units_of(curr) < units_of(best)) {
+                    best = curr;
+                    if (units_of(curr) - n_blocks < MIN_BLOCK_UNITS) {
+                        break;
+                    }
+                }
+            }
+
+            if (curr == start) {
+                break;
+            }
+        }
+
+        return best;
+    }
+
+    // Hand out n_blocks units for n bytes from free block curr, past lead
+    // units of slack (found after visiting n_visited blocks). The slack on
+    // either side stays free
+    void *carve (block_h *curr, size_t lead, size_t n_blocks, size_t n_bytes,
+        size_t n_visited)
+    {
+        size_t const unit_size = sizeof(block_h);
+        stats_counters_t &c = stats_begin();
+        size_t curr_units = units_of(curr);
+        size_t remainder = curr_units - lead - n_blocks;
+        block_h *p = block_at(prev_of(curr));
+        block_h *b = curr + lead;
+        expose_units(curr, curr_units);
+
+        // Take the block off the list, then return the slack on both
+        // sides (headers from the tail down, see recover())
+        unlink(curr);
+        stats_add(c.n_free_blocks, static_cast<size_t>(-1));
+
+        // Case: Remainder too small to hold a block
+        if (remainder < MIN_BLOCK_UNITS) {
+            n_blocks += remainder;
+            (b + n_blocks)->d.size &= ~FLAG_PREV_FREE;
+        } else {
+        // Case: Trailing slack remains free (successor keeps FLAG_PREV_FREE)
+            block_h *t = b + n_blocks;
+            t->d.size = remainder | FLAG_FREE;
+            set_footer(t);
+            link_after(p, t);
+            hide_free_block(t);
+            stats_add(c.n_free_blocks, 1);
+        }
+
+        b->d.size = n_blocks | ((lead > 0) ? FLAG_PREV_FREE : 0);
+
+        // Case: Leading slack remains free
+        if (lead > 0) {
+            curr->d.size = lead | FLAG_FREE;
+            set_footer(curr);
+            link_after(p, curr);
+            hide_free_block(curr);
+            p = curr;
+            stats_add(c.n_free_blocks, 1);
+        }
+
+        // Reassign free list head
+        d_allocator_info_p->free_list = offset_of(p);
+
+        // Update amount of free memory available
+        d_allocator_info_p->free_size -= n_blocks * unit_size;
+
+        // Update counters
+        size_t used_bytes = c.used_bytes.load(std::memory_order_relaxed)
+            + n_blocks * unit_size;
+        c.used_bytes.store(used_bytes, std::memory_order_relaxed);
+        if (used_bytes > c.peak_used_bytes.load(std::memory_order_relaxed)) {
+            c.peak_used_bytes.store(used_bytes, std::memory_order_relaxed);
+        }
+        stats_bound_largest(c);
+        stats_add(c.n_allocations, 1);
+        stats_search(c, n_visited);
+        stats_end(c);
+
+        ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_ALLOCATE,
+            n_bytes, offset_of(b));
+        return hand_out(b, n_bytes);
+    }
+
+public:
+
+    // Alias: Value types
+    using value_type         = T;
+
+	// Alias: Pointer as pointer to value type
+	using pointer            = T *;
+
+	// Alias: Pointer to const
+	using const_pointer      = T const *;
+
+	// Alias: Most general pointer
+	using void_pointer       = void *;
+
+	// Alias: Most general pointer (to const)
+	using const_void_pointer = const void *;
+
+	// Alias: Reference
+	using reference          = T&;
+
+	// Alias: Constant reference
+	using const_reference    = const T&;
+
+	// Alias: Allocation and deallocation size
+	using size_type          = size_t;
+
+	// Traits: Containers take the allocator along on copy, move and swap, so
+	// moving a container between maps steals its memory instead of copying
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap            = std::true_type;
+
+	// Traits: Allocators of different maps are not interchangeable
+	using is_always_equal    = std::false_type;
+
+    // Smallest map accepted: metadata, list head, one free block and fence
+    static constexpr size_t MIN_CAPACITY = INFO_SIZE + (2 * MIN_BLOCK_UNITS + 1) * sizeof(block_h);
+
+    // Rebinding support: Let container construct arbitrary type allocator
+    template <class U>
+    struct rebind {
+    	using other          = Static_Allocator<U, Policy>;
+    };
+
+    // Operator: Move assignment
+    template <class U>
+    Static_Allocator &operator=(Static_Allocator<U, Policy> &&origin)
+    {
+        // Self-assign check
+        if (static_cast<void *>(&origin) == this) { return *this; }
+
+        // Release held resources 
+        // None
+
+        // Ownership transfer
+        this->d_allocator_info_p = 
+            reinterpret_cast<allocator_info_t *>(origin.allocator_info_p());
+
+        // HINT: Copy the pointer values, and null the origin ones
+        // HINT: In a copy you just make a new and then copy contents by value
+        return *this;
+    }
+
+    // Empty constuctor that does nothing
+    Static_Allocator ():
+        d_allocator_info_p(nullptr)
+    {
+        // Nothing to do
+    }
+
+    // Constructor
+    Static_Allocator (void *static_memory_map, size_t capacity)
+    {
+        // Capacity check
+        if (capacity < MIN_CAPACITY) {
+            throw std::bad_alloc();
+        }
+
+        // Segregated policy: Every block must have a size class
+        if (Policy::segregated && capacity / sizeof(block_h) > SEGREGATED_MAX_UNITS) {
+            throw std::invalid_argument("Map too large for segregated size classes");
+        }
+
+        // Annotations: Storage may still be poisoned by a map that was there
+        // before (e.g. a reused stack frame or mapping), expose it first
+        ALLOCATOR_ANNOTATE_TAGS(static_memory_map, capacity);
+
+        // Struct initialization
+        d_allocator_info_p = reinterpret_cast<allocator_info_t *>(static_memory_map);
+
+        // Set the capacity
+        d_allocator_info_p->capacity = capacity;
+
+        // Set offset of head of free memory map
+        d_allocator_info_p->free_memory_map = INFO_SIZE;
+
+        // Set the free size (whole units between list head and fence)
+        d_allocator_info_p->free_size = initial_free_size(capacity);
+
+        // Set the free list (and the bins, filled with it)
+        d_allocator_info_p->free_list = 0;
+        reset_bins();
+
+        // Empty quick lists (deferred coalescing is off by default)
+        for (size_t i = 0; i < ALLOCATOR_QUICK_LISTS; ++i) {
+            d_allocator_info_p->quick_lists[i] = 0;
+        }
+        d_allocator_info_p->n_quick = 0;
+        d_allocator_info_p->quick_next = 0;
+        d_allocator_info_p->deferred = false;
+        d_allocator_info_p->annotated = true;
+
+        // Clear the counters (the whole free space forms one block)
+        stats_counters_t &c = d_allocator_info_p->stats;
+        new (&(c.seq)) std::atomic<size_t>(0);
+        new (&(c.n_allocations)) std::atomic<size_t>(0);
+        new (&(c.n_deallocations)) std::atomic<size_t>(0);
+        new (&(c.n_failed)) std::atomic<size_t>(0);
+        new (&(c.used_bytes)) std::atomic<size_t>(0);
+        new (&(c.peak_used_bytes)) std::atomic<size_t>(0);
+        new (&(c.largest_free_block)) std::atomic<size_t>(d_allocator_info_p->free_size);
+        new (&(c.n_free_blocks)) std::atomic<size_t>(1);
+        new (&(c.n_quick_blocks)) std::atomic<size_t>(0);
+        for (size_t i = 0; i < ALLOCATOR_SEARCH_BUCKETS; ++i) {
+            new (&(c.search_length[i])) std::atomic<size_t>(0);
+        }
+
+#if defined(ALLOCATOR_TRACE)
+        // Clear the trace ring
+        trace_ring_init(&(d_allocator_info_p->trace));
+#endif
+#if defined(ALLOCATOR_PROFILE)
+        // No profile until sampling is turned on
+        d_allocator_info_p->profile = 0;
+#endif
+    }
+
+    // Handle to a map previously initialized by the constructor
+    static Static_Allocator attach (void *static_memory_map)
+    {
+        Static_Allocator allocator;
+
+        // Parameter check: Is pointer valid
+        if (static_memory_map == nullptr) {
+            throw std::invalid_argument("Cannot attach to nullptr!");
+        }
+
+        allocator.d_allocator_info_p =
+            reinterpret_cast<allocator_info_t *>(static_memory_map);
+        return allocator;
+    }
+
+    // Copy constructor
+    Static_Allocator (const Static_Allocator &origin)
+    {
+        // Simply copy the static memory pointer (not protected from race conditions)
+        d_allocator_info_p = origin.allocator_info_p();
+    }
+
+    // Destructor
+    ~Static_Allocator ()
+    {
+        // No destructor needed: state is not saved in the class instance
+    }
+
+    // Support for allocating other types
+    template <class U>
+    Static_Allocator (const Static_Allocator<U, Policy> &other):
+        d_allocator_info_p(reinterpret_cast<allocator_info_t *>(
+            other.allocator_info_p()))
+    {
+        // Nothing to do
+    }
+
+    // Operator: Equality (memory from one may be freed by the other)
+    template <class U>
+    bool operator== (const Static_Allocator<U, Policy> &other) const
+    {
+        return reinterpret_cast<void *>(d_allocator_info_p) ==
+            reinterpret_cast<void *>(other.allocator_info_p());
+    }
+
+    // Operator: Inequality
+    template <class U>
+    bool operator!= (const Static_Allocator<U, Policy> &other) const
+    {
+        return !(*this == other);
+    }
+
+    // Allocate #1: General allocation
+    pointer allocate (size_type n_obj)
+    {
+    	size_t n_bytes = (n_obj * sizeof(T));
+
+        // Case: Over-aligned type
+        if (alignof(T) > sizeof(block_h)) {
+            return reinterpret_cast<pointer>(this->allocate_aligned(n_bytes, alignof(T)));
+        }
+    	return reinterpret_cast<pointer>(this->allocate_b(n_bytes));
+    }
+
+    // Allocate #2: Placement support
+    pointer allocate (size_type n_obj, const_void_pointer hint)
+    {
+    	return allocate(n_obj);
+    }
+
+    // Allocate #3: Typeless allocation of n bytes
+    void_pointer allocate_b (size_t n_bytes)
+    {
+    	block_h *last, *curr;
+    	size_t const unit_size = sizeof(block_h);
+
+        // Check: Validity of fields
+        if (d_allocator_info_p == nullptr || 
+            d_allocator_info_p->capacity == 0) {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Check: Requested byte count
+    	if (n_bytes == 0) {
+            throw std::invalid_argument("Cannot allocate zero bytes");
+    	}
+
+    	// Compute blocks needed (one extra block for segment header)
+    	size_t n_blocks = units_for(n_bytes);
+
+    	// Check: Sufficient capacity
+    	if ((n_blocks * unit_size) > d_allocator_info_p->free_size) {
+            stats_counters_t &c = stats_begin();
+            stats_add(c.n_failed, 1);
+            stats_end(c);
+            ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_ALLOCATE_FAILED,
+                n_bytes, d_allocator_info_p->free_size);
+    		return NULL;
+    	}
+
+        // Case: A freed block of this size waits in a quick list
+        size_t k = quick_index(n_blocks);
+        if (k < ALLOCATOR_QUICK_LISTS && d_allocator_info_p->quick_lists[k] != 0) {
+            curr = block_at(d_allocator_info_p->quick_lists[k]);
+            d_allocator_info_p->quick_lists[k] = curr->d.next;
+            d_allocator_info_p->n_quick--;
+            d_allocator_info_p->free_size -= n_blocks * unit_size;
+            curr->d.size &= ~FLAG_QUICK;
+
+            // Update counters
+            stats_counters_t &c = stats_begin();
+            size_t used_bytes = c.used_bytes.load(std::memory_order_relaxed)
+                + n_blocks * unit_size;
+            c.used_bytes.store(used_bytes, std::memory_order_relaxed);
+            if (used_bytes > c.peak_used_bytes.load(std::memory_order_relaxed)) {
+                c.peak_used_bytes.store(used_bytes, std::memory_order_relaxed);
+            }
+            stats_add(c.n_quick_blocks, static_cast<size_t>(-1));
+            stats_add(c.n_allocations, 1);
+            stats_search(c, 0);
+            stats_end(c);
+
+            ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_ALLOCATE,
+                n_bytes, offset_of(curr));
+            return hand_out(curr, n_bytes);
+        }
+
+    	// If uninitialized: Create initial list structure
+    	if (d_allocator_info_p->free_list == 0) {
+            build_free_list();
+    	}
+
+    	// Find free space
+        size_t n_visited = 0;
+        curr = find_fit(n_blocks, n_visited);
+
+    	// Case: No block found
+    	if (curr == nullptr) {
+
+            // Case: Quick-listed blocks may merge into a large enough one
+            if (d_allocator_info_p->n_quick > 0) {
+                consolidate();
+                return allocate_b(n_bytes);
+            }
+
+            stats_counters_t &c = stats_begin();
+            stats_add(c.n_failed, 1);
+            stats_search(c, n_visited);
+            stats_end(c);
+            ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_ALLOCATE_FAILED,
+                n_bytes, d_allocator_info_p->free_size);
+    		return NULL;
+    	}
+
+        stats_counters_t &c = stats_begin();
+        last = block_at(prev_of(curr));
+        expose_units(curr, units_of(curr));
+
+    	// Case: Exactly enough (or remainder too small to hold a block)
+    	if (units_of(curr) - n_blocks < MIN_BLOCK_UNITS) {
+            stats_add(c.n_free_blocks, static_cast<size_t>(-1));
+    		unlink(curr);
+            n_blocks = units_of(curr);
+            curr->d.size = n_blocks;
+    	} else {
+    	// Case: More than enough (tail header first, see recover())
+            block_h *tail = curr + units_of(curr) - n_blocks;
+    		tail->d.size = n_blocks | FLAG_PREV_FREE;
+    		curr->d.size -= n_blocks;
+            set_footer(curr);
+            refile_block(curr);
+            hide_free_block(curr);
+    		curr = tail;
+    	}
+
+        // Successor no longer follows a free block
+        (curr + n_blocks)->d.size &= ~FLAG_PREV_FREE;
+
+    	// Reassign free list head
+        d_allocator_info_p->free_list = offset_of(last);
+
+    	// Update amount of free memory available
+    	d_allocator_info_p->free_size -= n_blocks * unit_size;
+
+        // Update counters
+        size_t used_bytes = c.used_bytes.load(std::memory_order_relaxed)
+            + n_blocks * unit_size;
+        c.used_bytes.store(used_bytes, std::memory_order_relaxed);
+        if (used_bytes > c.peak_used_bytes.load(std::memory_order_relaxed)) {
+            c.peak_used_bytes.store(used_bytes, std::memory_order_relaxed);
+        }
+        stats_bound_largest(c);
+        stats_add(c.n_allocations, 1);
+        stats_search(c, n_visited);
+        stats_end(c);
+
+        ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_ALLOCATE,
+            n_bytes, offset_of(curr));
+    	return hand_out(curr, n_bytes);
+    }
+
+    // Allocate #4: Typeless allocation of n bytes at a multiple of alignment.
+    // Free space before the aligned block is split off and stays on the list.
+    // Alignments above sizeof(block_h) require a map aligned to sizeof(block_h)
+    void_pointer allocate_aligned (size_t n_bytes, size_t alignment)
+    {
+    	block_h *curr;
+    	size_t const unit_size = sizeof(block_h);
+
+    	// Parameter check: Alignment is a power of two
+    	if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+            throw std::invalid_argument("Alignment must be a power of two");
+    	}
+
+    	// Case: Every block is suitably aligned
+    	if (alignment <= unit_size) {
+            return allocate_b(n_bytes);
+    	}
+
+        // Check: Validity of fields
+        if (d_allocator_info_p == nullptr || 
+            d_allocator_info_p->capacity == 0) {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Check: Requested byte count
+    	if (n_bytes == 0) {
+            throw std::invalid_argument("Cannot allocate zero bytes");
+    	}
+
+    	// Compute blocks needed (one extra block for segment header)
+    	size_t n_blocks = units_for(n_bytes);
+
+    	// Check: Sufficient capacity
+    	if ((n_blocks * unit_size) > d_allocator_info_p->free_size) {
+            stats_counters_t &c = stats_begin();
+            stats_add(c.n_failed, 1);
+            stats_end(c);
+    		return NULL;
+    	}
+
+    	// If uninitialized: Create initial list structure
+    	if (d_allocator_info_p->free_list == 0) {
+            build_free_list();
+    	}
+
+    	// Find free space: Stop if wrap-around occurs
+        size_t n_visited = 0;
+        block_h *head = Policy::roving ? block_at(d_allocator_info_p->free_list) :
+            block_at(d_allocator_info_p->free_memory_map);
+    	for (curr = block_at(head->d.next); ; curr = block_at(curr->d.next)) {
+            n_visited++;
+
+            // Candidate: First aligned position whose leading slack is either
+            // empty or large enough to remain a free block
+            uintptr_t start = reinterpret_cast<uintptr_t>(curr + 1);
+            uintptr_t user = (start + alignment - 1) & ~(alignment - 1);
+            if (user != start && (user - start) / unit_size < MIN_BLOCK_UNITS) {
+                user += alignment;
+            }
+            size_t lead = (user - start) / unit_size;
+
+            // Check: Blocks start at multiples of unit_size from the map, so
+            // no block can be aligned further unless the map is
+            if ((user - start) % unit_size != 0) {
+                throw std::invalid_argument("Map not aligned to block size");
+            }
+
+    		// Case: Enough space after the slack
+    		if (units_of(curr) >= n_blocks && units_of(curr) - n_blocks >= lead) {
+                return carve(curr, lead, n_blocks, n_bytes, n_visited);
+    		}
+
+    		// Case: Insufficient. If at head, then no block found
+    		if (curr == head) {
+
+                // Case: Quick-listed blocks may merge into a large enough one
+                if (d_allocator_info_p->n_quick > 0) {
+                    consolidate();
+                    return allocate_aligned(n_bytes, alignment);
+                }
+
+                stats_counters_t &c = stats_begin();
+                stats_add(c.n_failed, 1);
+                stats_search(c, n_visited);
+                stats_end(c);
+                ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_ALLOCATE_FAILED,
+                    n_bytes, d_allocator_info_p->free_size);
+    			return NULL;
+    		}
+    	}
+    }
+
+    // Allocate #5: Up to count blocks of n bytes each, carved from as few free
+    // blocks as possible in one pass over the list. Returns the number of
+    // blocks stored in out (fewer than count once the map is exhausted)
+    size_t allocate_bulk (size_t n_bytes, size_t count, void **out)
+    {
+    	block_h *last, *curr;
+    	size_t const unit_size = sizeof(block_h);
+        size_t n_done = 0;
+
+        // Check: Validity of fields
+        if (d_allocator_info_p == nullptr || 
+            d_allocator_info_p->capacity == 0) {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Check: Requested byte count
+    	if (n_bytes == 0) {
+            throw std::invalid_argument("Cannot allocate zero bytes");
+    	}
+
+    	// Compute blocks needed (one extra block for segment header)
+    	size_t n_blocks = units_for(n_bytes);
+
+    	// If uninitialized: Create initial list structure
+    	if (d_allocator_info_p->free_list == 0) {
+            build_free_list();
+    	}
+
+        stats_counters_t &c = stats_begin();
+        size_t n_visited = 0, n_units = 0;
+
+    	// Walk the list once, ending with the block the walk started from
+        block_h *start = Policy::roving ? block_at(d_allocator_info_p->free_list) :
+            block_at(d_allocator_info_p->free_memory_map);
+        last = start;
+    	for (curr = block_at(last->d.next); n_done < count; curr = block_at(last->d.next)) {
+            bool at_start = (curr == start);
+            size_t curr_units = units_of(curr);
+            n_visited++;
+
+    		// Case: Enough space for at least one block
+    		if (curr_units >= n_blocks) {
+                size_t k = std::min(count - n_done, curr_units / n_blocks);
+                size_t remainder = curr_units - k * n_blocks;
+                block_h *end = curr + curr_units;
+                expose_units(curr, curr_units);
+
+                // Successor no longer follows a free block
+                end->d.size &= ~FLAG_PREV_FREE;
+
+                // Carve k blocks from the tail, lowest address first in out
+                for (size_t i = 1; i < k; ++i) {
+                    block_h *b = end - i * n_blocks;
+                    b->d.size = n_blocks;
+                    out[n_done + k - i] = hand_out(b, n_bytes);
+                }
+
+                // Case: Remainder too small to hold a block. The lowest block
+                // absorbs it and takes over curr's place in the map
+                block_h *b = end - k * n_blocks;
+                if (remainder < MIN_BLOCK_UNITS) {
+                    unlink(curr);
+                    stats_add(c.n_free_blocks, static_cast<size_t>(-1));
+                    b = curr;
+                    b->d.size = n_blocks + remainder;
+                    n_units += curr_units;
+                } else {
+                // Case: Remainder stays on the list
+                    b->d.size = n_blocks | FLAG_PREV_FREE;
+                    curr->d.size = remainder | FLAG_FREE;
+                    set_footer(curr);
+                    refile_block(curr);
+                    hide_free_block(curr);
+                    n_units += k * n_blocks;
+                    last = curr;
+                }
+                out[n_done] = hand_out(b, n_bytes);
+                n_done += k;
+    		} else {
+                last = curr;
+            }
+
+    		// Case: Back at the start, no more blocks to be found
+    		if (at_start) {
+    			break;
+    		}
+    	}
+
+        // Reassign free list head
+        d_allocator_info_p->free_list = offset_of(last);
+
+    	// Update amount of free memory available
+    	d_allocator_info_p->free_size -= n_units * unit_size;
+
+        // Update counters (one search for the whole batch)
+        size_t used_bytes = c.used_bytes.load(std::memory_order_relaxed)
+            + n_units * unit_size;
+        c.used_bytes.store(used_bytes, std::memory_order_relaxed);
+        if (used_bytes > c.peak_used_bytes.load(std::memory_order_relaxed)) {
+            c.peak_used_bytes.store(used_bytes, std::memory_order_relaxed);
+        }
+        stats_bound_largest(c);
+        bool retry = (n_done < count && d_allocator_info_p->n_quick > 0);
+        stats_add(c.n_allocations, n_done);
+        stats_add(c.n_failed, (n_done < count && !retry) ? 1 : 0);
+        stats_search(c, n_visited);
+        stats_end(c);
+
+        // Case: Short, but quick-listed blocks may merge into large enough ones
+        if (retry) {
+            consolidate();
+            n_done += allocate_bulk(n_bytes, count - n_done, out + n_done);
+        }
+
+        return n_done;
+    }
+
+    // Allocate #6: Typeless allocation of n bytes at the start of the lowest
+    // free block that fits, for blocks that are never freed: they then stay
+    // clear of the end of the map, which truncate() can give back. Searches
+    // the whole free list, and skips the quick lists
+    void_pointer allocate_low (size_t n_bytes)
+    {
+        // Check: Validity of fields
+        if (d_allocator_info_p == nullptr ||
+            d_allocator_info_p->capacity == 0) {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Check: Requested byte count
+        if (n_bytes == 0) {
+            throw std::invalid_argument("Cannot allocate zero bytes");
+        }
+
+        // Compute blocks needed (one extra block for segment header)
+        size_t n_blocks = units_for(n_bytes);
+
+        // If uninitialized: Create initial list structure
+        if (d_allocator_info_p->free_list == 0) {
+            build_free_list();
+        }
+
+        // Find the lowest block that fits (the list head is never a fit)
+        size_t n_visited = 0;
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        block_h *lowest = nullptr;
+        for (block_h *curr = block_at(head->d.next); curr != head;
+            curr = block_at(curr->d.next))
+        {
+            n_visited++;
+            if (units_of(curr) >= n_blocks && (lowest == nullptr || curr < lowest)) {
+                lowest = curr;
+            }
+        }
+
+        // Case: No block found
+        if (lowest == nullptr) {
+
+            // Case: Quick-listed blocks may merge into a large enough one
+            if (d_allocator_info_p->n_quick > 0) {
+                consolidate();
+                return allocate_low(n_bytes);
+            }
+
+            stats_counters_t &c = stats_begin();
+            stats_add(c.n_failed, 1);
+            stats_search(c, n_visited);
+            stats_end(c);
+            ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_ALLOCATE_FAILED,
+                n_bytes, d_allocator_info_p->free_size);
+            return NULL;
+        }
+
+        return carve(lowest, 0, n_blocks, n_bytes, n_visited);
+    }
+
+    // Convert a reference to a pointer
+    pointer address (reference r) const
+    {
+    	return static_cast<pointer>(std::addressof(r));
+    }
+
+    // Converts a reference to a const pointer
+    const_pointer address (const_reference r) const
+    {
+    	return static_cast<const_pointer>(std::addressof(r));
+    }
+
+    // Deallocate
+    void deallocate (pointer ptr, size_type n_obj)
+    {
+    	block_h *b;
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Parameter check: Is pointer valid
+    	if (ptr == nullptr) {
+            throw std::invalid_argument("Cannot free nullptr!");
+    	}
+
+    	// Address range of returned object
+        uint8_t *obj_addr_start = reinterpret_cast<uint8_t *>(ptr);
+        uint8_t *obj_addr_end   = obj_addr_start + (n_obj * sizeof(T));
+
+        // Address of range of static memory block
+        uint8_t *static_addr_start = 
+            reinterpret_cast<uint8_t *>(d_allocator_info_p);
+        uint8_t *static_addr_end = static_addr_start + (d_allocator_info_p->capacity);
+    	
+        // Parameter check: Pointer address range
+    	if (!(obj_addr_start > static_addr_start && 
+            obj_addr_end <= static_addr_end))
+    	{
+            throw std::invalid_argument("Pointer originates outside valid bounds");  		
+    	}
+
+    	// Block header
+    	b = (reinterpret_cast<block_h *>(ptr)) - 1;
+        if constexpr (Policy::checked) {
+            check_block(b, n_obj * sizeof(T));
+        }
+        ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_DEALLOCATE,
+            n_obj * sizeof(T), offset_of(b));
+
+        stats_counters_t &c = stats_begin();
+        stats_add(c.n_deallocations, 1);
+        free_block(b, c);
+        stats_end(c);
+
+        // Case: Quick lists too long, merge a bounded batch
+        if (d_allocator_info_p->n_quick > ALLOCATOR_QUICK_LIMIT) {
+            consolidate(ALLOCATOR_QUICK_BATCH);
+        }
+    }
+
+    // Deallocate count blocks of n bytes each (e.g. from allocate_bulk)
+    void deallocate_bulk (void * const *ptrs, size_t count, size_t n_bytes)
+    {
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Address of range of static memory block
+        uint8_t *static_addr_start = 
+            reinterpret_cast<uint8_t *>(d_allocator_info_p);
+        uint8_t *static_addr_end = static_addr_start + (d_allocator_info_p->capacity);
+
+        // Parameter check: Every pointer is valid (before releasing any)
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t *obj_addr_start = reinterpret_cast<uint8_t *>(ptrs[i]);
+            if (!(obj_addr_start > static_addr_start &&
+                obj_addr_start + n_bytes <= static_addr_end))
+            {
+                throw std::invalid_argument("Pointer originates outside valid bounds");
+            }
+        }
+
+        // Check: Every block intact and listed once (a block is claimed by
+        // clearing its magic, which is restored if the batch is refused)
+        if constexpr (Policy::checked) {
+            for (size_t i = 0; i < count; ++i) {
+                block_h *b = reinterpret_cast<block_h *>(ptrs[i]) - 1;
+                try {
+                    check_block(b, n_bytes);
+                } catch (...) {
+                    for (size_t j = 0; j < i; ++j) {
+                        block_h *claimed = reinterpret_cast<block_h *>(ptrs[j]) - 1;
+                        claimed->d.next = BLOCK_MAGIC ^ offset_of(claimed);
+                    }
+                    throw;
+                }
+                b->d.next = 0;
+            }
+        }
+
+        stats_counters_t &c = stats_begin();
+        for (size_t i = 0; i < count; ++i) {
+            ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_DEALLOCATE,
+                n_bytes, offset_of(reinterpret_cast<block_h *>(ptrs[i]) - 1));
+            free_block(reinterpret_cast<block_h *>(ptrs[i]) - 1, c);
+        }
+        stats_add(c.n_deallocations, count);
+        stats_end(c);
+
+        // Case: Quick lists too long, merge a bounded batch
+        if (d_allocator_info_p->n_quick > ALLOCATOR_QUICK_LIMIT) {
+            consolidate(ALLOCATOR_QUICK_BATCH);
+        }
+    }
+
+    // Merge up to max_blocks quick-listed blocks back into the free list,
+    // visiting the lists in turn. Returns the number of blocks merged
+    size_t consolidate (size_t max_blocks = SIZE_MAX)
+    {
+        size_t n_done = 0;
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Case: Nothing to merge
+        if (d_allocator_info_p->n_quick == 0 || max_blocks == 0) {
+            return 0;
+        }
+
+    	// If uninitialized: Create initial list structure
+    	if (d_allocator_info_p->free_list == 0) {
+            build_free_list();
+    	}
+
+        stats_counters_t &c = stats_begin();
+        size_t k = d_allocator_info_p->quick_next;
+        for (size_t i = 0; i < ALLOCATOR_QUICK_LISTS && n_done < max_blocks; ++i) {
+            k = (d_allocator_info_p->quick_next + i) % ALLOCATOR_QUICK_LISTS;
+            size_t &head = d_allocator_info_p->quick_lists[k];
+            while (head != 0 && n_done < max_blocks) {
+                block_h *b = block_at(head);
+                head = b->d.next;
+                b->d.size &= ~FLAG_QUICK;
+                release_block(b, c, true);
+                n_done++;
+            }
+        }
+        d_allocator_info_p->quick_next = (k + 1) % ALLOCATOR_QUICK_LISTS;
+        d_allocator_info_p->n_quick -= n_done;
+        stats_add(c.n_quick_blocks, static_cast<size_t>(0) - n_done);
+        stats_end(c);
+
+        return n_done;
+    }
+
+    // Enable or disable deferred coalescing. Disabling merges every block
+    // still held in a quick list
+    void set_deferred_coalescing (bool enable)
+    {
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        d_allocator_info_p->deferred = enable;
+        if (!enable) {
+            consolidate();
+        }
+    }
+
+    // Enable or disable annotations of this map in annotated builds (see
+    // allocator_annotate.cpp), where they are enabled by default. Must be set
+    // before any block is allocated. Disabling makes the whole map accessible
+    // again, as required before the memory of the map is reused or unmapped
+    void set_annotations (bool enable)
+    {
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Case: Disable, exposing the map
+        if (!enable && annotated()) {
+            ALLOCATOR_ANNOTATE_TAGS(d_allocator_info_p, d_allocator_info_p->capacity);
+        }
+        d_allocator_info_p->annotated = enable;
+
+        // Case: Enabled on a built list, hide the free blocks
+        if (enable && annotated() && d_allocator_info_p->free_list != 0) {
+            block_h *head = block_at(d_allocator_info_p->free_memory_map);
+            for (block_h *b = block_at(head->d.next); b != head; b = block_at(b->d.next)) {
+                hide_free_block(b);
+            }
+        }
+    }
+
+    // Make the capacity bytes of a map at static_memory_map accessible to
+    // memory checkers again (annotated builds), leaving no poison behind. Must
+    // be called once the map is no longer used, before the caller's storage
+    // is reused, unmapped or goes out of scope
+    static void unannotate (void *static_memory_map, size_t capacity)
+    {
+        ALLOCATOR_ANNOTATE_TAGS(static_memory_map, capacity);
+    }
+
+    // Grow a block in place into its free successor. Returns false (and
+    // leaves the block untouched) if the successor is in use or too small
+    bool try_expand (pointer ptr, size_type old_n, size_type new_n)
+    {
+    	size_t const unit_size = sizeof(block_h);
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Parameter check: Is pointer valid
+    	if (ptr == nullptr || new_n == 0) {
+            throw std::invalid_argument("Cannot expand nullptr or to zero objects!");
+    	}
+
+        block_h *b = (reinterpret_cast<block_h *>(ptr)) - 1;
+        size_t b_units = units_of(b);
+        size_t n_blocks = units_for(new_n * sizeof(T));
+
+        if constexpr (Policy::checked) {
+            check_block(b, old_n * sizeof(T));
+        }
+
+        // Case: Already large enough
+        if (n_blocks <= b_units) {
+            resize_payload(b, old_n * sizeof(T), new_n * sizeof(T));
+            if constexpr (Policy::checked) {
+                set_canary(b, new_n * sizeof(T));
+            }
+            return true;
+        }
+
+        // Case: Successor in use or too small
+        block_h *n = b + b_units;
+        size_t n_units = units_of(n);
+        if (!is_free(n) || b_units + n_units < n_blocks) {
+            return false;
+        }
+
+        stats_counters_t &c = stats_begin();
+        size_t remainder = b_units + n_units - n_blocks;
+        expose_units(n, n_units);
+
+        // Case: Remainder too small to hold a block. Absorb the successor
+        if (remainder < MIN_BLOCK_UNITS) {
+            if (d_allocator_info_p->free_list == offset_of(n)) {
+                d_allocator_info_p->free_list = prev_of(n);
+            }
+            unlink(n);
+            n_blocks = b_units + n_units;
+            (b + n_blocks)->d.size &= ~FLAG_PREV_FREE;
+            stats_add(c.n_free_blocks, static_cast<size_t>(-1));
+        } else {
+        // Case: Move the successor's start up, keeping its place in the list
+            unfile_block(n);
+            size_t next = n->d.next, prev = prev_of(n);
+            block_h *m = b + n_blocks;
+            m->d.size = remainder | FLAG_FREE;
+            m->d.next = next;
+            prev_of(m) = prev;
+            block_at(prev)->d.next = offset_of(m);
+            prev_of(block_at(next)) = offset_of(m);
+            set_footer(m);
+            file_block(m);
+            hide_free_block(m);
+            if (d_allocator_info_p->free_list == offset_of(n)) {
+                d_allocator_info_p->free_list = offset_of(m);
+            }
+        }
+
+        // Grow the block (it keeps its FLAG_PREV_FREE)
+        b->d.size = n_blocks | (b->d.size & FLAG_PREV_FREE);
+        d_allocator_info_p->free_size -= (n_blocks - b_units) * unit_size;
+
+        // Update counters
+        size_t used_bytes = c.used_bytes.load(std::memory_order_relaxed)
+            + (n_blocks - b_units) * unit_size;
+        c.used_bytes.store(used_bytes, std::memory_order_relaxed);
+        if (used_bytes > c.peak_used_bytes.load(std::memory_order_relaxed)) {
+            c.peak_used_bytes.store(used_bytes, std::memory_order_relaxed);
+        }
+        stats_bound_largest(c);
+        stats_end(c);
+
+        resize_payload(b, old_n * sizeof(T), new_n * sizeof(T));
+        if constexpr (Policy::checked) {
+            set_canary(b, new_n * sizeof(T));
+        }
+        return true;
+    }
+
+    // Shrink a block in place, returning its tail to the map. Returns false
+    // if the tail is too small to form a block (the block is then unchanged)
+    bool shrink_in_place (pointer ptr, size_type old_n, size_type new_n)
+    {
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+    	// Parameter check: Is pointer valid
+    	if (ptr == nullptr || new_n == 0) {
+            throw std::invalid_argument("Cannot shrink nullptr or to zero objects!");
+    	}
+
+        block_h *b = (reinterpret_cast<block_h *>(ptr)) - 1;
+        size_t b_units = units_of(b);
+        size_t n_blocks = units_for(new_n * sizeof(T));
+
+        if constexpr (Policy::checked) {
+            check_block(b, old_n * sizeof(T));
+        }
+
+        // Case: Tail too small to hold a block
+        if (n_blocks > b_units || b_units - n_blocks < MIN_BLOCK_UNITS) {
+            return false;
+        }
+
+        // Split off the tail as an allocated block, then release it
+        block_h *tail = b + n_blocks;
+        expose_units(tail, b_units - n_blocks);
+        tail->d.size = b_units - n_blocks;
+        b->d.size = n_blocks | (b->d.size & FLAG_PREV_FREE);
+        resize_payload(b, old_n * sizeof(T), new_n * sizeof(T));
+        if constexpr (Policy::checked) {
+            set_canary(b, new_n * sizeof(T));
+            poison(tail);
+        }
+
+        stats_counters_t &c = stats_begin();
+        release_block(tail, c);
+        stats_end(c);
+
+        return true;
+    }
+
+    // Allocate at least n_obj objects: the count returned includes the slack
+    // of the block (e.g. when too small a remainder was absorbed)
+    allocation_result_t<pointer> allocate_at_least (size_type n_obj)
+    {
+        pointer ptr = allocate(n_obj);
+
+        if (ptr == nullptr) {
+            return allocation_result_t<pointer>{ptr, 0};
+        }
+
+        // Objects fitting the block (the canary, if any, moves past them)
+        block_h *b = (reinterpret_cast<block_h *>(ptr)) - 1;
+        size_t count = ((units_of(b) - 1) * sizeof(block_h) - CANARY_SIZE) / sizeof(T);
+        resize_payload(b, n_obj * sizeof(T), count * sizeof(T));
+        if constexpr (Policy::checked) {
+            set_canary(b, count * sizeof(T));
+        }
+        return allocation_result_t<pointer>{ptr, count};
+    }
+
+    // Grow the map in place to new_capacity bytes (the memory past the old
+    // capacity must be valid). The added space merges with a free last
+    // block. Returns false if too little is added to form a block
+    bool extend (size_t new_capacity)
+    {
+        size_t const unit_size = sizeof(block_h);
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr || d_allocator_info_p->capacity == 0)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Parameter check: Map grows
+        if (new_capacity < d_allocator_info_p->capacity) {
+            throw std::invalid_argument("Cannot extend to a smaller capacity");
+        }
+        if (Policy::segregated && new_capacity / sizeof(block_h) > SEGREGATED_MAX_UNITS) {
+            throw std::invalid_argument("Map too large for segregated size classes");
+        }
+
+        // Whole units between the list head and the fence, before and after
+        size_t info_size = d_allocator_info_p->free_memory_map;
+        size_t old_units = (d_allocator_info_p->capacity - info_size) / unit_size
+            - (MIN_BLOCK_UNITS + 1);
+        size_t n_added = (new_capacity - info_size) / unit_size - (MIN_BLOCK_UNITS + 1)
+            - old_units;
+
+        // Case: Not enough for a block
+        if (n_added < MIN_BLOCK_UNITS) {
+            return false;
+        }
+
+        d_allocator_info_p->capacity = new_capacity;
+
+        // Case: List not yet built, its first block simply starts out larger
+        if (d_allocator_info_p->free_list == 0) {
+            stats_counters_t &c = stats_begin();
+            d_allocator_info_p->free_size += n_added * unit_size;
+            c.largest_free_block.store(d_allocator_info_p->free_size, std::memory_order_relaxed);
+            stats_end(c);
+            return true;
+        }
+
+        // The old fence becomes an in-use block before the new fence (written
+        // first, see recover()), then the block is released
+        block_h *b = block_at(d_allocator_info_p->free_memory_map) + MIN_BLOCK_UNITS + old_units;
+        expose_units(b, n_added + 1);
+        (b + n_added)->d.size = 0;
+        b->d.size = n_added | (b->d.size & FLAG_PREV_FREE);
+
+        stats_counters_t &c = stats_begin();
+        d_allocator_info_p->free_size += n_added * unit_size;
+        release_block(b, c, true);
+        stats_end(c);
+
+        return true;
+    }
+
+    // Shrink the map to new_capacity bytes, giving up the end of a free last
+    // block. Returns false (leaving the map unchanged) if anything in use, or
+    // too small a free remainder, lies past the new capacity
+    bool truncate (size_t new_capacity)
+    {
+        size_t const unit_size = sizeof(block_h);
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr || d_allocator_info_p->capacity == 0)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Parameter check: Map shrinks
+        if (new_capacity > d_allocator_info_p->capacity) {
+            throw std::invalid_argument("Cannot truncate to a larger capacity");
+        }
+
+        // Whole units between the list head and the fence, before and after
+        size_t info_size = d_allocator_info_p->free_memory_map;
+        if (new_capacity < info_size + (2 * MIN_BLOCK_UNITS + 1) * unit_size) {
+            return false;
+        }
+        size_t old_units = (d_allocator_info_p->capacity - info_size) / unit_size
+            - (MIN_BLOCK_UNITS + 1);
+        size_t new_units = (new_capacity - info_size) / unit_size - (MIN_BLOCK_UNITS + 1);
+        size_t n_removed = old_units - new_units;
+
+        // Case: List not yet built, its first block simply starts out smaller
+        if (d_allocator_info_p->free_list == 0) {
+            stats_counters_t &c = stats_begin();
+            d_allocator_info_p->capacity = new_capacity;
+            d_allocator_info_p->free_size -= n_removed * unit_size;
+            c.largest_free_block.store(d_allocator_info_p->free_size, std::memory_order_relaxed);
+            stats_end(c);
+            return true;
+        }
+
+        // Check: Last block is free and starts low enough
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        block_h *fence = head + MIN_BLOCK_UNITS + old_units;
+        if (!(fence->d.size & FLAG_PREV_FREE)) {
+            return n_removed == 0;
+        }
+        block_h *last = fence - (fence - 1)->d.size;
+        block_h *new_fence = head + MIN_BLOCK_UNITS + new_units;
+        size_t n_kept = (new_fence > last) ? new_fence - last : 0;
+        if (new_fence < last || (n_kept > 0 && n_kept < MIN_BLOCK_UNITS)) {
+            return false;
+        }
+
+        stats_counters_t &c = stats_begin();
+        expose_units(last, fence + 1 - last);
+
+        // Case: Whole block given up (its predecessor is in use)
+        if (n_kept == 0) {
+            if (d_allocator_info_p->free_list == offset_of(last)) {
+                d_allocator_info_p->free_list = prev_of(last);
+            }
+            unlink(last);
+            new_fence->d.size = 0;
+            stats_add(c.n_free_blocks, static_cast<size_t>(-1));
+        } else {
+        // Case: Block keeps its start (new fence first, see recover())
+            new_fence->d.size = FLAG_PREV_FREE;
+            last->d.size = n_kept | FLAG_FREE;
+            set_footer(last);
+            refile_block(last);
+            hide_free_block(last);
+        }
+
+        d_allocator_info_p->capacity = new_capacity;
+        d_allocator_info_p->free_size -= n_removed * unit_size;
+        stats_bound_largest(c);
+        stats_end(c);
+
+        return true;
+    }
+
+    // Return the pages inside free blocks to the OS with madvise(advice):
+    // MADV_DONTNEED or MADV_FREE for private memory, MADV_REMOVE for shared
+    // memory. The boundary tags stay resident and the pages fault back in
+    // (zeroed) when reused. Only blocks with at least min_bytes of whole
+    // pages are trimmed. Returns the number of bytes advised
+    size_t trim (size_t min_bytes = 0, int advice = MADV_DONTNEED)
+    {
+        size_t const page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t n_trimmed = 0;
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr || d_allocator_info_p->capacity == 0)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Case: List not yet built, the map was never touched
+        if (d_allocator_info_p->free_list == 0) {
+            return 0;
+        }
+
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        for (block_h *b = block_at(head->d.next); b != head; b = block_at(b->d.next)) {
+
+            // Pages between the back link and the footer
+            uintptr_t start = reinterpret_cast<uintptr_t>(b + MIN_BLOCK_UNITS);
+            uintptr_t end = reinterpret_cast<uintptr_t>(b + units_of(b) - 1);
+            start = (start + page_size - 1) & ~(page_size - 1);
+            end &= ~(page_size - 1);
+
+            if (end <= start || end - start < std::max(min_bytes, page_size)) {
+                continue;
+            }
+            if (madvise(reinterpret_cast<void *>(start), end - start, advice) == -1) {
+                throw std::system_error(errno, std::generic_category(), "madvise");
+            }
+            n_trimmed += end - start;
+        }
+
+        return n_trimmed;
+    }
+
+    // Rebuild the free list, boundary tags, quick lists and counters from the
+    // block headers alone, e.g. after a crash left the links half updated.
+    // Quick-listed blocks are freed. Throws std::runtime_error if the headers
+    // do not chain from the list head to the fence
+    size_t recover ()
+    {
+        size_t const unit_size = sizeof(block_h);
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr || d_allocator_info_p->capacity == 0)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Quick lists are dropped, their blocks are free by their flag
+        for (size_t i = 0; i < ALLOCATOR_QUICK_LISTS; ++i) {
+            d_allocator_info_p->quick_lists[i] = 0;
+        }
+        d_allocator_info_p->n_quick = 0;
+        d_allocator_info_p->quick_next = 0;
+
+        // A crash may have left the sequence lock odd
+        stats_counters_t &c = d_allocator_info_p->stats;
+        c.seq.store(0, std::memory_order_relaxed);
+
+        // Case: List never built, the map is untouched
+        if (d_allocator_info_p->free_list == 0) {
+            return 0;
+        }
+
+        // Bounds: Whole units between the list head and the fence
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        size_t n_units = (d_allocator_info_p->capacity - d_allocator_info_p->free_memory_map)
+            / unit_size - (MIN_BLOCK_UNITS + 1);
+        block_h *fence = head + MIN_BLOCK_UNITS + n_units;
+
+        // Annotations: The whole map is exposed, free blocks hidden once rebuilt
+        expose_units(head, fence + 1 - head);
+
+        head->d.size = 0;
+        head->d.next = prev_of(head) = offset_of(head);
+        reset_bins();
+
+        size_t free_units = 0, used_units = 0, largest = 0, n_free = 0;
+        block_h *last = head, *run = nullptr;
+
+        // Walk the blocks in address order, merging runs of free blocks
+        for (block_h *b = head + MIN_BLOCK_UNITS; b != fence; ) {
+            size_t units = units_of(b);
+
+            // Check: Header chains within the map
+            if (units < MIN_BLOCK_UNITS || units > static_cast<size_t>(fence - b)) {
+                throw std::runtime_error("Corrupt block header in map");
+            }
+
+            // Case: Free (or quick-listed), extending the current run
+            if (b->d.size & (FLAG_FREE | FLAG_QUICK)) {
+                if (run == nullptr) {
+                    run = b;
+                    run->d.size = units | FLAG_FREE;
+                    link_after(last, run);
+                    last = run;
+                    n_free++;
+                } else {
+                    run->d.size += units;
+                }
+            } else {
+            // Case: In use, closing the current run
+                if (run != nullptr) {
+                    set_footer(run);
+                    free_units += units_of(run);
+                    largest = std::max(largest, units_of(run));
+                }
+                b->d.size = units | ((run != nullptr) ? FLAG_PREV_FREE : 0);
+                used_units += units;
+                run = nullptr;
+            }
+            b += units;
+        }
+
+        // Close the final run at the fence
+        if (run != nullptr) {
+            set_footer(run);
+            free_units += units_of(run);
+            largest = std::max(largest, units_of(run));
+        }
+        fence->d.size = (run != nullptr) ? FLAG_PREV_FREE : 0;
+
+        // Runs were filed at the size of their first block, file them whole
+        reset_bins();
+        for (block_h *b = block_at(head->d.next); b != head; b = block_at(b->d.next)) {
+            file_block(b);
+            hide_free_block(b);
+        }
+
+        d_allocator_info_p->free_list = offset_of(head);
+        d_allocator_info_p->free_size = free_units * unit_size;
+
+        // Re-derive the gauges (the event counters are kept)
+        c.used_bytes.store(used_units * unit_size, std::memory_order_relaxed);
+        c.peak_used_bytes.store(std::max(c.peak_used_bytes.load(std::memory_order_relaxed),
+            used_units * unit_size), std::memory_order_relaxed);
+        c.largest_free_block.store(largest * unit_size, std::memory_order_relaxed);
+        c.n_free_blocks.store(n_free, std::memory_order_relaxed);
+        c.n_quick_blocks.store(0, std::memory_order_relaxed);
+
+        return n_free;
+    }
+
+    // Record owner (non-zero, e.g. the process the block belongs to, or 0 for
+    // none) in the header of the block in use at ptr, for reclaim(). Blocks
+    // start without an owner. Unchecked policies only, as checked mode keeps
+    // its magic in the same field
+    void set_owner (void *ptr, size_t owner)
+    {
+        static_assert(!Policy::checked, "Checked blocks cannot record an owner");
+
+        // Parameter check: Is pointer valid
+        if (ptr == nullptr) {
+            throw std::invalid_argument("Cannot set owner of nullptr!");
+        }
+        (reinterpret_cast<block_h *>(ptr) - 1)->d.next = owner;
+    }
+
+    // Owner recorded for the block in use at ptr (0 if none)
+    size_t owner_of (void const *ptr) const
+    {
+        static_assert(!Policy::checked, "Checked blocks cannot record an owner");
+
+        // Parameter check: Is pointer valid
+        if (ptr == nullptr) {
+            throw std::invalid_argument("Cannot get owner of nullptr!");
+        }
+        return (reinterpret_cast<block_h const *>(ptr) - 1)->d.next;
+    }
+
+    // Free every block in use whose owner (if any) satisfies gone(owner), e.g.
+    // after the owning process died. Returns the number of blocks freed.
+    // Walks the whole map
+    template <class Predicate>
+    size_t reclaim (Predicate gone)
+    {
+        static_assert(!Policy::checked, "Checked blocks cannot record an owner");
+        std::vector<block_h *> orphans;
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr || d_allocator_info_p->capacity == 0)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Case: List never built, nothing was ever allocated
+        if (d_allocator_info_p->free_list == 0) {
+            return 0;
+        }
+
+        // Collect first, as freeing merges headers into free blocks
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        for (block_h *b = head + MIN_BLOCK_UNITS; units_of(b) != 0; b += units_of(b)) {
+            if (!is_free(b) && (b->d.size & FLAG_QUICK) == 0 && b->d.next != 0 &&
+                gone(b->d.next))
+            {
+                orphans.push_back(b);
+            }
+        }
+
+        stats_counters_t &c = stats_begin();
+        for (block_h *b : orphans) {
+            ALLOCATOR_TRACE_EVENT(&(d_allocator_info_p->trace), TRACE_DEALLOCATE,
+                (units_of(b) - 1) * sizeof(block_h), offset_of(b));
+            stats_add(c.n_deallocations, 1);
+            free_block(b, c);
+        }
+        stats_end(c);
+
+        return orphans.size();
+    }
+
+    // Visit the blocks in address order: fn(offset, n_bytes, state), with the
+    // block header included in n_bytes. Only reads the map, so it may run on
+    // a read-only mapping while another process allocates from the map: each
+    // header is read once and bounds-checked, and the walk stops at the first
+    // one that does not chain (torn by a concurrent update). Returns whether
+    // the fence was reached
+    template <class F>
+    bool for_each_block (F fn) const
+    {
+        size_t const unit_size = sizeof(block_h);
+
+        // Case: List never built, the map is untouched
+        if (d_allocator_info_p == nullptr || d_allocator_info_p->capacity == 0 ||
+            d_allocator_info_p->free_list == 0) {
+            return false;
+        }
+
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        size_t n_units = (d_allocator_info_p->capacity - d_allocator_info_p->free_memory_map)
+            / unit_size - (MIN_BLOCK_UNITS + 1);
+        block_h *fence = head + MIN_BLOCK_UNITS + n_units;
+
+        for (block_h *b = head + MIN_BLOCK_UNITS; b != fence; ) {
+            size_t size = b->d.size;
+            size_t units = size & SIZE_MASK;
+
+            // Check: Header chains within the map
+            if (units < MIN_BLOCK_UNITS || units > static_cast<size_t>(fence - b)) {
+                return false;
+            }
+
+            fn(offset_of(b), units * unit_size, (size & FLAG_FREE) ? BLOCK_FREE :
+                ((size & FLAG_QUICK) ? BLOCK_QUICK : BLOCK_USED));
+            b += units;
+        }
+        return true;
+    }
+
+    // Verify the map: the headers chain from the list head to the fence,
+    // flags and footers agree with the neighbours, and the free and quick
+    // lists hold exactly the free and quick-listed blocks. Lists are walked
+    // at most once per block, so a corrupt ring cannot hang the check. Throws
+    // std::runtime_error at the first inconsistency. Walks the whole map
+    void validate () const
+    {
+        size_t const unit_size = sizeof(block_h);
+
+        // Check: Validity of state
+        if (d_allocator_info_p == nullptr || d_allocator_info_p->capacity == 0)
+        {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Case: List never built, the map is untouched
+        if (d_allocator_info_p->free_list == 0) {
+            return;
+        }
+
+        // Bounds: Whole units between the list head and the fence
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        size_t n_units = (d_allocator_info_p->capacity - d_allocator_info_p->free_memory_map)
+            / unit_size - (MIN_BLOCK_UNITS + 1);
+        block_h *fence = head + MIN_BLOCK_UNITS + n_units;
+
+        size_t n_free = 0, n_quick = 0, free_units = 0;
+        bool prev_free = false;
+
+        // Walk the blocks in address order
+        for (block_h *b = head + MIN_BLOCK_UNITS; b != fence; ) {
+            size_t units = units_of(b);
+
+            // Check: Header chains within the map
+            if (units < MIN_BLOCK_UNITS || units > static_cast<size_t>(fence - b)) {
+                throw std::runtime_error("Corrupt block header in map");
+            }
+
+            // Check: Boundary tags
+            if (((b->d.size & FLAG_PREV_FREE) != 0) != prev_free) {
+                throw std::runtime_error("Block flag disagrees with its predecessor");
+            }
+            if (is_free(b) && (prev_free || (b->d.size & FLAG_QUICK) != 0 ||
+                (b + units - 1)->d.size != units))
+            {
+                throw std::runtime_error("Corrupt free block in map");
+            }
+
+            if (is_free(b)) {
+                n_free++;
+                free_units += units;
+            } else if (b->d.size & FLAG_QUICK) {
+                n_quick++;
+                free_units += units;
+            }
+            prev_free = is_free(b);
+            b += units;
+        }
+
+        // Check: Fence and counters
+        if (units_of(fence) != 0 || ((fence->d.size & FLAG_PREV_FREE) != 0) != prev_free) {
+            throw std::runtime_error("Corrupt fence in map");
+        }
+        if (free_units * unit_size != d_allocator_info_p->free_size ||
+            n_quick != d_allocator_info_p->n_quick)
+        {
+            throw std::runtime_error("Free byte count disagrees with the blocks");
+        }
+
+        // Whether a link is the offset of a unit within the list
+        auto valid_link = [&](size_t offset) {
+            return offset >= offset_of(head) && offset < offset_of(fence) &&
+                (offset - offset_of(head)) % unit_size == 0;
+        };
+
+        // Walk the free list: every free block once, back links symmetric
+        block_h *p = head;
+        for (size_t i = 0; ; ++i) {
+            if (!valid_link(p->d.next) || prev_of(block_at(p->d.next)) != offset_of(p)) {
+                throw std::runtime_error("Corrupt free list link");
+            }
+            block_h *n = block_at(p->d.next);
+            if (n == head) {
+                if (i != n_free) {
+                    throw std::runtime_error("Free list misses free blocks");
+                }
+                break;
+            }
+            if (i == n_free || !is_free(n)) {
+                throw std::runtime_error("Free list holds a block in use");
+            }
+            p = n;
+        }
+        if (!valid_link(d_allocator_info_p->free_list) ||
+            (block_at(d_allocator_info_p->free_list) != head &&
+            !is_free(block_at(d_allocator_info_p->free_list))))
+        {
+            throw std::runtime_error("Corrupt free list pointer");
+        }
+
+        // Segregated policy: Each free block filed once, in the bin of its
+        // class, and the bitmaps mark exactly the non-empty bins
+        if constexpr (Policy::segregated) {
+            segregated_bins_t const &s = *d_allocator_info_p;
+            size_t n_filed = 0;
+            for (size_t fl = 0; fl < SEGREGATED_FL_COUNT; ++fl) {
+                for (size_t sl = 0; sl < SEGREGATED_SL_COUNT; ++sl) {
+                    size_t link = word_offset(&(s.bins[fl][sl]));
+                    if ((s.bins[fl][sl] != 0) != (((s.sl_bitmap[fl] >> sl) & 1) != 0)) {
+                        throw std::runtime_error("Corrupt size-class bitmap");
+                    }
+                    for (size_t offset = s.bins[fl][sl]; offset != 0; ) {
+                        block_h *b = block_at(offset);
+                        size_t b_fl, b_sl;
+                        if (!valid_link(offset) || ++n_filed > n_free || !is_free(b) ||
+                            bin_link_of(b) != link)
+                        {
+                            throw std::runtime_error("Corrupt size-class bin");
+                        }
+                        size_class(units_of(b), b_fl, b_sl);
+                        if (b_fl != fl || b_sl != sl) {
+                            throw std::runtime_error("Free block filed in the wrong bin");
+                        }
+                        link = word_offset(&bin_next_of(b));
+                        offset = bin_next_of(b);
+                    }
+                }
+                if ((s.sl_bitmap[fl] != 0) != (((s.fl_bitmap >> fl) & 1) != 0)) {
+                    throw std::runtime_error("Corrupt size-class bitmap");
+                }
+            }
+            if (n_filed != n_free) {
+                throw std::runtime_error("Size-class bins miss free blocks");
+            }
+        }
+
+        // Walk the quick lists: each block quick-listed, of its list's size
+        size_t n_listed = 0;
+        for (size_t k = 0; k < ALLOCATOR_QUICK_LISTS; ++k) {
+            for (size_t offset = d_allocator_info_p->quick_lists[k]; offset != 0; ) {
+                block_h *b = block_at(offset);
+                if (!valid_link(offset) || ++n_listed > n_quick ||
+                    (b->d.size & (FLAG_FREE | FLAG_QUICK)) != FLAG_QUICK ||
+                    quick_index(units_of(b)) != k)
+                {
+                    throw std::runtime_error("Corrupt quick list");
+                }
+                offset = b->d.next;
+            }
+        }
+        if (n_listed != n_quick) {
+            throw std::runtime_error("Corrupt quick list");
+        }
+    }
+
+    // Number of available bytes
+    size_t free_size () const
+    {
+    	if (d_allocator_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        } else {
+            return d_allocator_info_p->free_size;
+        }
+    }
+
+    // Whether the memory is unified
+    bool unified () const
+    {
+        if (d_allocator_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        // Case: No memory, list not yet built, or blocks awaiting a merge
+        if (d_allocator_info_p->capacity == 0 ||
+            d_allocator_info_p->free_list == 0 ||
+            d_allocator_info_p->n_quick > 0) {
+            return false;
+        }
+
+        block_h *b = block_at(d_allocator_info_p->free_list);
+
+        return (block_at(block_at(b->d.next)->d.next) == b);
+    }
+
+    // Consistent snapshot of the counters. Lock-free: may be called from any
+    // thread or process while another one allocates from the map
+    allocator_stats_t stats () const
+    {
+        allocator_stats_t snapshot;
+
+        if (d_allocator_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        stats_counters_t const &c = d_allocator_info_p->stats;
+        size_t seq;
+
+        // Retry while an update is in progress or completed during the copy
+        do {
+            while ((seq = c.seq.load(std::memory_order_acquire)) & 1) {
+                // Spin
+            }
+
+            snapshot.n_allocations = c.n_allocations.load(std::memory_order_relaxed);
+            snapshot.n_deallocations = c.n_deallocations.load(std::memory_order_relaxed);
+            snapshot.n_failed = c.n_failed.load(std::memory_order_relaxed);
+            snapshot.used_bytes = c.used_bytes.load(std::memory_order_relaxed);
+            snapshot.peak_used_bytes = c.peak_used_bytes.load(std::memory_order_relaxed);
+            snapshot.largest_free_block = c.largest_free_block.load(std::memory_order_relaxed);
+            snapshot.n_free_blocks = c.n_free_blocks.load(std::memory_order_relaxed);
+            snapshot.n_quick_blocks = c.n_quick_blocks.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < ALLOCATOR_SEARCH_BUCKETS; ++i) {
+                snapshot.search_length[i] = c.search_length[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while (c.seq.load(std::memory_order_relaxed) != seq);
+
+        return snapshot;
+    }
+
+    // Bytes in the largest block on the free list (header included). Walks the
+    // list, so unlike stats() it must be serialised with allocation. Tightens
+    // the bound that stats() reports, which carving leaves stale
+    size_t largest_free_block ()
+    {
+        size_t units = 0;
+
+        if (d_allocator_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+
+        // Case: List not yet built, the map is one free block
+        if (d_allocator_info_p->free_list == 0) {
+            return d_allocator_info_p->free_size;
+        }
+
+        block_h *head = block_at(d_allocator_info_p->free_memory_map);
+        for (block_h *b = block_at(head->d.next); b != head; b = block_at(b->d.next)) {
+            units = std::max(units, units_of(b));
+        }
+
+        stats_counters_t &c = stats_begin();
+        c.largest_free_block.store(units * sizeof(block_h), std::memory_order_relaxed);
+        stats_end(c);
+
+        return units * sizeof(block_h);
+    }
+
+#if defined(ALLOCATOR_TRACE)
+    // Returns the trace ring installed in the map
+    trace_ring_t *trace_ring () const
+    {
+        if (d_allocator_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+        return &(d_allocator_info_p->trace);
+    }
+#endif
+
+#if defined(ALLOCATOR_PROFILE)
+    // Sample allocations at an average of one per n bytes (0 to stop),
+    // allocating the profile table in the map on first use. Throws
+    // std::bad_alloc if the map cannot hold the table
+    void set_sample_period (size_t n_bytes)
+    {
+        void *table;
+
+        if (d_allocator_info_p == nullptr) {
+            throw std::invalid_argument("Uninitialized static memory");
+        }
+
+        // Case: Table installed
+        if (d_allocator_info_p->profile != 0) {
+            profile_set_period(profile_table(), n_bytes);
+            return;
+        }
+        if (n_bytes == 0) {
+            return;
+        }
+
+        if ((table = allocate_low(sizeof(profile_table_t))) == nullptr) {
+            throw std::bad_alloc();
+        }
+        profile_table_init(static_cast<profile_table_t *>(table), n_bytes);
+        d_allocator_info_p->profile = static_cast<uint8_t *>(table) -
+            reinterpret_cast<uint8_t *>(d_allocator_info_p);
+    }
+
+    // Returns the profile table of the map (nullptr if sampling was never on)
+    profile_table_t *profile_table () const
+    {
+        if (d_allocator_info_p == nullptr) {
+            throw std::runtime_error("Uninitialized allocator information");
+        }
+        if (d_allocator_info_p->profile == 0) {
+            return nullptr;
+        }
+        return reinterpret_cast<profile_table_t *>(
+            reinterpret_cast<uint8_t *>(d_allocator_info_p) + d_allocator_info_p->profile);
     }
+#endif
 
     // Returns the allocator information
     allocator_info_t *allocator_info_p () const
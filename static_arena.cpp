@@ -0,0 +1,95 @@
+#if !defined(STATIC_ARENA_H)
+#define STATIC_ARENA_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  Arena embedding a Static_Allocator map of N bytes, aligned to Align, in it *
+ *  s own storage. The size is checked at compile time and the constructor is  *
+ *  constexpr: it only zeroes the storage. The first call to allocator() insta *
+ *  lls the allocator_info_t of a new map, computed by the compiler (the free  *
+ *  list itself is built on first allocation). An arena with static storage du *
+ *  ration is therefore zero-initialised, so it occupies bss rather than the e *
+ *  xecutable image and costs no initialisation at run time, and handles obtai *
+ *  ned from allocator() point at a fixed address, so their accesses inline to *
+ *  direct loads and stores. As with the Static_Allocator, access must be seri *
+ *  alised by the caller.                                                      *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+#include <cstddef>
+
+// Custom headers
+#include "static_allocator.cpp"
+
+
+template <size_t N, size_t Align = alignof(max_align_t), class Policy = Next_Fit>
+class Static_Arena
+{
+private:
+
+    // Alias: Allocator managing the storage
+    using allocator_type = Static_Allocator<uint8_t, Policy>;
+
+    static_assert(N >= allocator_type::MIN_CAPACITY,
+        "Arena too small for the allocator metadata and one block");
+    static_assert(Align >= alignof(max_align_t) && (Align & (Align - 1)) == 0,
+        "Arena alignment must be a power of two of at least alignof(max_align_t)");
+
+    // Structure: The map, starting with its information structure
+    typedef union storage_t {
+        typename allocator_type::allocator_info_t info;
+        uint8_t bytes[N];
+    } storage_t;
+
+    alignas(Align) storage_t d_storage;
+
+public:
+
+    // Constructor: Zero the storage (at compile time for static arenas). An
+    // all-zero information structure stands for a map not yet installed
+    constexpr Static_Arena () noexcept:
+        d_storage{}
+    {
+        // Nothing to do
+    }
+
+#if defined(ALLOCATOR_ANNOTATE)
+    // Destructor: Leave no annotations on the storage
+    ~Static_Arena ()
+    {
+        allocator_type::unannotate(&d_storage, N);
+    }
+#endif
+
+    Static_Arena (const Static_Arena &) = delete;
+    Static_Arena &operator= (const Static_Arena &) = delete;
+
+    // Allocator over the arena (valid for the lifetime of the arena). The
+    // first call installs the information structure of a new map
+    template <class U = uint8_t>
+    Static_Allocator<U, Policy> allocator ()
+    {
+        if (d_storage.info.capacity == 0) {
+            new (&(d_storage.info)) typename allocator_type::allocator_info_t(
+                allocator_type::initial_info(N));
+        }
+        return Static_Allocator<U, Policy>::attach(&d_storage);
+    }
+
+    // Capacity of the map
+    static constexpr size_t capacity ()
+    {
+        return N;
+    }
+};
+
+#endif
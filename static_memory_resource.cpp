@@ -0,0 +1,95 @@
+#if !defined(STATIC_MEMORY_RESOURCE_H)
+#define STATIC_MEMORY_RESOURCE_H
+
+/*
+ *******************************************************************************
+ *              (C) Copyright 2020 Delft University of Technology              *
+ * Created: 14/10/2026                                                         *
+ *                                                                             *
+ * Programmer(s):                                                              *
+ * - Charles Randolph                                                          *
+ *                                                                             *
+ * Description:                                                                *
+ *  std::pmr::memory_resource over a Static_Allocator map, for containers in s *
+ *  td::pmr. The resource holds only a handle to the allocator_info_t of the m *
+ *  ap, and two resources compare equal when they manage the same map, so pmr  *
+ *  containers over one map move and swap in O(1). As with the Static_Allocato *
+ *  r, access must be serialised by the caller, and alignments above sizeof(m  *
+ *  ax_align_t) need a map aligned to sizeof(max_align_t).                     *
+ *                                                                             *
+ *******************************************************************************
+*/
+
+
+#include <memory_resource>
+#include <new>
+
+// Custom headers
+#include "static_allocator.cpp"
+
+
+class Static_Memory_Resource: public std::pmr::memory_resource
+{
+private:
+
+    // Allocator managing the map
+    Static_Allocator<uint8_t> d_allocator;
+
+public:
+
+    // Constructor: Install a new map
+    Static_Memory_Resource (void *static_memory_map, size_t capacity):
+        d_allocator(static_memory_map, capacity)
+    {
+        // Nothing to do
+    }
+
+    // Constructor: Use an existing map
+    explicit Static_Memory_Resource (const Static_Allocator<uint8_t> &allocator):
+        d_allocator(allocator)
+    {
+        // Nothing to do
+    }
+
+    // Returns the allocator managing the map
+    Static_Allocator<uint8_t> allocator () const
+    {
+        return d_allocator;
+    }
+
+protected:
+
+    // Allocate (throws std::bad_alloc when the map is exhausted)
+    void *do_allocate (size_t n_bytes, size_t alignment) override
+    {
+        void *ptr;
+
+        // Case: Zero bytes (must still return a distinct pointer)
+        if ((ptr = d_allocator.allocate_aligned(n_bytes == 0 ? 1 : n_bytes,
+            alignment)) == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        return ptr;
+    }
+
+    // Deallocate
+    void do_deallocate (void *ptr, size_t n_bytes, size_t alignment) override
+    {
+        d_allocator.deallocate(reinterpret_cast<uint8_t *>(ptr),
+            n_bytes == 0 ? 1 : n_bytes);
+    }
+
+    // Whether memory from one resource may be freed by the other
+    bool do_is_equal (const std::pmr::memory_resource &other) const noexcept override
+    {
+        if (this == &other) {
+            return true;
+        }
+
+        auto const *resource = dynamic_cast<Static_Memory_Resource const *>(&other);
+        return resource != nullptr && resource->d_allocator == d_allocator;
+    }
+};
+
+#endif